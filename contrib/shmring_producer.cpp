@@ -0,0 +1,143 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Minimal producer for the PulseView shared memory ring, meant to stand in
+ * for a real acquisition daemon during testing. It writes a binary counter
+ * on the logic channels and a sine wave on the analog channel.
+ *
+ * Build:  c++ -std=c++11 -O2 -I.. -o shmring_producer shmring_producer.cpp -lrt
+ * Usage:  shmring_producer [name] [logic channels] [samplerate] [total samples]
+ * Then:   pulseview -R /pv_ring
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "pv/devices/shmringlayout.hpp"
+
+using namespace pv::devices;
+
+static const uint32_t BlockCount = 16;
+static const uint64_t BlockSize = 4 * 1024 * 1024;
+
+int main(int argc, char *argv[])
+{
+	const char *name = (argc > 1) ? argv[1] : "/pv_ring";
+	const uint32_t logic_channels = (argc > 2) ? atoi(argv[2]) : 8;
+	const uint64_t samplerate = (argc > 3) ? strtoull(argv[3], nullptr, 0) : 10000000;
+	const uint64_t total_samples = (argc > 4) ? strtoull(argv[4], nullptr, 0) : 100000000;
+
+	if ((logic_channels == 0) || (logic_channels > 64)) {
+		fprintf(stderr, "Logic channel count must be between 1 and 64\n");
+		return 1;
+	}
+
+	ShmRingHeader layout;
+	memset((void*)&layout, 0, sizeof(layout));
+	layout.block_count = BlockCount;
+	layout.block_size = BlockSize;
+	const uint64_t total_size = shm_ring_total_size(&layout);
+
+	shm_unlink(name);
+	const int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+	if ((fd < 0) || (ftruncate(fd, total_size) < 0)) {
+		perror("shm_open");
+		return 1;
+	}
+
+	void *const addr = mmap(nullptr, total_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	ShmRingHeader *const header = (ShmRingHeader*)addr;
+	header->samplerate = samplerate;
+	header->logic_channels = logic_channels;
+	header->logic_unit_size = (logic_channels + 7) / 8;
+	header->analog_channels = 1;
+	header->block_count = BlockCount;
+	header->block_size = BlockSize;
+	header->write_index = 0;
+	header->read_index = 0;
+	header->producer_done = 0;
+	header->version = ShmRingVersion;
+	header->magic = ShmRingMagic;  // Set last, consumers check it first
+
+	printf("Ring %s ready, waiting for consumer\n", name);
+
+	const uint32_t unit_size = header->logic_unit_size;
+	uint64_t logic_sample = 0, analog_sample = 0;
+	bool send_logic = true;
+
+	while ((logic_sample < total_samples) || (analog_sample < total_samples)) {
+		// Wait for the consumer to release a slot
+		ShmRingBlock *const block = shm_ring_write_slot(header);
+		if (!block) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			continue;
+		}
+
+		uint8_t *const payload = (uint8_t*)block + sizeof(ShmRingBlock);
+
+		if (send_logic && (logic_sample < total_samples)) {
+			const uint64_t count = std::min<uint64_t>(BlockSize / unit_size,
+				total_samples - logic_sample);
+			for (uint64_t i = 0; i < count; i++) {
+				const uint64_t value = (logic_sample + i) >> 4;
+				memcpy(payload + i * unit_size, &value, unit_size);
+			}
+			block->type = ShmRingBlockLogic;
+			block->length = count * unit_size;
+			logic_sample += count;
+		} else if (analog_sample < total_samples) {
+			const uint64_t count = std::min<uint64_t>(BlockSize / sizeof(float),
+				total_samples - analog_sample);
+			float *const data = (float*)payload;
+			for (uint64_t i = 0; i < count; i++)
+				data[i] = sinf((analog_sample + i) * 2 * M_PI / 1000.0f);
+			block->type = ShmRingBlockAnalog;
+			block->length = count * sizeof(float);
+			analog_sample += count;
+		} else {
+			send_logic = !send_logic;
+			continue;
+		}
+
+		shm_ring_publish_slot(header);
+		send_logic = !send_logic;
+	}
+
+	header->producer_done.store(1, std::memory_order_release);
+	printf("Produced %llu samples\n", (unsigned long long)total_samples);
+
+	munmap(addr, total_size);
+
+	return 0;
+}
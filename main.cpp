@@ -22,6 +22,7 @@
 #endif
 
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <getopt.h>
 #include <vector>
@@ -62,6 +63,14 @@
 #include "pv/util.hpp"
 #include "pv/data/segment.hpp"
 
+#ifdef ENABLE_DECODE
+#include "pv/batchdecoder.hpp"
+#include "pv/decoderloader.hpp"
+#ifdef HAVE_SHM_OPEN
+#include "pv/data/decode/decodeprocess.hpp"
+#endif
+#endif
+
 #ifdef ANDROID
 #include <libsigrokandroidutils/libsigrokandroidutils.h>
 #include "android/assetreader.hpp"
@@ -161,10 +170,16 @@ void usage()
 		"  -l, --loglevel                  Set libsigrok/libsigrokdecode loglevel\n"
 		"  -d, --driver                    Specify the device driver to use\n"
 		"  -D, --dont-scan                 Don't auto-scan for devices, use -d spec only\n"
-		"  -i, --input-file                Load input from file\n"
+		"  -i, --input-file                Load input from file (- for stdin)\n"
 		"  -s, --settings                  Load PulseView session setup from file\n"
 		"  -I, --input-format              Input format\n"
+		"  -R, --shm-ring                  Attach to a shared memory sample ring (e.g. /pv_ring)\n"
 		"  -c, --clean                     Don't restore previous sessions on startup\n"
+#ifdef ENABLE_DECODE
+		"  -b, --batch                     Decode the input files without GUI using the\n"
+		"                                  decoders of the -s setup (or each file's .pvs),\n"
+		"                                  write the results to the given directory and exit\n"
+#endif
 		"\n", PV_BIN_NAME);
 }
 
@@ -172,12 +187,26 @@ int main(int argc, char *argv[])
 {
 	int ret = 0;
 	shared_ptr<sigrok::Context> context;
-	string open_file_format, open_setup_file, driver;
+	string open_file_format, open_setup_file, driver, shm_ring, batch_output_dir;
 	vector<string> open_files;
 	bool restore_sessions = true;
 	bool do_scan = true;
 	bool show_version = false;
 
+#if defined ENABLE_DECODE && defined HAVE_SHM_OPEN
+	// Decoder helper processes need neither the GUI nor libsigrok
+	if ((argc > 1) && !strcmp(argv[1], pv::data::decode::DecodeProcess::WorkerArgument))
+		return pv::data::decode::DecodeProcess::worker_main(argc, argv);
+#endif
+
+#ifdef ENABLE_DECODE
+	// Batch mode must also work on machines without a display
+	for (int i = 1; i < argc; i++)
+		if ((!strncmp(argv[i], "-b", 2) || !strncmp(argv[i], "--batch", 7)) &&
+			qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+			qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif
+
 #ifdef ENABLE_FLOW
 	// Initialise gstreamermm. Must be called before any other GLib stuff.
 	Gst::init();
@@ -205,13 +234,15 @@ int main(int argc, char *argv[])
 			{"input-file", required_argument, nullptr, 'i'},
 			{"settings", required_argument, nullptr, 's'},
 			{"input-format", required_argument, nullptr, 'I'},
+			{"shm-ring", required_argument, nullptr, 'R'},
 			{"clean", no_argument, nullptr, 'c'},
+			{"batch", required_argument, nullptr, 'b'},
 			{"log-to-stdout", no_argument, nullptr, 's'},
 			{nullptr, 0, nullptr, 0}
 		};
 
 		const int c = getopt_long(argc, argv,
-			"h?VDcl:d:i:s:I:", long_options, nullptr);
+			"h?VDcl:d:i:s:I:R:b:", long_options, nullptr);
 		if (c == -1)
 			break;
 
@@ -266,9 +297,26 @@ int main(int argc, char *argv[])
 			open_file_format = optarg;
 			break;
 
+		case 'R':
+			shm_ring = optarg;
+			break;
+
 		case 'c':
 			restore_sessions = false;
 			break;
+
+		case 'b':
+#ifdef ENABLE_DECODE
+			batch_output_dir = optarg;
+			a.set_batch_mode(true);
+
+			// Files are decoded, there's no use for hardware
+			do_scan = false;
+#else
+			qDebug() << "ERROR: batch mode requires decoder support.";
+			return 1;
+#endif
+			break;
 		}
 	}
 	argc -= optind;
@@ -278,7 +326,7 @@ int main(int argc, char *argv[])
 		open_files.emplace_back(argv[i]);
 
 	// If no driver was specified via command line, check GlobalSettings for default
-	if (driver.empty()) {
+	if (driver.empty() && batch_output_dir.empty()) {
 		pv::GlobalSettings settings;
 		QString default_driver = settings.value(pv::GlobalSettings::Key_Device_DefaultDriver).toString();
 		QString default_port = settings.value(pv::GlobalSettings::Key_Device_DefaultSerialPort).toString();
@@ -336,8 +384,8 @@ int main(int argc, char *argv[])
 			break;
 		}
 
-		// Load the protocol decoders
-		srd_decoder_load_all();
+		// Load the protocol decoders in the background
+		pv::DecoderLoader decoder_loader;
 #endif
 
 #ifndef ENABLE_STACKTRACE
@@ -350,6 +398,12 @@ int main(int argc, char *argv[])
 		a.collect_version_info(device_manager);
 		if (show_version) {
 			a.print_version_info();
+#ifdef ENABLE_DECODE
+		} else if (!batch_output_dir.empty()) {
+			pv::BatchDecoder batch_decoder(device_manager, open_file_format,
+				open_setup_file, QString::fromStdString(batch_output_dir));
+			ret = batch_decoder.run(open_files);
+#endif
 		} else {
 			// Initialise the main window
 			pv::MainWindow w(device_manager);
@@ -358,6 +412,9 @@ int main(int argc, char *argv[])
 			if (restore_sessions)
 				w.restore_sessions();
 
+			if (!shm_ring.empty())
+				w.add_session_with_shm_ring(shm_ring);
+
 			if (open_files.empty())
 				w.add_default_session();
 			else
@@ -386,6 +443,7 @@ int main(int argc, char *argv[])
 
 #ifdef ENABLE_DECODE
 		// Destroy libsigrokdecode
+		decoder_loader.stop();
 		srd_exit();
 #endif
 
@@ -42,6 +42,10 @@
 #include "config.h"
 #include "globalsettings.hpp"
 
+#ifdef ENABLE_DECODE
+#include "decoderloader.hpp"
+#endif
+
 using std::cout;
 using std::endl;
 using std::exception;
@@ -59,7 +63,8 @@ static gint sort_pds(gconstpointer a, gconstpointer b)
 #endif
 
 Application::Application(int &argc, char* argv[]) :
-	QApplication(argc, argv)
+	QApplication(argc, argv),
+	batch_mode_(false)
 {
 	setApplicationVersion(PV_VERSION_STRING);
 	setApplicationName("JulseView");
@@ -149,6 +154,16 @@ void Application::on_setting_changed(const QString &key, const QVariant &value)
 		switch_language(value.toString());
 }
 
+void Application::set_batch_mode(bool batch_mode)
+{
+	batch_mode_ = batch_mode;
+}
+
+bool Application::batch_mode() const
+{
+	return batch_mode_;
+}
+
 void Application::collect_version_info(pv::DeviceManager &device_manager)
 {
 	// Library versions and features
@@ -181,8 +196,6 @@ void Application::collect_version_info(pv::DeviceManager &device_manager)
 	g_free(scpi_backends);
 
 #ifdef ENABLE_DECODE
-	struct srd_decoder *dec;
-
 	version_info_.emplace_back("libsigrokdecode", QString("%1/%2 (rt: %3/%4)")
 		.arg(SRD_PACKAGE_VERSION_STRING, SRD_LIB_VERSION_STRING,
 		srd_package_version_string_get(), srd_lib_version_string_get()));
@@ -232,17 +245,6 @@ void Application::collect_version_info(pv::DeviceManager &device_manager)
 		output_format_list_.emplace_back(QString::fromUtf8(entry.first.c_str()),
 			QString::fromUtf8(entry.second->description().c_str()));
 
-	// Protocol decoders
-#ifdef ENABLE_DECODE
-	GSList *sl = g_slist_copy((GSList *)srd_decoder_list());
-	sl = g_slist_sort(sl, sort_pds);
-	for (const GSList *l = sl; l; l = l->next) {
-		dec = (struct srd_decoder *)l->data;
-		pd_list_.emplace_back(QString::fromUtf8(dec->id),
-			QString::fromUtf8(dec->longname));
-	}
-	g_slist_free(sl);
-#endif
 }
 
 void Application::print_version_info()
@@ -278,7 +280,7 @@ void Application::print_version_info()
 
 #ifdef ENABLE_DECODE
 	cout << endl << "Supported protocol decoders:" << endl;
-	for (pair<QString, QString>& entry : pd_list_)
+	for (pair<QString, QString>& entry : get_pd_list())
 		cout << "  " << entry.first.leftJustified(21, ' ').toStdString() <<
 		entry.second.toStdString() << endl;
 #endif
@@ -316,6 +318,21 @@ vector< pair<QString, QString> > Application::get_output_format_list() const
 
 vector< pair<QString, QString> > Application::get_pd_list() const
 {
+#ifdef ENABLE_DECODE
+	// The protocol decoders are loaded in the background, so only collect
+	// them when they're asked for
+	if (pd_list_.empty()) {
+		GSList *sl = g_slist_copy((GSList *)DecoderLoader::get_decoders());
+		sl = g_slist_sort(sl, sort_pds);
+		for (const GSList *l = sl; l; l = l->next) {
+			const struct srd_decoder *dec = (struct srd_decoder *)l->data;
+			pd_list_.emplace_back(QString::fromUtf8(dec->id),
+				QString::fromUtf8(dec->longname));
+		}
+		g_slist_free(sl);
+	}
+#endif
+
 	return pd_list_;
 }
 
@@ -48,6 +48,13 @@ public:
 
 	void on_setting_changed(const QString &key, const QVariant &value);
 
+	/**
+	 * In batch mode there's no user to interact with, so no message boxes
+	 * are shown. See pv::BatchDecoder.
+	 */
+	void set_batch_mode(bool batch_mode);
+	bool batch_mode() const;
+
 	void collect_version_info(pv::DeviceManager &device_manager);
 	void print_version_info();
 
@@ -68,9 +75,11 @@ private:
 	vector< pair<QString, QString> > driver_list_;
 	vector< pair<QString, QString> > input_format_list_;
 	vector< pair<QString, QString> > output_format_list_;
-	vector< pair<QString, QString> > pd_list_;
+	mutable vector< pair<QString, QString> > pd_list_;
 
 	QTranslator app_translator_, qt_translator_, qtbase_translator_;
+
+	bool batch_mode_;
 };
 
 #endif // PULSEVIEW_PV_APPLICATION_HPP
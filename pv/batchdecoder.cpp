@@ -0,0 +1,306 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libsigrokdecode/libsigrokdecode.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QTextStream>
+
+#include "batchdecoder.hpp"
+#include "globalsettings.hpp"
+#include "session.hpp"
+
+#include <pv/data/decodesignal.hpp>
+#include <pv/data/decode/annotationcursor.hpp>
+#include <pv/data/decode/annotationformatter.hpp>
+#include <pv/data/decode/decoder.hpp>
+
+using std::dynamic_pointer_cast;
+using std::make_shared;
+using std::max;
+
+using pv::data::DecodeBinaryClass;
+using pv::data::DecodeSignal;
+using pv::data::DecodeStatistics;
+using pv::data::SignalBase;
+using pv::data::decode::Annotation;
+using pv::data::decode::AnnotationCursor;
+using pv::data::decode::AnnotationFormatter;
+using pv::data::decode::Decoder;
+
+namespace pv {
+
+BatchDecoder::BatchDecoder(DeviceManager &device_manager, const string &format,
+	const string &setup_file_name, const QString &output_dir) :
+	device_manager_(device_manager),
+	format_(format),
+	setup_file_name_(setup_file_name),
+	output_dir_(output_dir),
+	capture_running_(false),
+	capture_stopped_(false),
+	session_failed_(false)
+{
+}
+
+int BatchDecoder::run(const vector<string> &file_names)
+{
+	if (file_names.empty()) {
+		qWarning() << "Batch mode: No input files given";
+		return ExitInvalidArguments;
+	}
+
+	if (!output_dir_.exists() && !QDir().mkpath(output_dir_.path())) {
+		qWarning() << "Batch mode: Can't create output directory" << output_dir_.path();
+		return ExitInvalidArguments;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	int result = ExitSuccess;
+	unsigned int failed_count = 0;
+
+	for (const string &file_name : file_names) {
+		const int file_result = decode_file(file_name);
+		if (file_result != ExitSuccess)
+			failed_count++;
+		result = max(result, file_result);
+	}
+
+	fprintf(stdout, "%zu files done in %.3f s, %u failed\n",
+		file_names.size(), timer.elapsed() / 1000., failed_count);
+
+	return result;
+}
+
+int BatchDecoder::decode_file(const string &file_name)
+{
+	const QFileInfo file_info(QString::fromStdString(file_name));
+
+	QElapsedTimer timer;
+	timer.start();
+
+	capture_running_ = false;
+	capture_stopped_ = false;
+	session_failed_ = false;
+
+	session_ = make_shared<Session>(device_manager_, file_info.fileName());
+
+	connect(session_.get(), SIGNAL(capture_state_changed(int)),
+		this, SLOT(on_capture_state_changed(int)));
+	connect(session_.get(), SIGNAL(session_error_raised(const QString, const QString)),
+		this, SLOT(on_session_error_raised(const QString, const QString)));
+
+	// Restores the decoders from the setup file and starts reading the file
+	session_->load_init_file(file_name, format_, setup_file_name_);
+
+	for (const shared_ptr<SignalBase>& base : session_->signalbases()) {
+		shared_ptr<DecodeSignal> signal = dynamic_pointer_cast<DecodeSignal>(base);
+		if (!signal)
+			continue;
+
+		// The output files must hold all annotations
+		signal->set_annotation_limit_enabled(false);
+
+		decode_signals_.push_back(signal);
+		connect(signal.get(), SIGNAL(decode_finished()), this, SLOT(check_finished()));
+
+		// Decoders that fail while running stop without finishing the decode
+		connect(signal.get(), SIGNAL(error_message_changed(QString)),
+			this, SLOT(check_finished()));
+	}
+
+	int result = ExitSuccess;
+
+	if (!session_->device() || session_failed_) {
+		qWarning() << "Batch mode:" << file_info.filePath() << "could not be loaded";
+		result = ExitLoadFailed;
+	} else if (decode_signals_.empty()) {
+		qWarning() << "Batch mode: No decoders set up for" << file_info.filePath();
+		result = ExitDecodeFailed;
+	} else {
+		// The decode signals start when the acquisition does
+		event_loop_.exec();
+
+		// Wait for the acquisition thread, it may still report an error
+		session_->stop_capture();
+		QCoreApplication::processEvents();
+
+		if (session_failed_)
+			result = ExitLoadFailed;
+	}
+
+	if (result == ExitSuccess) {
+		// Segment IDs are signed internally, -1 means there are none
+		const int32_t highest_segment_id = session_->get_highest_segment_id();
+
+		for (const shared_ptr<DecodeSignal>& signal : decode_signals_) {
+			if (!signal->get_error_message().isEmpty()) {
+				qWarning() << "Batch mode:" << file_info.filePath() << signal->name()
+					<< signal->get_error_message();
+				result = max(result, (int)ExitDecodeFailed);
+				continue;
+			}
+
+			const QString base_name = file_info.completeBaseName() + "_" + signal->name();
+
+			for (int32_t segment_id = 0; segment_id <= highest_segment_id; segment_id++) {
+				const QString name = (highest_segment_id > 0) ?
+					QString("%1_%2").arg(base_name).arg(segment_id + 1) : base_name;
+
+				if (!write_annotations(output_file_name(name + ".txt"), *signal, segment_id) ||
+					!write_binary_data(name, *signal, segment_id))
+					result = max(result, (int)ExitDecodeFailed);
+			}
+
+			const DecodeStatistics stats = signal->get_statistics();
+			fprintf(stdout, "%s: %s: decoded in %.3f s, %llu samples (%.0f sa/s), %llu annotations\n",
+				file_info.fileName().toUtf8().constData(), signal->name().toUtf8().constData(),
+				stats.run_time, (unsigned long long)stats.samples_decoded,
+				stats.samples_decoded / max(stats.run_time, 1e-9),
+				(unsigned long long)stats.annotation_count);
+		}
+	}
+
+	fprintf(stdout, "%s: %s after %.3f s\n", file_info.fileName().toUtf8().constData(),
+		(result == ExitSuccess) ? "done" : "failed", timer.elapsed() / 1000.);
+
+	decode_signals_.clear();
+	session_.reset();
+
+	return result;
+}
+
+bool BatchDecoder::write_annotations(const QString &file_name,
+	const DecodeSignal &signal, uint32_t segment_id) const
+{
+	AnnotationCursor cursor;
+	signal.merge_annotations(cursor, segment_id, signal.get_annotation_count(segment_id));
+
+	GlobalSettings settings;
+	const AnnotationFormatter formatter(
+		settings.value(GlobalSettings::Key_Dec_ExportFormat).toString());
+
+	QFile file(file_name);
+	if (file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+		QTextStream out_stream(&file);
+
+		for (const Annotation* ann : cursor.annotations())
+			out_stream << formatter.format(*ann) << '\n';
+
+		if (out_stream.status() == QTextStream::Ok)
+			return true;
+	}
+
+	qWarning() << "Batch mode: File" << file_name << "could not be written to";
+	return false;
+}
+
+bool BatchDecoder::write_binary_data(const QString &base_name,
+	const DecodeSignal &signal, uint32_t segment_id) const
+{
+	bool result = true;
+
+	for (const shared_ptr<Decoder>& dec : signal.decoder_stack())
+		for (uint32_t id = 0; id < dec->get_binary_class_count(); id++) {
+			const DecodeBinaryClass* bin_class =
+				signal.get_binary_data_class(segment_id, dec.get(), id);
+			if (!bin_class || (bin_class->size == 0))
+				continue;
+
+			const QString file_name = output_file_name(QString("%1_%2_%3.bin").arg(base_name,
+				QString::fromUtf8(dec->name()), QString::fromUtf8(dec->get_binary_class(id)->name)));
+
+			// The data is written straight from where the decode signal keeps it
+			QFile file(file_name);
+			bool write_failed = !file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+			if (!write_failed)
+				signal.get_binary_data_spans(segment_id, dec.get(), id, 0, bin_class->size,
+					[&](const uint8_t* data, uint64_t size) {
+						if (!write_failed)
+							write_failed = (file.write((const char*)data, size) != (int64_t)size);
+					});
+
+			if (write_failed) {
+				qWarning() << "Batch mode: File" << file_name << "could not be written to";
+				result = false;
+			}
+		}
+
+	return result;
+}
+
+QString BatchDecoder::output_file_name(const QString &base_name) const
+{
+	// Signal and decoder names may contain characters not allowed in file names
+	QString name = base_name;
+	name.replace(QRegularExpression("[^A-Za-z0-9_.+-]"), "_");
+
+	return output_dir_.filePath(name);
+}
+
+void BatchDecoder::on_capture_state_changed(int state)
+{
+	if (state == Session::Running)
+		capture_running_ = true;
+
+	if (state != Session::Stopped)
+		return;
+
+	capture_stopped_ = true;
+
+	// The decode signals only start once there's data
+	if (!capture_running_) {
+		qWarning() << "Batch mode: No data in" << session_->name();
+		session_failed_ = true;
+		event_loop_.quit();
+		return;
+	}
+
+	check_finished();
+}
+
+void BatchDecoder::on_session_error_raised(const QString text, const QString info_text)
+{
+	qWarning() << "Batch mode:" << text << info_text;
+
+	session_failed_ = true;
+	event_loop_.quit();
+}
+
+void BatchDecoder::check_finished()
+{
+	if (!capture_stopped_)
+		return;
+
+	// Decode signals that couldn't start or failed have an error message
+	for (const shared_ptr<DecodeSignal>& signal : decode_signals_)
+		if (signal->get_error_message().isEmpty() && !signal->is_decode_finished())
+			return;
+
+	event_loop_.quit();
+}
+
+} // namespace pv
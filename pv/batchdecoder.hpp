@@ -0,0 +1,106 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_BATCHDECODER_HPP
+#define PULSEVIEW_PV_BATCHDECODER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QDir>
+#include <QEventLoop>
+#include <QObject>
+#include <QString>
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace pv {
+
+class DeviceManager;
+class Session;
+
+namespace data {
+class DecodeSignal;
+}
+
+/**
+ * Decodes capture files without a main window, e.g. for nightly jobs on
+ * machines without a display. Each file is loaded into its own session
+ * together with a setup file that holds the decoders, all decode signals
+ * are run at the same time and their annotations and binary output are
+ * written to files.
+ */
+class BatchDecoder : public QObject
+{
+	Q_OBJECT
+
+public:
+	/// The exit codes of run(), the worst one of all files is returned
+	enum ExitCode {
+		ExitSuccess = 0,
+		ExitInvalidArguments = 1,
+		ExitDecodeFailed = 2,  ///< A decoder stack couldn't run or its output not be written
+		ExitLoadFailed = 3  ///< A file couldn't be loaded
+	};
+
+public:
+	/**
+	 * @param format The input format and its options as given with -I,
+	 * 	or empty to detect it.
+	 * @param setup_file_name The setup with the decoders, if empty the
+	 * 	.pvs file next to each input file is used.
+	 * @param output_dir Where the results are written to.
+	 */
+	BatchDecoder(DeviceManager &device_manager, const string &format,
+		const string &setup_file_name, const QString &output_dir);
+
+	/// Decodes the files one after another and reports the timing to stdout
+	int run(const vector<string> &file_names);
+
+private:
+	int decode_file(const string &file_name);
+
+	bool write_annotations(const QString &file_name,
+		const data::DecodeSignal &signal, uint32_t segment_id) const;
+	bool write_binary_data(const QString &base_name,
+		const data::DecodeSignal &signal, uint32_t segment_id) const;
+
+	QString output_file_name(const QString &base_name) const;
+
+private Q_SLOTS:
+	void on_capture_state_changed(int state);
+	void on_session_error_raised(const QString text, const QString info_text);
+	void check_finished();
+
+private:
+	DeviceManager &device_manager_;
+	const string format_, setup_file_name_;
+	const QDir output_dir_;
+
+	shared_ptr<Session> session_;
+	vector< shared_ptr<data::DecodeSignal> > decode_signals_;
+	bool capture_running_, capture_stopped_, session_failed_;
+	QEventLoop event_loop_;
+};
+
+} // namespace pv
+
+#endif // PULSEVIEW_PV_BATCHDECODER_HPP
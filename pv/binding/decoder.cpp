@@ -132,10 +132,8 @@ Glib::VariantBase Decoder::getter(const char *id)
 void Decoder::setter(const char *id, Glib::VariantBase value)
 {
 	assert(decoder_);
-	decoder_->set_option(id, value.gobj());
-
 	assert(decode_signal_);
-	decode_signal_->begin_decode();
+	decode_signal_->set_decoder_option(decoder_, id, value.gobj());
 }
 
 }  // namespace binding
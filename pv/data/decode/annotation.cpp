@@ -33,21 +33,18 @@ namespace data {
 namespace decode {
 
 Annotation::Annotation(uint64_t start_sample, uint64_t end_sample,
-	const vector<QString>* texts, uint32_t ann_class_id, const RowData *data) :
+	const Properties* properties) :
 	start_sample_(start_sample),
 	end_sample_(end_sample),
-	texts_(texts),
-	ann_class_id_(ann_class_id),
-	data_(data)
+	properties_(properties)
 {
+	assert(properties_);
 }
 
 Annotation::Annotation(Annotation&& a) :
 	start_sample_(a.start_sample_),
 	end_sample_(a.end_sample_),
-	texts_(a.texts_),
-	ann_class_id_(a.ann_class_id_),
-	data_(a.data_)
+	properties_(a.properties_)
 {
 }
 
@@ -56,9 +53,7 @@ Annotation& Annotation::operator=(Annotation&& a)
 	if (&a != this) {
 		start_sample_ = a.start_sample_;
 		end_sample_ = a.end_sample_;
-		texts_ = a.texts_;
-		ann_class_id_ = a.ann_class_id_;
-		data_ = a.data_;
+		properties_ = a.properties_;
 	}
 
 	return *this;
@@ -66,12 +61,12 @@ Annotation& Annotation::operator=(Annotation&& a)
 
 const RowData* Annotation::row_data() const
 {
-	return data_;
+	return properties_->row_data;
 }
 
 const Row* Annotation::row() const
 {
-	return data_->row();
+	return properties_->row_data->row();
 }
 
 uint64_t Annotation::start_sample() const
@@ -91,13 +86,13 @@ uint64_t Annotation::length() const
 
 uint32_t Annotation::ann_class_id() const
 {
-	return ann_class_id_;
+	return properties_->ann_class_id;
 }
 
 const QString Annotation::ann_class_name() const
 {
 	const AnnotationClass* ann_class =
-		data_->row()->decoder()->get_ann_class_by_id(ann_class_id_);
+		properties_->row_data->row()->decoder()->get_ann_class_by_id(properties_->ann_class_id);
 
 	return QString(ann_class->name);
 }
@@ -105,42 +100,42 @@ const QString Annotation::ann_class_name() const
 const QString Annotation::ann_class_description() const
 {
 	const AnnotationClass* ann_class =
-		data_->row()->decoder()->get_ann_class_by_id(ann_class_id_);
+		properties_->row_data->row()->decoder()->get_ann_class_by_id(properties_->ann_class_id);
 
 	return QString(ann_class->description);
 }
 
 const vector<QString>* Annotation::annotations() const
 {
-	return texts_;
+	return &(properties_->texts);
 }
 
 const QString Annotation::longest_annotation() const
 {
-	return texts_->front();
+	return properties_->texts.front();
 }
 
 bool Annotation::visible() const
 {
-	const Row* row = data_->row();
+	const Row* row = properties_->row_data->row();
 
-	return (row->visible() && row->class_is_visible(ann_class_id_)
+	return (row->visible() && row->class_is_visible(properties_->ann_class_id)
 		&& row->decoder()->visible());
 }
 
 const QColor Annotation::color() const
 {
-	return data_->row()->get_class_color(ann_class_id_);
+	return properties_->row_data->row()->get_class_color(properties_->ann_class_id);
 }
 
 const QColor Annotation::bright_color() const
 {
-	return data_->row()->get_bright_class_color(ann_class_id_);
+	return properties_->row_data->row()->get_bright_class_color(properties_->ann_class_id);
 }
 
 const QColor Annotation::dark_color() const
 {
-	return data_->row()->get_dark_class_color(ann_class_id_);
+	return properties_->row_data->row()->get_dark_class_color(properties_->ann_class_id);
 }
 
 bool Annotation::operator<(const Annotation &other) const
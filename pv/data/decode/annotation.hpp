@@ -40,9 +40,22 @@ class RowData;
 
 class Annotation
 {
+public:
+	/**
+	 * The class and texts of an annotation along with the row it belongs to.
+	 * They're stored once per row for all annotations that share them, which
+	 * keeps the annotations themselves small.
+	 */
+	struct Properties
+	{
+		const RowData* row_data;
+		uint32_t ann_class_id;
+		vector<QString> texts;
+	};
+
 public:
 	Annotation(uint64_t start_sample, uint64_t end_sample,
-		const vector<QString>* texts, uint32_t ann_class_id, const RowData *data);
+		const Properties* properties);
 	Annotation(Annotation&& a);
 	Annotation& operator=(Annotation&& a);
 
@@ -71,9 +84,7 @@ public:
 private:
 	uint64_t start_sample_;
 	uint64_t end_sample_;
-	const vector<QString>* texts_;
-	uint32_t ann_class_id_;
-	const RowData* data_;
+	const Properties* properties_;
 };
 
 } // namespace decode
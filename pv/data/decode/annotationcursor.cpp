@@ -0,0 +1,150 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include <pv/data/decode/annotation.hpp>
+#include <pv/data/decode/annotationcursor.hpp>
+#include <pv/data/decode/rowdata.hpp>
+
+using std::make_heap;
+using std::numeric_limits;
+using std::pop_heap;
+using std::push_heap;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+// Enough for a screen full of table rows, so that scrolling doesn't
+// merge for every single row
+const size_t AnnotationCursor::BatchSize = 1024;
+
+AnnotationCursor::AnnotationCursor() :
+	last_start_(0)
+{
+}
+
+void AnnotationCursor::clear()
+{
+	rows_.clear();
+	annotations_.clear();
+	last_start_ = 0;
+}
+
+void AnnotationCursor::advance(const vector<const RowData*> &rows, size_t count)
+{
+	if (!is_valid_for(rows)) {
+		clear();
+		for (const RowData* row_data : rows)
+			rows_.push_back({row_data, 0, nullptr, 0, 0, 0, nullptr,
+				row_data->get_move_count()});
+	}
+
+	if (annotations_.size() >= count)
+		return;
+
+	if (count < numeric_limits<size_t>::max() - BatchSize)
+		count = ((count + BatchSize - 1) / BatchSize) * BatchSize;
+
+	// A heap of the rows with annotations left, the row whose next
+	// annotation comes first at the top
+	auto comes_later = [&](size_t a, size_t b) {
+		const Annotation& ann_a = rows_[a].row_data->annotations()[rows_[a].pos];
+		const Annotation& ann_b = rows_[b].row_data->annotations()[rows_[b].pos];
+		if (ann_a.start_sample() != ann_b.start_sample())
+			return ann_a.start_sample() > ann_b.start_sample();
+		if (ann_a.length() != ann_b.length())
+			return ann_a.length() < ann_b.length();
+		return a > b;
+	};
+
+	vector<size_t> heap;
+	for (size_t i = 0; i < rows_.size(); i++)
+		if (rows_[i].pos < rows_[i].row_data->annotations().size())
+			heap.push_back(i);
+	make_heap(heap.begin(), heap.end(), comes_later);
+
+	while (!heap.empty() && (annotations_.size() < count)) {
+		pop_heap(heap.begin(), heap.end(), comes_later);
+		RowPosition& r = rows_[heap.back()];
+
+		const deque<Annotation>& row_annotations = r.row_data->annotations();
+		const Annotation& a = row_annotations[r.pos++];
+		annotations_.push_back(&a);
+
+		r.last = &a;
+		r.last_start = a.start_sample();
+		r.last_end = a.end_sample();
+		r.last_class = a.ann_class_id();
+		r.last_texts = a.annotations();
+		last_start_ = a.start_sample();
+
+		if (r.pos < row_annotations.size())
+			push_heap(heap.begin(), heap.end(), comes_later);
+		else
+			heap.pop_back();
+	}
+}
+
+const deque<const Annotation*>& AnnotationCursor::annotations() const
+{
+	return annotations_;
+}
+
+bool AnnotationCursor::is_valid_for(const vector<const RowData*> &rows) const
+{
+	if (rows.size() != rows_.size())
+		return false;
+
+	for (size_t i = 0; i < rows.size(); i++) {
+		const RowPosition& r = rows_[i];
+		if (r.row_data != rows[i])
+			return false;
+
+		const deque<Annotation>& row_annotations = r.row_data->annotations();
+		if (r.pos > row_annotations.size())
+			return false;
+
+		// Inserting an annotation anywhere but at the end may move the
+		// merged ones in memory, depending on where in the deque it happens
+		if (r.row_data->get_move_count() != r.move_count)
+			return false;
+
+		// Also check the one we merged last in case the row was replaced
+		if (r.pos > 0) {
+			const Annotation& a = row_annotations[r.pos - 1];
+			if ((&a != r.last) ||
+				(a.start_sample() != r.last_start) || (a.end_sample() != r.last_end) ||
+				(a.ann_class_id() != r.last_class) || (a.annotations() != r.last_texts))
+				return false;
+		}
+
+		// An annotation added after them may still belong before the
+		// annotations of other rows that were merged already
+		if ((r.pos < row_annotations.size()) && !annotations_.empty() &&
+			(row_annotations[r.pos].start_sample() < last_start_))
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_DATA_DECODE_ANNOTATIONCURSOR_HPP
+#define PULSEVIEW_PV_DATA_DECODE_ANNOTATIONCURSOR_HPP
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <QString>
+
+using std::deque;
+using std::vector;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+class Annotation;
+class RowData;
+
+/**
+ * Merges the annotations of several rows, each of which is sorted by start
+ * sample, into one list sorted by start sample with longer annotations first.
+ * The merge only goes as far as the annotations were asked for and continues
+ * from there the next time, unless the rows were changed before that point.
+ *
+ * The rows must not be modified while the cursor is used.
+ */
+class AnnotationCursor
+{
+private:
+	static const size_t BatchSize;
+
+	struct RowPosition
+	{
+		const RowData* row_data;
+		size_t pos;  ///< Position of the next annotation to merge
+		const Annotation* last;  ///< The annotation before it, to notice inserts
+		uint64_t last_start, last_end;
+		uint32_t last_class;
+		const vector<QString>* last_texts;
+		uint64_t move_count;  ///< See RowData::get_move_count()
+	};
+
+public:
+	AnnotationCursor();
+
+	void clear();
+
+	/**
+	 * Merges annotations of the given rows until there are at least @a count
+	 * of them or none are left. Starts over if the rows aren't the same as
+	 * before, if annotations were added before the ones already merged or if
+	 * the annotations were moved in memory. With a @a count of 0, this only
+	 * makes sure that the merged annotations are still valid.
+	 */
+	void advance(const vector<const RowData*> &rows, size_t count);
+
+	const deque<const Annotation*>& annotations() const;
+
+private:
+	bool is_valid_for(const vector<const RowData*> &rows) const;
+
+private:
+	vector<RowPosition> rows_;
+	deque<const Annotation*> annotations_;
+	uint64_t last_start_;
+};
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DATA_DECODE_ANNOTATIONCURSOR_HPP
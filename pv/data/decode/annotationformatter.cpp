@@ -0,0 +1,84 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libsigrokdecode/libsigrokdecode.h>
+
+#include <pv/data/decode/annotation.hpp>
+#include <pv/data/decode/annotationformatter.hpp>
+#include <pv/data/decode/decoder.hpp>
+
+namespace pv {
+namespace data {
+namespace decode {
+
+AnnotationFormatter::AnnotationFormatter(QString format) :
+	quote_(format.contains("%q") ? "\"" : "")
+{
+	format_ = format.remove("%q");
+
+	has_sample_range_   = format_.contains("%s");
+	has_row_name_       = format_.contains("%r");
+	has_dec_name_       = format_.contains("%d");
+	has_class_name_     = format_.contains("%c");
+	has_first_ann_text_ = format_.contains("%1");
+	has_all_ann_text_   = format_.contains("%a");
+}
+
+QString AnnotationFormatter::format(const Annotation &ann) const
+{
+	QString out_text = format_;
+
+	if (has_sample_range_) {
+		const QString sample_range = QString("%1-%2") \
+			.arg(QString::number(ann.start_sample()), QString::number(ann.end_sample()));
+		out_text = out_text.replace("%s", sample_range);
+	}
+
+	if (has_dec_name_)
+		out_text = out_text.replace("%d",
+			quote_ + QString::fromUtf8(ann.row()->decoder()->name()) + quote_);
+
+	if (has_row_name_) {
+		const QString row_name = quote_ + ann.row()->description() + quote_;
+		out_text = out_text.replace("%r", row_name);
+	}
+
+	if (has_class_name_) {
+		const QString class_name = quote_ + ann.ann_class_name() + quote_;
+		out_text = out_text.replace("%c", class_name);
+	}
+
+	if (has_first_ann_text_) {
+		const QString first_ann_text = quote_ + ann.annotations()->front() + quote_;
+		out_text = out_text.replace("%1", first_ann_text);
+	}
+
+	if (has_all_ann_text_) {
+		QString all_ann_text;
+		for (const QString &s : *(ann.annotations()))
+			all_ann_text = all_ann_text + quote_ + s + quote_ + ",";
+		all_ann_text.chop(1);
+
+		out_text = out_text.replace("%a", all_ann_text);
+	}
+
+	return out_text;
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
@@ -0,0 +1,51 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_DATA_DECODE_ANNOTATIONFORMATTER_HPP
+#define PULSEVIEW_PV_DATA_DECODE_ANNOTATIONFORMATTER_HPP
+
+#include <QString>
+
+namespace pv {
+namespace data {
+namespace decode {
+
+class Annotation;
+
+/**
+ * Turns annotations into lines of text for exporting them. The format uses
+ * the placeholders described with GlobalSettings::Key_Dec_ExportFormat in
+ * the settings dialog.
+ */
+class AnnotationFormatter
+{
+public:
+	AnnotationFormatter(QString format);
+
+	QString format(const Annotation &ann) const;
+
+private:
+	QString format_, quote_;
+	bool has_sample_range_, has_row_name_, has_dec_name_, has_class_name_;
+	bool has_first_ann_text_, has_all_ann_text_;
+};
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DATA_DECODE_ANNOTATIONFORMATTER_HPP
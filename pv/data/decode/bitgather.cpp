@@ -0,0 +1,281 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "bitgather.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BITGATHER_HAVE_BMI2
+#include <immintrin.h>
+#endif
+
+using std::sort;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+// Samples are packed little endian, no matter the host byte order. With a
+// constant size, compilers merge these loops into a single load or store.
+template<unsigned int Size>
+static inline uint64_t load_sample(const uint8_t *ptr)
+{
+	uint64_t value = 0;
+	for (unsigned int i = 0; i < Size; i++)
+		value |= ((uint64_t)ptr[i]) << (8 * i);
+	return value;
+}
+
+template<unsigned int Size>
+static inline void store_sample(uint8_t *ptr, uint64_t value)
+{
+	for (unsigned int i = 0; i < Size; i++)
+		ptr[i] = value >> (8 * i);
+}
+
+#ifdef BITGATHER_HAVE_BMI2
+template<typename InType, unsigned int OutUnitSize>
+__attribute__((target("bmi2")))
+static void gather_pext(const uint8_t *in, uint8_t *out, uint64_t count,
+	uint64_t pext_mask, uint64_t pdep_mask, bool accumulate)
+{
+	for (uint64_t i = 0; i < count; i++) {
+		InType sample;
+		memcpy(&sample, in, sizeof(InType));
+
+		uint64_t value = _pdep_u64(_pext_u64(sample, pext_mask), pdep_mask);
+		if (accumulate)
+			value |= load_sample<OutUnitSize>(out);
+		store_sample<OutUnitSize>(out, value);
+
+		in += sizeof(InType);
+		out += OutUnitSize;
+	}
+}
+
+template<typename InType>
+static void gather_pext_in(const uint8_t *in, uint8_t *out, uint64_t count,
+	unsigned int out_unit_size, uint64_t pext_mask, uint64_t pdep_mask,
+	bool accumulate)
+{
+	switch (out_unit_size) {
+	case 1: gather_pext<InType, 1>(in, out, count, pext_mask, pdep_mask, accumulate); break;
+	case 2: gather_pext<InType, 2>(in, out, count, pext_mask, pdep_mask, accumulate); break;
+	case 3: gather_pext<InType, 3>(in, out, count, pext_mask, pdep_mask, accumulate); break;
+	case 4: gather_pext<InType, 4>(in, out, count, pext_mask, pdep_mask, accumulate); break;
+	case 5: gather_pext<InType, 5>(in, out, count, pext_mask, pdep_mask, accumulate); break;
+	case 6: gather_pext<InType, 6>(in, out, count, pext_mask, pdep_mask, accumulate); break;
+	case 7: gather_pext<InType, 7>(in, out, count, pext_mask, pdep_mask, accumulate); break;
+	default: gather_pext<InType, 8>(in, out, count, pext_mask, pdep_mask, accumulate); break;
+	}
+}
+#endif
+
+BitGather::BitGather(unsigned int in_unit_size, unsigned int out_unit_size) :
+	in_unit_size_(in_unit_size),
+	out_unit_size_(out_unit_size),
+	use_pext_(false),
+	pext_mask_(0),
+	pdep_mask_(0)
+{
+	assert(in_unit_size_ > 0);
+	assert(out_unit_size_ > 0);
+}
+
+unsigned int BitGather::in_unit_size() const
+{
+	return in_unit_size_;
+}
+
+unsigned int BitGather::out_unit_size() const
+{
+	return out_unit_size_;
+}
+
+void BitGather::add_bit(unsigned int in_bit, unsigned int out_bit)
+{
+	assert(in_bit < in_unit_size_ * 8);
+	assert(out_bit < out_unit_size_ * 8);
+
+	bits_.emplace_back(in_bit, out_bit);
+
+	// The tables can only hold output samples of up to 64 bits
+	if (out_unit_size_ <= 8) {
+		const unsigned int in_byte = in_bit / 8;
+
+		ByteTable *table = nullptr;
+		for (ByteTable& t : tables_)
+			if (t.in_byte == in_byte)
+				table = &t;
+
+		if (!table) {
+			tables_.emplace_back();
+			table = &tables_.back();
+			table->in_byte = in_byte;
+			memset(table->lut, 0, sizeof(table->lut));
+		}
+
+		for (unsigned int value = 0; value < 256; value++)
+			if (value & (1 << (in_bit % 8)))
+				table->lut[value] |= ((uint64_t)1) << out_bit;
+	}
+
+	update_pext_masks();
+}
+
+bool BitGather::uses_pext() const
+{
+	return use_pext_;
+}
+
+void BitGather::gather(const uint8_t *in, uint8_t *out, uint64_t count,
+	bool accumulate) const
+{
+	if (bits_.empty()) {
+		if (!accumulate)
+			memset(out, 0, count * out_unit_size_);
+		return;
+	}
+
+#ifdef BITGATHER_HAVE_BMI2
+	if (use_pext_) {
+		switch (in_unit_size_) {
+		case 1: gather_pext_in<uint8_t>(in, out, count, out_unit_size_, pext_mask_, pdep_mask_, accumulate); return;
+		case 2: gather_pext_in<uint16_t>(in, out, count, out_unit_size_, pext_mask_, pdep_mask_, accumulate); return;
+		case 4: gather_pext_in<uint32_t>(in, out, count, out_unit_size_, pext_mask_, pdep_mask_, accumulate); return;
+		case 8: gather_pext_in<uint64_t>(in, out, count, out_unit_size_, pext_mask_, pdep_mask_, accumulate); return;
+		default: break;
+		}
+	}
+#endif
+
+	switch (out_unit_size_) {
+	case 1: gather_tables<1>(in, out, count, accumulate); break;
+	case 2: gather_tables<2>(in, out, count, accumulate); break;
+	case 3: gather_tables<3>(in, out, count, accumulate); break;
+	case 4: gather_tables<4>(in, out, count, accumulate); break;
+	case 5: gather_tables<5>(in, out, count, accumulate); break;
+	case 6: gather_tables<6>(in, out, count, accumulate); break;
+	case 7: gather_tables<7>(in, out, count, accumulate); break;
+	case 8: gather_tables<8>(in, out, count, accumulate); break;
+	default: gather_generic(in, out, count, accumulate); break;
+	}
+}
+
+bool BitGather::cpu_has_fast_pext()
+{
+#ifdef BITGATHER_HAVE_BMI2
+	// AMD CPUs before Zen 3 implement PEXT and PDEP in microcode, making
+	// them a lot slower than the table lookups
+	static const bool fast_pext = __builtin_cpu_supports("bmi2") &&
+		!__builtin_cpu_is("amdfam15h") && !__builtin_cpu_is("amdfam17h");
+
+	return fast_pext;
+#else
+	return false;
+#endif
+}
+
+void BitGather::update_pext_masks()
+{
+	use_pext_ = false;
+	pext_mask_ = 0;
+	pdep_mask_ = 0;
+
+	if (!cpu_has_fast_pext() || (out_unit_size_ > 8))
+		return;
+
+	if ((in_unit_size_ != 1) && (in_unit_size_ != 2) &&
+		(in_unit_size_ != 4) && (in_unit_size_ != 8))
+		return;
+
+	// PEXT and PDEP keep the bit order, so the output bits must be in the
+	// same order as the input bits they're taken from
+	vector< pair<unsigned int, unsigned int> > bits = bits_;
+	sort(bits.begin(), bits.end());
+
+	for (size_t i = 1; i < bits.size(); i++)
+		if ((bits[i].first == bits[i - 1].first) ||
+			(bits[i].second <= bits[i - 1].second))
+			return;
+
+	for (const pair<unsigned int, unsigned int>& bit : bits) {
+		pext_mask_ |= ((uint64_t)1) << bit.first;
+		pdep_mask_ |= ((uint64_t)1) << bit.second;
+	}
+
+	use_pext_ = true;
+}
+
+template<unsigned int OutUnitSize>
+void BitGather::gather_tables(const uint8_t *in, uint8_t *out, uint64_t count,
+	bool accumulate) const
+{
+	const ByteTable *const tables = tables_.data();
+	const size_t table_count = tables_.size();
+	const unsigned int in_unit_size = in_unit_size_;
+
+	if (table_count == 1) {
+		// Most decoders take all of their channels from the same input byte
+		const uint64_t *const lut = tables[0].lut;
+		in += tables[0].in_byte;
+
+		for (uint64_t i = 0; i < count; i++) {
+			uint64_t value = lut[*in];
+			if (accumulate)
+				value |= load_sample<OutUnitSize>(out);
+			store_sample<OutUnitSize>(out, value);
+
+			in += in_unit_size;
+			out += OutUnitSize;
+		}
+		return;
+	}
+
+	for (uint64_t i = 0; i < count; i++) {
+		uint64_t value = accumulate ? load_sample<OutUnitSize>(out) : 0;
+		for (size_t t = 0; t < table_count; t++)
+			value |= tables[t].lut[in[tables[t].in_byte]];
+		store_sample<OutUnitSize>(out, value);
+
+		in += in_unit_size;
+		out += OutUnitSize;
+	}
+}
+
+void BitGather::gather_generic(const uint8_t *in, uint8_t *out, uint64_t count,
+	bool accumulate) const
+{
+	for (uint64_t i = 0; i < count; i++) {
+		if (!accumulate)
+			memset(out, 0, out_unit_size_);
+
+		for (const pair<unsigned int, unsigned int>& bit : bits_)
+			if ((in[bit.first / 8] >> (bit.first % 8)) & 1)
+				out[bit.second / 8] |= 1 << (bit.second % 8);
+
+		in += in_unit_size_;
+		out += out_unit_size_;
+	}
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
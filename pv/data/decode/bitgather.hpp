@@ -0,0 +1,104 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_DATA_DECODE_BITGATHER_HPP
+#define PULSEVIEW_PV_DATA_DECODE_BITGATHER_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::vector;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+/**
+ * Moves individual bits of packed logic samples to other bit positions of
+ * another packed sample format, as needed to build the decoder input from
+ * the assigned channels. Bits taken from inputs with different layouts are
+ * combined by gathering into the same output with accumulation enabled.
+ *
+ * When the input bits keep their relative order in the output and the CPU
+ * has fast BMI2 instructions, every sample is handled by one PEXT/PDEP
+ * pair. Otherwise, every input byte that holds a mapped bit is looked up
+ * in a 256 entry table holding its contribution to the output sample.
+ */
+class BitGather
+{
+public:
+	BitGather(unsigned int in_unit_size, unsigned int out_unit_size);
+
+	unsigned int in_unit_size() const;
+	unsigned int out_unit_size() const;
+
+	/**
+	 * Maps bit @a in_bit of the input samples to bit @a out_bit of the
+	 * output samples.
+	 */
+	void add_bit(unsigned int in_bit, unsigned int out_bit);
+
+	/**
+	 * Returns true if gather() uses PEXT/PDEP for the current mapping.
+	 */
+	bool uses_pext() const;
+
+	/**
+	 * Gathers @a count samples from @a in into @a out. The output samples
+	 * are overwritten unless @a accumulate is set, in which case the
+	 * gathered bits are ORed into them.
+	 */
+	void gather(const uint8_t *in, uint8_t *out, uint64_t count,
+		bool accumulate) const;
+
+	/**
+	 * Returns true if the CPU implements PEXT/PDEP in hardware.
+	 */
+	static bool cpu_has_fast_pext();
+
+private:
+	struct ByteTable {
+		unsigned int in_byte;
+		uint64_t lut[256];
+	};
+
+	void update_pext_masks();
+
+	template<unsigned int OutUnitSize>
+	void gather_tables(const uint8_t *in, uint8_t *out, uint64_t count,
+		bool accumulate) const;
+
+	void gather_generic(const uint8_t *in, uint8_t *out, uint64_t count,
+		bool accumulate) const;
+
+private:
+	const unsigned int in_unit_size_, out_unit_size_;
+
+	vector< pair<unsigned int, unsigned int> > bits_;
+	vector<ByteTable> tables_;
+
+	bool use_pext_;
+	uint64_t pext_mask_, pdep_mask_;
+};
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DATA_DECODE_BITGATHER_HPP
@@ -0,0 +1,173 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "decodemessage.hpp"
+
+namespace pv {
+namespace data {
+namespace decode {
+
+struct DecodeMessageHeader
+{
+	uint32_t type;
+	uint32_t size;
+};
+
+// Anything bigger is a broken stream rather than a message
+static const uint32_t MaxMessageSize = 64 * 1024 * 1024;
+
+void put_u32(vector<uint8_t> &dest, uint32_t value)
+{
+	const uint8_t* const p = (const uint8_t*)&value;
+	dest.insert(dest.end(), p, p + sizeof(value));
+}
+
+void put_u64(vector<uint8_t> &dest, uint64_t value)
+{
+	const uint8_t* const p = (const uint8_t*)&value;
+	dest.insert(dest.end(), p, p + sizeof(value));
+}
+
+void put_string(vector<uint8_t> &dest, const char *s)
+{
+	const uint32_t length = strlen(s);
+	put_u32(dest, length);
+	dest.insert(dest.end(), (const uint8_t*)s, (const uint8_t*)s + length + 1);
+}
+
+PayloadReader::PayloadReader(const vector<uint8_t> &payload) :
+	payload(payload),
+	pos(0),
+	ok(true)
+{
+}
+
+uint32_t PayloadReader::u32()
+{
+	uint32_t value = 0;
+	const uint8_t* const p = bytes(sizeof(value));
+	if (p)
+		memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+uint64_t PayloadReader::u64()
+{
+	uint64_t value = 0;
+	const uint8_t* const p = bytes(sizeof(value));
+	if (p)
+		memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+const uint8_t* PayloadReader::bytes(uint64_t length)
+{
+	if (!ok || (length > payload.size() - pos)) {
+		ok = false;
+		return nullptr;
+	}
+
+	const uint8_t* const result = payload.data() + pos;
+	pos += length;
+	return result;
+}
+
+const char* PayloadReader::string()
+{
+	const uint32_t length = u32();
+	const char* const s = (const char*)bytes((uint64_t)length + 1);
+
+	// The terminating zero was sent along, so the string can be used in place
+	if (!s || (s[length] != 0)) {
+		ok = false;
+		return "";
+	}
+
+	return s;
+}
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+#ifdef MSG_NOSIGNAL
+	const int flags = MSG_NOSIGNAL;  // A dead peer must not raise SIGPIPE
+#else
+	const int flags = 0;
+#endif
+
+	const uint8_t* p = (const uint8_t*)data;
+	while (size > 0) {
+		const ssize_t n = ::send(fd, p, size, flags);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		p += n;
+		size -= n;
+	}
+
+	return true;
+}
+
+static bool read_all(int fd, void *data, size_t size)
+{
+	uint8_t* p = (uint8_t*)data;
+	while (size > 0) {
+		const ssize_t n = ::read(fd, p, size);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		if (n == 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+
+	return true;
+}
+
+bool send_message(int fd, uint32_t type, const vector<uint8_t> &payload)
+{
+	const DecodeMessageHeader header = {type, (uint32_t)payload.size()};
+
+	return write_all(fd, &header, sizeof(header)) &&
+		write_all(fd, payload.data(), payload.size());
+}
+
+bool receive_message(int fd, uint32_t &type, vector<uint8_t> &payload)
+{
+	DecodeMessageHeader header;
+	if (!read_all(fd, &header, sizeof(header)) || (header.size > MaxMessageSize))
+		return false;
+
+	type = header.type;
+	payload.resize(header.size);
+
+	return read_all(fd, payload.data(), payload.size());
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
@@ -0,0 +1,80 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_DATA_DECODE_DECODEMESSAGE_HPP
+#define PULSEVIEW_PV_DATA_DECODE_DECODEMESSAGE_HPP
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+/*
+ * Encoding of the messages between PulseView and its decode worker
+ * processes, see DecodeProcess. A message is a header holding its type and
+ * payload size, followed by the payload. Both ends run on the same machine,
+ * so fields are stored in host byte order.
+ */
+
+void put_u32(vector<uint8_t> &dest, uint32_t value);
+void put_u64(vector<uint8_t> &dest, uint64_t value);
+
+/// Strings are stored with their length and a terminating zero
+void put_string(vector<uint8_t> &dest, const char *s);
+
+/**
+ * Reads the fields of a message payload, checking that it's long enough.
+ * Once a field couldn't be read, @a ok is false and all further fields
+ * are returned as zeros or empty strings.
+ */
+struct PayloadReader
+{
+	PayloadReader(const vector<uint8_t> &payload);
+
+	uint32_t u32();
+	uint64_t u64();
+	const uint8_t* bytes(uint64_t length);
+
+	/// Returns a pointer into the payload, which must outlive its use
+	const char* string();
+
+	const vector<uint8_t> &payload;
+	uint64_t pos;
+	bool ok;
+};
+
+/**
+ * Writes a message to the socket. Fails instead of raising SIGPIPE if the
+ * other end was closed.
+ */
+bool send_message(int fd, uint32_t type, const vector<uint8_t> &payload);
+
+/**
+ * Reads a message from the socket.
+ * @return false if the socket was closed or the message is broken.
+ */
+bool receive_message(int fd, uint32_t &type, vector<uint8_t> &payload);
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DATA_DECODE_DECODEMESSAGE_HPP
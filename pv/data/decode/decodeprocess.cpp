@@ -0,0 +1,728 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <atomic>
+#include <cassert>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <QCoreApplication>
+
+#include <libsigrokdecode/libsigrokdecode.h>
+
+#include "decodemessage.hpp"
+#include "decodeprocess.hpp"
+#include "decoder.hpp"
+
+using std::atomic;
+using std::lock_guard;
+using std::map;
+using std::mutex;
+using std::to_string;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+enum DecodeProcessMessage {
+	// To the helper process
+	MsgConfig = 1,
+	MsgReset,
+	MsgData,
+	MsgEof,
+
+	// From the helper process
+	MsgDataDone = 16,
+	MsgEofDone,
+	MsgAnnotation,
+	MsgBinary,
+	MsgError
+};
+
+const char* const DecodeProcess::WorkerArgument = "--decode-worker";
+
+// Two slots let us copy the next chunk while the helper decodes the last one
+const unsigned int DecodeProcess::SlotCount = 2;
+const uint64_t DecodeProcess::SlotSize = 4 * 1024 * 1024;
+
+static atomic<unsigned int> buffer_counter(0);
+
+// Held from creating the descriptors of a helper until it was forked, so
+// that no other helper inherits them where they can't be created with
+// FD_CLOEXEC already set
+static mutex fork_mutex;
+
+
+static void put_options(vector<uint8_t> &dest, const Decoder &dec)
+{
+	put_u32(dest, dec.options().size());
+	for (const auto& option : dec.options()) {
+		put_string(dest, option.first.c_str());
+		gchar* const value = g_variant_print(option.second, true);
+		put_string(dest, value);
+		g_free(value);
+	}
+}
+
+
+DecodeProcess::DecodeProcess(AnnotationHandler annotation_handler,
+	BinaryHandler binary_handler) :
+	annotation_handler_(annotation_handler),
+	binary_handler_(binary_handler),
+	pid_(-1),
+	socket_(-1),
+	buffer_(nullptr),
+	buffer_size_(0),
+	next_slot_(0),
+	slot_busy_(SlotCount, false)
+{
+}
+
+DecodeProcess::~DecodeProcess()
+{
+	stop();
+}
+
+bool DecodeProcess::start(const vector< shared_ptr<Decoder> > &stack,
+	uint64_t samplerate)
+{
+	stop();
+	error_.clear();
+
+	lock_guard<mutex> fork_lock(fork_mutex);
+
+	// Create the sample buffer. It's unlinked right away, the descriptors
+	// keep it alive for as long as we and the helper need it. shm_open()
+	// sets FD_CLOEXEC
+	const string name = "/pv_decode_" + to_string(getpid()) + "_" +
+		to_string(buffer_counter++);
+	const int shm_fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (shm_fd < 0) {
+		error_ = "Failed to create the shared sample buffer";
+		return false;
+	}
+	shm_unlink(name.c_str());
+
+	buffer_size_ = SlotCount * SlotSize;
+	void* const addr = (ftruncate(shm_fd, buffer_size_) == 0) ?
+		mmap(nullptr, buffer_size_, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0) :
+		MAP_FAILED;
+	if (addr == MAP_FAILED) {
+		close(shm_fd);
+		buffer_size_ = 0;
+		error_ = "Failed to map the shared sample buffer";
+		return false;
+	}
+	buffer_ = (uint8_t*)addr;
+
+	// Other threads may start processes at the same time, so only the
+	// child may inherit its descriptors, see below
+	int fds[2];
+#ifdef SOCK_CLOEXEC
+	const int socket_result = socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+#else
+	const int socket_result = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	if (socket_result == 0) {
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	}
+#endif
+	if (socket_result < 0) {
+		close(shm_fd);
+		stop();
+		error_ = "Failed to create the decode worker socket";
+		return false;
+	}
+
+#ifdef SO_NOSIGPIPE
+	const int one = 1;
+	setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+	// Prepare everything for exec() now, only async-signal-safe functions
+	// may be called after fork()
+	const string executable = QCoreApplication::applicationFilePath().toStdString();
+	const string socket_arg = to_string(fds[1]);
+	const string buffer_arg = to_string(shm_fd);
+	char* const args[] = {(char*)executable.c_str(), (char*)WorkerArgument,
+		(char*)socket_arg.c_str(), (char*)buffer_arg.c_str(), nullptr};
+
+	pid_ = fork();
+	if (pid_ == 0) {
+		fcntl(fds[1], F_SETFD, 0);
+		fcntl(shm_fd, F_SETFD, 0);
+		execv(executable.c_str(), args);
+		_exit(127);
+	}
+
+	close(fds[1]);
+	close(shm_fd);
+	socket_ = fds[0];
+
+	if (pid_ < 0) {
+		stop();
+		error_ = "Failed to start the decode worker process";
+		return false;
+	}
+
+	// Describe the decoder stack
+	vector<uint8_t> config;
+	put_u64(config, samplerate);
+	put_u32(config, stack.size());
+
+	for (const shared_ptr<Decoder>& dec : stack) {
+		put_string(config, dec->get_srd_decoder()->id);
+		put_options(config, *dec);
+
+		uint32_t assigned_count = 0;
+		for (const DecodeChannel* ch : dec->channels())
+			if (ch->assigned_signal)
+				assigned_count++;
+
+		put_u32(config, dec->channels().size());
+		put_u32(config, assigned_count);
+		for (const DecodeChannel* ch : dec->channels()) {
+			if (!ch->assigned_signal)
+				continue;
+			put_string(config, ch->pdch_->id);
+			put_u32(config, ch->bit_id);
+			put_u32(config, ch->id);
+			put_u32(config, ch->initial_pin_state);
+		}
+	}
+
+	if (!write_message(MsgConfig, config)) {
+		stop();
+		return false;
+	}
+
+	return true;
+}
+
+bool DecodeProcess::reset(const vector< shared_ptr<Decoder> > &stack,
+	uint64_t samplerate)
+{
+	// Everything we sent before must be done, or the output would end up
+	// in the next stream
+	if (!wait_until_done())
+		return false;
+
+	// The options may have changed since the process was started
+	vector<uint8_t> payload;
+	put_u64(payload, samplerate);
+	put_u32(payload, stack.size());
+	for (const shared_ptr<Decoder>& dec : stack)
+		put_options(payload, *dec);
+
+	return write_message(MsgReset, payload);
+}
+
+bool DecodeProcess::send(uint64_t start_sample, uint64_t end_sample,
+	const uint8_t* data, uint64_t size, unsigned int unit_size)
+{
+	// Split up what doesn't fit into a slot
+	const uint64_t max_size = SlotSize - (SlotSize % unit_size);
+	while (size > max_size) {
+		const uint64_t count = max_size / unit_size;
+		if (!send(start_sample, start_sample + count, data, max_size, unit_size))
+			return false;
+		start_sample += count;
+		data += max_size;
+		size -= max_size;
+	}
+
+	const unsigned int slot = next_slot_;
+	next_slot_ = (next_slot_ + 1) % SlotCount;
+
+	if (slot_busy_[slot] && !wait_for(MsgDataDone, slot))
+		return false;
+
+	memcpy(buffer_ + slot * SlotSize, data, size);
+
+	vector<uint8_t> payload;
+	put_u64(payload, start_sample);
+	put_u64(payload, end_sample);
+	put_u32(payload, slot);
+	put_u32(payload, size);
+	put_u32(payload, unit_size);
+
+	slot_busy_[slot] = true;
+
+	return write_message(MsgData, payload);
+}
+
+bool DecodeProcess::wait_until_done()
+{
+	for (unsigned int i = 0; i < SlotCount; i++)
+		if (slot_busy_[i] && !wait_for(MsgDataDone, i))
+			return false;
+
+	return true;
+}
+
+bool DecodeProcess::send_eof()
+{
+	return write_message(MsgEof, vector<uint8_t>()) && wait_for(MsgEofDone);
+}
+
+const string& DecodeProcess::error() const
+{
+	return error_;
+}
+
+bool DecodeProcess::write_message(uint32_t type, const vector<uint8_t> &payload)
+{
+	if (socket_ < 0)
+		return false;
+
+	if (!send_message(socket_, type, payload)) {
+		error_ = "Lost the connection to the decode worker process";
+		return false;
+	}
+
+	return true;
+}
+
+bool DecodeProcess::read_message(uint32_t &type, vector<uint8_t> &payload)
+{
+	if (socket_ < 0)
+		return false;
+
+	if (!receive_message(socket_, type, payload)) {
+		error_ = "Lost the connection to the decode worker process";
+		return false;
+	}
+
+	return true;
+}
+
+bool DecodeProcess::wait_for(uint32_t type, uint32_t slot)
+{
+	uint32_t received_type;
+	vector<uint8_t> payload;
+
+	while (read_message(received_type, payload)) {
+		if (!handle_message(received_type, payload))
+			return false;
+
+		if (received_type != type)
+			continue;
+
+		if (type != MsgDataDone)
+			return true;
+
+		// Slots are done in the order they were sent
+		PayloadReader reader(payload);
+		const uint32_t done_slot = reader.u32();
+		if (done_slot == slot)
+			return true;
+	}
+
+	return false;
+}
+
+bool DecodeProcess::handle_message(uint32_t type, const vector<uint8_t> &payload)
+{
+	PayloadReader reader(payload);
+
+	switch (type) {
+	case MsgDataDone:
+	{
+		const uint32_t slot = reader.u32();
+		if (reader.ok && (slot < SlotCount))
+			slot_busy_[slot] = false;
+		break;
+	}
+	case MsgEofDone:
+		break;
+	case MsgAnnotation:
+	{
+		const uint32_t decoder_index = reader.u32();
+		const uint64_t start_sample = reader.u64();
+		const uint64_t end_sample = reader.u64();
+		const uint32_t ann_class = reader.u32();
+		const uint32_t text_count = reader.u32();
+
+		vector<const char*> texts;
+		for (uint32_t i = 0; reader.ok && (i < text_count); i++)
+			texts.push_back(reader.string());
+		texts.push_back(nullptr);
+
+		if (reader.ok && (text_count > 0))
+			annotation_handler_(decoder_index, start_sample, end_sample,
+				ann_class, texts.data());
+		break;
+	}
+	case MsgBinary:
+	{
+		const uint32_t decoder_index = reader.u32();
+		const uint64_t start_sample = reader.u64();
+		const uint32_t bin_class = reader.u32();
+		const uint64_t size = reader.u64();
+		const uint8_t* const bin_data = reader.bytes(size);
+
+		if (reader.ok)
+			binary_handler_(decoder_index, start_sample, bin_class, bin_data, size);
+		break;
+	}
+	case MsgError:
+		error_ = reader.string();
+		return false;
+	default:
+		error_ = "Received an unknown message from the decode worker process";
+		return false;
+	}
+
+	return true;
+}
+
+void DecodeProcess::stop()
+{
+	if (socket_ >= 0) {
+		close(socket_);
+		socket_ = -1;
+	}
+
+	if (pid_ > 0) {
+		// The helper exits when the socket is closed, unless a decoder is
+		// busy, which we aren't interested in anymore
+		kill(pid_, SIGTERM);
+		waitpid(pid_, nullptr, 0);
+		pid_ = -1;
+	}
+
+	if (buffer_) {
+		munmap(buffer_, buffer_size_);
+		buffer_ = nullptr;
+		buffer_size_ = 0;
+	}
+
+	next_slot_ = 0;
+	slot_busy_.assign(SlotCount, false);
+}
+
+
+// ----- Helper process side -----
+
+struct DecodeProcessWorker
+{
+	int socket;
+	srd_session* session;
+	vector<srd_decoder_inst*> insts;
+	vector< map<string, string> > options;
+	map<const srd_decoder_inst*, uint32_t> inst_indices;
+	bool failed;
+};
+
+static void worker_send(DecodeProcessWorker &worker, uint32_t type,
+	const vector<uint8_t> &payload)
+{
+	// Without PulseView nobody is interested in the output, so don't keep
+	// on decoding. This may be called by the decoders, which is why we
+	// don't return to the message loop
+	if (!send_message(worker.socket, type, payload))
+		_exit(1);
+}
+
+static void worker_fail(DecodeProcessWorker &worker, const char *message)
+{
+	vector<uint8_t> payload;
+	put_string(payload, message);
+	worker_send(worker, MsgError, payload);
+	worker.failed = true;
+}
+
+static void worker_annotation_callback(srd_proto_data *pdata, void *cb_data)
+{
+	DecodeProcessWorker* const worker = (DecodeProcessWorker*)cb_data;
+	const srd_proto_data_annotation* const pda =
+		(const srd_proto_data_annotation*)pdata->data;
+
+	const char* const* texts = (const char* const*)pda->ann_text;
+	uint32_t text_count = 0;
+	while (texts[text_count])
+		text_count++;
+
+	vector<uint8_t> payload;
+	put_u32(payload, worker->inst_indices[pdata->pdo->di]);
+	put_u64(payload, pdata->start_sample);
+	put_u64(payload, pdata->end_sample);
+	put_u32(payload, pda->ann_class);
+	put_u32(payload, text_count);
+	for (uint32_t i = 0; i < text_count; i++)
+		put_string(payload, texts[i]);
+
+	worker_send(*worker, MsgAnnotation, payload);
+}
+
+static void worker_binary_callback(srd_proto_data *pdata, void *cb_data)
+{
+	DecodeProcessWorker* const worker = (DecodeProcessWorker*)cb_data;
+	const srd_proto_data_binary* const pdb =
+		(const srd_proto_data_binary*)pdata->data;
+
+	vector<uint8_t> payload;
+	put_u32(payload, worker->inst_indices[pdata->pdo->di]);
+	put_u64(payload, pdata->start_sample);
+	put_u32(payload, pdb->bin_class);
+	put_u64(payload, pdb->size);
+	payload.insert(payload.end(), pdb->data, pdb->data + pdb->size);
+
+	worker_send(*worker, MsgBinary, payload);
+}
+
+static GHashTable* worker_option_hash(const map<string, string> &options)
+{
+	GHashTable* const opt_hash = g_hash_table_new_full(g_str_hash,
+		g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+
+	for (const auto& option : options) {
+		GVariant* const value = g_variant_parse(nullptr,
+			option.second.c_str(), nullptr, nullptr, nullptr);
+		if (value)
+			g_hash_table_replace(opt_hash, g_strdup(option.first.c_str()),
+				g_variant_ref_sink(value));
+	}
+
+	return opt_hash;
+}
+
+static map<string, string> worker_read_options(PayloadReader &reader)
+{
+	map<string, string> options;
+
+	const uint32_t option_count = reader.u32();
+	for (uint32_t i = 0; reader.ok && (i < option_count); i++) {
+		const string key = reader.string();
+		options[key] = reader.string();
+	}
+
+	return options;
+}
+
+static void worker_set_samplerate(DecodeProcessWorker &worker, uint64_t samplerate)
+{
+	if (samplerate)
+		srd_session_metadata_set(worker.session, SRD_CONF_SAMPLERATE,
+			g_variant_new_uint64(samplerate));
+}
+
+static void worker_configure(DecodeProcessWorker &worker, PayloadReader &reader)
+{
+	const uint64_t samplerate = reader.u64();
+	const uint32_t decoder_count = reader.u32();
+
+	srd_session_new(&worker.session);
+
+	srd_decoder_inst* prev_di = nullptr;
+	for (uint32_t d = 0; reader.ok && (d < decoder_count); d++) {
+		const char* const id = reader.string();
+		const map<string, string> options = worker_read_options(reader);
+
+		if (!srd_decoder_get_by_id(id) && (srd_decoder_load(id) != SRD_OK)) {
+			worker_fail(worker, "Failed to load decoder");
+			return;
+		}
+
+		GHashTable* const opt_hash = worker_option_hash(options);
+		srd_decoder_inst* const di = srd_inst_new(worker.session, id, opt_hash);
+		g_hash_table_destroy(opt_hash);
+
+		if (!di) {
+			worker_fail(worker, "Failed to create decoder instance");
+			return;
+		}
+
+		// Setup the channels, see Decoder::create_decoder_inst()
+		const uint32_t pin_count = reader.u32();
+		const uint32_t channel_count = reader.u32();
+
+		GArray* const init_pin_states = g_array_sized_new(false, true,
+			sizeof(uint8_t), pin_count);
+		g_array_set_size(init_pin_states, pin_count);
+
+		GHashTable* const channels = g_hash_table_new_full(g_str_hash,
+			g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+
+		for (uint32_t i = 0; reader.ok && (i < channel_count); i++) {
+			const char* const pdch_id = reader.string();
+			const uint32_t bit_id = reader.u32();
+			const uint32_t channel_id = reader.u32();
+			const uint32_t initial_pin_state = reader.u32();
+
+			if (channel_id < pin_count)
+				init_pin_states->data[channel_id] = initial_pin_state;
+
+			g_hash_table_insert(channels, g_strdup(pdch_id),
+				g_variant_ref_sink(g_variant_new_int32(bit_id)));
+		}
+
+		srd_inst_channel_set_all(di, channels);
+		g_hash_table_destroy(channels);
+
+		srd_inst_initial_pins_set_all(di, init_pin_states);
+		g_array_free(init_pin_states, true);
+
+		if (prev_di)
+			srd_inst_stack(worker.session, prev_di, di);
+
+		worker.inst_indices[di] = d;
+		worker.insts.push_back(di);
+		worker.options.push_back(options);
+		prev_di = di;
+	}
+
+	if (!reader.ok) {
+		worker_fail(worker, "Received a broken decoder configuration");
+		return;
+	}
+
+	worker_set_samplerate(worker, samplerate);
+
+	srd_pd_output_callback_add(worker.session, SRD_OUTPUT_ANN,
+		worker_annotation_callback, &worker);
+	srd_pd_output_callback_add(worker.session, SRD_OUTPUT_BINARY,
+		worker_binary_callback, &worker);
+
+	srd_session_start(worker.session);
+}
+
+int DecodeProcess::worker_main(int argc, char *argv[])
+{
+	if (argc < 4)
+		return 1;
+
+	DecodeProcessWorker worker;
+	worker.socket = atoi(argv[2]);
+	worker.session = nullptr;
+	worker.failed = false;
+
+	const int shm_fd = atoi(argv[3]);
+	struct stat st;
+	if (fstat(shm_fd, &st) < 0)
+		return 1;
+
+	const uint8_t* const buffer = (const uint8_t*)mmap(nullptr, st.st_size,
+		PROT_READ, MAP_SHARED, shm_fd, 0);
+	close(shm_fd);
+	if (buffer == MAP_FAILED)
+		return 1;
+
+	if (srd_init(nullptr) != SRD_OK)
+		return 1;
+
+	uint32_t type;
+	vector<uint8_t> payload;
+	while (!worker.failed && receive_message(worker.socket, type, payload)) {
+		PayloadReader reader(payload);
+
+		if (!worker.session && (type != MsgConfig)) {
+			worker_fail(worker, "Decoder stack wasn't configured");
+			break;
+		}
+
+		switch (type) {
+		case MsgConfig:
+			worker_configure(worker, reader);
+			break;
+
+		case MsgReset:
+		{
+			const uint64_t samplerate = reader.u64();
+			const uint32_t decoder_count = reader.u32();
+			for (uint32_t i = 0; reader.ok && (i < decoder_count); i++) {
+				const map<string, string> options = worker_read_options(reader);
+				if (i < worker.options.size())
+					worker.options[i] = options;
+			}
+
+			srd_session_terminate_reset(worker.session);
+			worker_set_samplerate(worker, samplerate);
+
+			for (size_t i = 0; i < worker.insts.size(); i++) {
+				GHashTable* const opt_hash = worker_option_hash(worker.options[i]);
+				srd_inst_option_set(worker.insts[i], opt_hash);
+				g_hash_table_destroy(opt_hash);
+			}
+
+			srd_session_start(worker.session);
+			break;
+		}
+
+		case MsgData:
+		{
+			const uint64_t start_sample = reader.u64();
+			const uint64_t end_sample = reader.u64();
+			const uint32_t slot = reader.u32();
+			const uint32_t size = reader.u32();
+			const uint32_t unit_size = reader.u32();
+
+			if (!reader.ok || (slot >= SlotCount) || (size > SlotSize)) {
+				worker_fail(worker, "Received a broken data message");
+				break;
+			}
+
+			if (srd_session_send(worker.session, start_sample, end_sample,
+					buffer + slot * SlotSize, size, unit_size) != SRD_OK) {
+				worker_fail(worker, "Decoder reported an error");
+				break;
+			}
+
+			vector<uint8_t> done;
+			put_u32(done, slot);
+			worker_send(worker, MsgDataDone, done);
+			break;
+		}
+
+		case MsgEof:
+#if defined HAVE_SRD_SESSION_SEND_EOF && HAVE_SRD_SESSION_SEND_EOF
+			(void)srd_session_send_eof(worker.session);
+#endif
+			worker_send(worker, MsgEofDone, vector<uint8_t>());
+			break;
+
+		default:
+			worker_fail(worker, "Received an unknown message");
+			break;
+		}
+	}
+
+	if (worker.session)
+		srd_session_destroy(worker.session);
+	srd_exit();
+
+	munmap((void*)buffer, st.st_size);
+	close(worker.socket);
+
+	return worker.failed ? 1 : 0;
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
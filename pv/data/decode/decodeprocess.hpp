@@ -0,0 +1,136 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_DATA_DECODE_DECODEPROCESS_HPP
+#define PULSEVIEW_PV_DATA_DECODE_DECODEPROCESS_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+using std::function;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+class Decoder;
+
+/**
+ * Runs a decoder stack in a helper process so that several stacks don't
+ * have to share one Python interpreter. The helper is PulseView itself,
+ * started with WorkerArgument, see worker_main().
+ *
+ * Sample data is passed through a shared memory buffer, everything else
+ * goes through a socket as small binary messages. A DecodeProcess is used
+ * by a single thread, which also receives the decoder output through the
+ * handlers while it waits in send() and send_eof().
+ */
+class DecodeProcess
+{
+public:
+	/// The handlers get the sample numbers as seen by the decoders
+	typedef function<void(uint32_t decoder_index, uint64_t start_sample,
+		uint64_t end_sample, uint32_t ann_class, const char* const* texts)> AnnotationHandler;
+	typedef function<void(uint32_t decoder_index, uint64_t start_sample,
+		uint32_t bin_class, const uint8_t* data, uint64_t size)> BinaryHandler;
+
+	static const char* const WorkerArgument;
+
+private:
+	static const unsigned int SlotCount;
+	static const uint64_t SlotSize;
+
+public:
+	DecodeProcess(AnnotationHandler annotation_handler, BinaryHandler binary_handler);
+
+	~DecodeProcess();
+
+	/**
+	 * Starts the helper process and sets up the decoder stack in it.
+	 * @return false if the process couldn't be started, see error().
+	 */
+	bool start(const vector< shared_ptr<Decoder> > &stack, uint64_t samplerate);
+
+	/**
+	 * Prepares the decoders for a new stream of samples, starting at 0,
+	 * and updates their options. The stack itself must not have changed.
+	 */
+	bool reset(const vector< shared_ptr<Decoder> > &stack, uint64_t samplerate);
+
+	/**
+	 * Hands samples to the decoders. Returns once the data was copied,
+	 * while the decoders may still be busy with it.
+	 */
+	bool send(uint64_t start_sample, uint64_t end_sample, const uint8_t* data,
+		uint64_t size, unsigned int unit_size);
+
+	/**
+	 * Waits until the decoders are done with all samples sent so far, so
+	 * that their output was received.
+	 */
+	bool wait_until_done();
+
+	/**
+	 * Tells the decoders about the end of the input data and waits until
+	 * all output was received.
+	 */
+	bool send_eof();
+
+	const string& error() const;
+
+	/**
+	 * Entry point of the helper process.
+	 * @return The exit code of the process.
+	 */
+	static int worker_main(int argc, char *argv[]);
+
+private:
+	bool write_message(uint32_t type, const vector<uint8_t> &payload);
+	bool read_message(uint32_t &type, vector<uint8_t> &payload);
+	bool wait_for(uint32_t type, uint32_t slot = 0);
+	bool handle_message(uint32_t type, const vector<uint8_t> &payload);
+
+	void stop();
+
+private:
+	AnnotationHandler annotation_handler_;
+	BinaryHandler binary_handler_;
+
+	pid_t pid_;
+	int socket_;
+	uint8_t* buffer_;
+	uint64_t buffer_size_;
+
+	unsigned int next_slot_;
+	vector<bool> slot_busy_;
+
+	string error_;
+};
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DATA_DECODE_DECODEPROCESS_HPP
@@ -61,8 +61,7 @@ void AnnotationClass::set_visible(bool visible)
 Decoder::Decoder(const srd_decoder *const dec, uint8_t stack_level) :
 	srd_decoder_(dec),
 	stack_level_(stack_level),
-	visible_(true),
-	decoder_inst_(nullptr)
+	visible_(true)
 {
 	// Query the annotation output classes
 	uint32_t i = 0;
@@ -163,26 +162,26 @@ void Decoder::set_option(const char *id, GVariant *value)
 	g_variant_ref(value);
 	options_[id] = value;
 
-	// If we have a decoder instance, apply option value immediately
-	apply_all_options();
+	// Decoder instances pick up the new value when decoding is restarted,
+	// see DecodeSignal::set_decoder_option()
 }
 
-void Decoder::apply_all_options()
+void Decoder::apply_all_options(srd_decoder_inst *decoder_inst) const
 {
-	if (decoder_inst_) {
-		GHashTable *const opt_hash = g_hash_table_new_full(g_str_hash,
-			g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
-
-		for (const auto& option : options_) {
-			GVariant *const value = option.second;
-			g_variant_ref(value);
-			g_hash_table_replace(opt_hash, (void*)g_strdup(
-				option.first.c_str()), value);
-		}
-
-		srd_inst_option_set(decoder_inst_, opt_hash);
-		g_hash_table_destroy(opt_hash);
+	assert(decoder_inst);
+
+	GHashTable *const opt_hash = g_hash_table_new_full(g_str_hash,
+		g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+
+	for (const auto& option : options_) {
+		GVariant *const value = option.second;
+		g_variant_ref(value);
+		g_hash_table_replace(opt_hash, (void*)g_strdup(
+			option.first.c_str()), value);
 	}
+
+	srd_inst_option_set(decoder_inst, opt_hash);
+	g_hash_table_destroy(opt_hash);
 }
 
 bool Decoder::have_required_channels() const
@@ -194,7 +193,7 @@ bool Decoder::have_required_channels() const
 	return true;
 }
 
-srd_decoder_inst* Decoder::create_decoder_inst(srd_session *session)
+srd_decoder_inst* Decoder::create_decoder_inst(srd_session *session) const
 {
 	GHashTable *const opt_hash = g_hash_table_new_full(g_str_hash,
 		g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
@@ -206,13 +205,11 @@ srd_decoder_inst* Decoder::create_decoder_inst(srd_session *session)
 			option.first.c_str()), value);
 	}
 
-	if (decoder_inst_)
-		qDebug() << "WARNING: previous decoder instance" << decoder_inst_ << "exists";
-
-	decoder_inst_ = srd_inst_new(session, srd_decoder_->id, opt_hash);
+	srd_decoder_inst *const decoder_inst =
+		srd_inst_new(session, srd_decoder_->id, opt_hash);
 	g_hash_table_destroy(opt_hash);
 
-	if (!decoder_inst_)
+	if (!decoder_inst)
 		return nullptr;
 
 	// Setup the channels
@@ -236,17 +233,12 @@ srd_decoder_inst* Decoder::create_decoder_inst(srd_session *session)
 		g_hash_table_insert(channels, ch->pdch_->id, gvar);
 	}
 
-	srd_inst_channel_set_all(decoder_inst_, channels);
+	srd_inst_channel_set_all(decoder_inst, channels);
 
-	srd_inst_initial_pins_set_all(decoder_inst_, init_pin_states);
+	srd_inst_initial_pins_set_all(decoder_inst, init_pin_states);
 	g_array_free(init_pin_states, true);
 
-	return decoder_inst_;
-}
-
-void Decoder::invalidate_decoder_inst()
-{
-	decoder_inst_ = nullptr;
+	return decoder_inst;
 }
 
 vector<Row*> Decoder::get_rows()
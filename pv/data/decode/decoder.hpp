@@ -127,12 +127,16 @@ public:
 	const map<string, GVariant*>& options() const;
 	void set_option(const char *id, GVariant *value);
 
-	void apply_all_options();
+	void apply_all_options(srd_decoder_inst *decoder_inst) const;
 
 	bool have_required_channels() const;
 
-	srd_decoder_inst* create_decoder_inst(srd_session *session);
-	void invalidate_decoder_inst();
+	/**
+	 * Creates a new instance of the decoder in @a session, set up with the
+	 * current options and channels. A decoder can have instances in several
+	 * sessions at the same time.
+	 */
+	srd_decoder_inst* create_decoder_inst(srd_session *session) const;
 
 	vector<Row*> get_rows();
 	Row* get_row_by_id(size_t id);
@@ -166,7 +170,6 @@ private:
 	deque<AnnotationClass> ann_classes_;
 	vector<DecodeBinaryClassInfo> bin_classes_;
 	map<string, GVariant*> options_;
-	srd_decoder_inst *decoder_inst_;
 };
 
 } // namespace decode
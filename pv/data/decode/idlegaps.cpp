@@ -0,0 +1,57 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstddef>
+
+#include "idlegaps.hpp"
+
+namespace pv {
+namespace data {
+namespace decode {
+
+vector<uint64_t> find_idle_gap_splits(const vector<uint64_t> &activity,
+	uint64_t block_length, uint64_t gap_length, uint64_t min_length,
+	uint64_t start, uint64_t end)
+{
+	vector<uint64_t> splits;
+
+	if ((gap_length == 0) || (end < start) || (end - start < 2 * min_length))
+		return splits;
+
+	uint64_t prev_split = start;
+	for (size_t i = 1; i < activity.size(); i++) {
+		const uint64_t gap_start = activity[i - 1] + block_length;
+		const uint64_t gap_end = activity[i];
+
+		if ((gap_end <= gap_start) || ((gap_end - gap_start) < gap_length))
+			continue;
+
+		const uint64_t split = gap_start + (gap_end - gap_start) / 2;
+
+		if ((split - prev_split >= min_length) &&
+			(split + min_length / 2 <= end)) {
+			splits.push_back(split);
+			prev_split = split;
+		}
+	}
+
+	return splits;
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
@@ -0,0 +1,49 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_DATA_DECODE_IDLEGAPS_HPP
+#define PULSEVIEW_PV_DATA_DECODE_IDLEGAPS_HPP
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+/**
+ * Finds where the samples [@a start, @a end) can be split into partitions
+ * that are decoded on their own. The splits are placed in the middle of
+ * gaps of at least @a gap_length samples where no input changes, so that
+ * the decoders of the next partition see half a gap of idle bus first.
+ * Partitions are at least @a min_length samples long, the last one at
+ * least half of that.
+ * @param activity Sorted sample numbers where any input changes. Each one
+ * means that there may be changes in [p, p + @a block_length).
+ * @return The sorted split positions, empty if the range isn't split.
+ */
+vector<uint64_t> find_idle_gap_splits(const vector<uint64_t> &activity,
+	uint64_t block_length, uint64_t gap_length, uint64_t min_length,
+	uint64_t start, uint64_t end);
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DATA_DECODE_IDLEGAPS_HPP
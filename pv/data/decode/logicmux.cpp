@@ -0,0 +1,342 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#include <QDebug>
+
+#include <pv/data/decode/bitgather.hpp>
+#include <pv/data/decode/logicmux.hpp>
+#include <pv/data/logic.hpp>
+#include <pv/data/logicsegment.hpp>
+
+using std::lock_guard;
+using std::make_shared;
+using std::min;
+using std::numeric_limits;
+using std::remove_if;
+using std::unique_lock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+// Same as the chunks the decoders are fed with
+const int64_t LogicMux::ChunkLength = 256 * 1024;
+
+LogicMux::LogicMux(const vector<Input> &inputs) :
+	inputs_(inputs.begin(), inputs.end()),
+	unit_size_((inputs.size() + 7) / 8),
+	data_(make_shared<Logic>(inputs.size())),
+	mux_time_(0),
+	valid_(true),
+	input_changed_(false),
+	interrupt_(false)
+{
+}
+
+LogicMux::~LogicMux()
+{
+	if (thread_.joinable()) {
+		interrupt_ = true;
+		notify();
+		thread_.join();
+	}
+}
+
+shared_ptr<Logic> LogicMux::data() const
+{
+	return data_;
+}
+
+bool LogicMux::has_inputs(const vector<Input> &inputs) const
+{
+	if (inputs.size() != inputs_.size())
+		return false;
+
+	for (size_t i = 0; i < inputs.size(); i++)
+		if ((inputs_[i].first.lock() != inputs[i].first) ||
+			(inputs_[i].second != inputs[i].second))
+			return false;
+
+	return true;
+}
+
+void LogicMux::invalidate()
+{
+	valid_ = false;
+}
+
+bool LogicMux::is_valid() const
+{
+	return valid_;
+}
+
+uint64_t LogicMux::mux_time() const
+{
+	return mux_time_;
+}
+
+void LogicMux::add_listener(const void* owner, function<void()> listener)
+{
+	lock_guard<mutex> lock(listener_mutex_);
+
+	for (auto& entry : listeners_)
+		if (entry.first == owner) {
+			entry.second = listener;
+			return;
+		}
+
+	listeners_.emplace_back(owner, listener);
+}
+
+void LogicMux::remove_listener(const void* owner)
+{
+	lock_guard<mutex> lock(listener_mutex_);
+
+	listeners_.erase(remove_if(listeners_.begin(), listeners_.end(),
+		[&](const pair<const void*, function<void()> >& entry) {
+			return entry.first == owner; }), listeners_.end());
+}
+
+void LogicMux::start()
+{
+	if (!thread_.joinable())
+		thread_ = std::thread(&LogicMux::mux_proc, this);
+}
+
+void LogicMux::notify()
+{
+	{
+		lock_guard<mutex> lock(input_mutex_);
+		input_changed_ = true;
+	}
+
+	input_cond_.notify_one();
+}
+
+uint32_t LogicMux::get_input_segment_count() const
+{
+	uint64_t count = numeric_limits<uint64_t>::max();
+
+	for (const auto& input : inputs_) {
+		const shared_ptr<Logic> logic_data = input.first.lock();
+		if (!logic_data)
+			return 0;
+
+		count = min(count, (uint64_t)logic_data->logic_segments().size());
+	}
+
+	return inputs_.empty() ? 0 : count;
+}
+
+uint64_t LogicMux::get_input_sample_count(uint32_t segment_id) const
+{
+	uint64_t count = numeric_limits<uint64_t>::max();
+
+	for (const auto& input : inputs_) {
+		const shared_ptr<Logic> logic_data = input.first.lock();
+		if (!logic_data || (segment_id >= logic_data->logic_segments().size()))
+			return 0;
+
+		const shared_ptr<const LogicSegment> segment =
+			logic_data->logic_segments()[segment_id]->get_shared_ptr();
+		if (segment)
+			count = min(count, segment->get_sample_count());
+	}
+
+	return inputs_.empty() ? 0 : count;
+}
+
+bool LogicMux::all_input_segments_complete(uint32_t segment_id) const
+{
+	for (const auto& input : inputs_) {
+		const shared_ptr<Logic> logic_data = input.first.lock();
+		if (!logic_data || (segment_id >= logic_data->logic_segments().size()))
+			return false;
+
+		const shared_ptr<const LogicSegment> segment =
+			logic_data->logic_segments()[segment_id]->get_shared_ptr();
+		if (segment && !segment->is_complete())
+			return false;
+	}
+
+	return true;
+}
+
+double LogicMux::get_input_samplerate(uint32_t segment_id) const
+{
+	for (const auto& input : inputs_) {
+		const shared_ptr<Logic> logic_data = input.first.lock();
+		if (!logic_data || (segment_id >= logic_data->logic_segments().size()))
+			continue;
+
+		const shared_ptr<const LogicSegment> segment =
+			logic_data->logic_segments()[segment_id]->get_shared_ptr();
+		return segment ? segment->samplerate() : 0;
+	}
+
+	return 0;
+}
+
+shared_ptr<LogicSegment> LogicMux::get_output_segment(uint32_t segment_id)
+{
+	deque< shared_ptr<LogicSegment> >& segments = data_->logic_segments();
+
+	if (segment_id < segments.size())
+		return segments[segment_id];
+
+	shared_ptr<LogicSegment> segment =
+		make_shared<LogicSegment>(*data_, segment_id, unit_size_, 0);
+	data_->push_segment(segment);
+
+	segment->set_samplerate(get_input_samplerate(segment_id));
+
+	return segment;
+}
+
+void LogicMux::mux_samples(uint32_t segment_id, uint64_t start, uint64_t end)
+{
+	const shared_ptr<LogicSegment> output_segment = data_->logic_segments().at(segment_id);
+
+	// Group the bits by the segment they're taken from so that every
+	// input segment is only read once, no matter how many bits it feeds
+	vector< shared_ptr<const LogicSegment> > segments;
+	vector<BitGather> gathers;
+	unsigned int out_bit = 0;
+
+	for (const auto& input : inputs_) {
+		const shared_ptr<Logic> logic_data = input.first.lock();
+
+		shared_ptr<const LogicSegment> segment;
+		if (logic_data && (segment_id < logic_data->logic_segments().size()))
+			segment = logic_data->logic_segments().at(segment_id)->get_shared_ptr();
+
+		if (!segment) {
+			qDebug() << "Muxer error: input data for segment" << segment_id << "is gone";
+			interrupt_ = true;
+			return;
+		}
+
+		size_t i = 0;
+		while ((i < segments.size()) && (segments[i] != segment))
+			i++;
+
+		if (i == segments.size()) {
+			segments.push_back(segment);
+			gathers.emplace_back(segment->unit_size(), unit_size_);
+		}
+
+		gathers[i].add_bit(input.second, out_bit++);
+	}
+
+	// Gather the bits straight from the segment chunks into the output
+	buffer_.resize((end - start) * unit_size_);
+	uint8_t* const output = buffer_.data();
+
+	if (segments.empty())
+		memset(output, 0, buffer_.size());
+
+	for (size_t i = 0; i < segments.size(); i++) {
+		if (interrupt_)
+			return;
+
+		const BitGather& gather = gathers[i];
+		uint8_t* out = output;
+
+		segments[i]->get_sample_spans(start, end,
+			[&](const uint8_t* data, uint64_t count) {
+				gather.gather(data, out, count, (i > 0));
+				out += count * unit_size_;
+			});
+	}
+
+	output_segment->append_payload(output, buffer_.size());
+}
+
+void LogicMux::notify_listeners()
+{
+	lock_guard<mutex> lock(listener_mutex_);
+
+	for (const auto& entry : listeners_)
+		entry.second();
+}
+
+void LogicMux::wait_for_input()
+{
+	unique_lock<mutex> lock(input_mutex_);
+	input_cond_.wait(lock, [&] { return interrupt_ || input_changed_; });
+	input_changed_ = false;
+}
+
+void LogicMux::mux_proc()
+{
+	while (!interrupt_ && (get_input_segment_count() == 0))
+		wait_for_input();
+
+	if (interrupt_)
+		return;
+
+	uint32_t segment_id = 0;
+	shared_ptr<LogicSegment> output_segment = get_output_segment(segment_id);
+
+	while (!interrupt_) {
+		const uint64_t input_sample_count = get_input_sample_count(segment_id);
+		const uint64_t output_sample_count = output_segment->get_sample_count();
+
+		if (input_sample_count > output_sample_count) {
+			const uint64_t end = min(input_sample_count,
+				output_sample_count + ChunkLength / unit_size_);
+
+			const steady_clock::time_point mux_start = steady_clock::now();
+			mux_samples(segment_id, output_sample_count, end);
+			mux_time_ += duration_cast<nanoseconds>(steady_clock::now() - mux_start).count();
+
+			// ...and have the decoders process the newly muxed data
+			notify_listeners();
+			continue;
+		}
+
+		// The currently available input data is exhausted. If the input
+		// segments are complete, so is this segment
+		if (all_input_segments_complete(segment_id)) {
+			if (!output_segment->is_complete()) {
+				output_segment->set_complete();
+				notify_listeners();
+			}
+
+			if (segment_id + 1 < get_input_segment_count()) {
+				segment_id++;
+				output_segment = get_output_segment(segment_id);
+				continue;
+			}
+		}
+
+		wait_for_input();
+	}
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
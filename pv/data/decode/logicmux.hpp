@@ -0,0 +1,146 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_DATA_DECODE_LOGICMUX_HPP
+#define PULSEVIEW_PV_DATA_DECODE_LOGICMUX_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using std::atomic;
+using std::condition_variable;
+using std::function;
+using std::mutex;
+using std::pair;
+using std::shared_ptr;
+using std::vector;
+using std::weak_ptr;
+
+namespace pv {
+namespace data {
+
+class Logic;
+class LogicSegment;
+
+namespace decode {
+
+/**
+ * Combines the bits that are assigned to the channels of a decoder stack
+ * into one logic data object that the decoders can work on. The muxing is
+ * done by a thread that keeps up with the input data until the LogicMux is
+ * destroyed.
+ *
+ * Decode signals with the same inputs share one LogicMux, see
+ * Session::get_logic_mux(), and are told about new data by a listener.
+ */
+class LogicMux
+{
+public:
+	/// A bit of the input, given by its logic data and bit index
+	typedef pair<shared_ptr<Logic>, unsigned int> Input;
+
+private:
+	static const int64_t ChunkLength;
+
+public:
+	/**
+	 * @param inputs The bits in the order they appear in the muxed samples.
+	 */
+	LogicMux(const vector<Input> &inputs);
+
+	~LogicMux();
+
+	shared_ptr<Logic> data() const;
+
+	bool has_inputs(const vector<Input> &inputs) const;
+
+	/**
+	 * Marks the muxed data as outdated, e.g. because the input data was
+	 * cleared. Session::get_logic_mux() doesn't hand it out anymore.
+	 */
+	void invalidate();
+	bool is_valid() const;
+
+	/// Returns the time spent muxing so far, in ns
+	uint64_t mux_time() const;
+
+	/**
+	 * Makes @a listener be called whenever muxed data was added or a muxed
+	 * segment was completed. It's called from the mux thread.
+	 */
+	void add_listener(const void* owner, function<void()> listener);
+
+	/**
+	 * Removes the listener of @a owner. Once this returns, the listener
+	 * isn't called anymore.
+	 */
+	void remove_listener(const void* owner);
+
+	/// Starts the mux thread unless it's running already
+	void start();
+
+	/// Wakes up the mux thread, e.g. when input data was added
+	void notify();
+
+private:
+	uint32_t get_input_segment_count() const;
+	uint64_t get_input_sample_count(uint32_t segment_id) const;
+	bool all_input_segments_complete(uint32_t segment_id) const;
+	double get_input_samplerate(uint32_t segment_id) const;
+
+	shared_ptr<LogicSegment> get_output_segment(uint32_t segment_id);
+
+	void mux_samples(uint32_t segment_id, uint64_t start, uint64_t end);
+
+	void notify_listeners();
+
+	void wait_for_input();
+
+	void mux_proc();
+
+private:
+	const vector< pair<weak_ptr<Logic>, unsigned int> > inputs_;
+	const unsigned int unit_size_;
+	const shared_ptr<Logic> data_;
+
+	vector<uint8_t> buffer_;
+	atomic<uint64_t> mux_time_;
+	atomic<bool> valid_;
+
+	mutable mutex listener_mutex_;
+	vector< pair<const void*, function<void()> > > listeners_;
+
+	mutex input_mutex_;
+	condition_variable input_cond_;
+	bool input_changed_;  ///< Guarded by input_mutex_
+
+	std::thread thread_;
+	atomic<bool> interrupt_;
+};
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DATA_DECODE_LOGICMUX_HPP
@@ -17,21 +17,47 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <unordered_set>
+
+#include <boost/functional/hash.hpp>
 
 #include <pv/data/decode/decoder.hpp>
 #include <pv/data/decode/row.hpp>
 #include <pv/data/decode/rowdata.hpp>
 
+using std::copy;
+using std::lower_bound;
+using std::make_pair;
+using std::max;
+using std::min;
+using std::string;
+using std::unordered_set;
+using std::upper_bound;
 using std::vector;
 
 namespace pv {
 namespace data {
 namespace decode {
 
+// Small enough that scanning a block that overlaps the range only costs a
+// few annotations that end before it
+const size_t RowData::IndexBlockSize = 64;
+
+// Buckets range from 256 samples to 2^31 samples, which is coarse enough
+// for any capture we'd be able to show in one screen. Only the levels that
+// were queried are kept, usually those of a few zoom levels
+const unsigned int RowData::SummaryBaseShift = 8;
+const unsigned int RowData::SummaryLevelCount = 24;
+
 RowData::RowData(Row* row) :
+	summary_levels_(SummaryLevelCount),
+	summary_level_built_(SummaryLevelCount, false),
 	row_(row),
-	prev_ann_start_sample_(0)
+	prev_ann_start_sample_(0),
+	move_count_(0)
 {
 	assert(row);
 }
@@ -53,46 +79,134 @@ uint64_t RowData::get_annotation_count() const
 	return annotations_.size();
 }
 
+uint64_t RowData::get_annotation_count_before(uint64_t sample) const
+{
+	return lower_bound(annotations_.begin(), annotations_.end(), sample,
+		[](const Annotation& a, uint64_t s) { return a.start_sample() < s; }) -
+		annotations_.begin();
+}
+
+uint64_t RowData::get_memory_usage() const
+{
+	// Only the payload of the containers is counted, not their bookkeeping
+	uint64_t size = annotations_.size() * sizeof(Annotation) +
+		block_tree_.capacity() * sizeof(uint64_t);
+
+	for (const auto& entry : class_positions_)
+		size += entry.second.capacity() * sizeof(size_t);
+
+	for (const vector<AnnotationSummary>& buckets : summary_levels_)
+		size += buckets.capacity() * sizeof(AnnotationSummary);
+
+	for (const auto& entry : ann_properties_) {
+		size += entry.second.first.capacity() + sizeof(Annotation::Properties);
+		for (const QString& text : entry.second.second.texts)
+			size += text.capacity() * sizeof(QChar);
+	}
+
+	return size;
+}
+
 void RowData::get_annotation_subset(
 	deque<const pv::data::decode::Annotation*> &dest,
 	uint64_t start_sample, uint64_t end_sample) const
 {
 	// Determine whether we must apply per-class filtering or not
 	bool all_ann_classes_enabled = true;
-	bool all_ann_classes_disabled = true;
-
-	uint32_t max_ann_class_id = 0;
-	for (AnnotationClass* c : row_->ann_classes()) {
+	for (AnnotationClass* c : row_->ann_classes())
 		if (!c->visible())
 			all_ann_classes_enabled = false;
-		else
-			all_ann_classes_disabled = false;
-		if (c->id > max_ann_class_id)
-			max_ann_class_id = c->id;
+
+	// The annotations are sorted by start sample, so the ones starting
+	// after the range are cut off right away
+	const size_t count = upper_bound(annotations_.begin(), annotations_.end(),
+		end_sample, [](uint64_t sample, const Annotation& a) {
+			return sample < a.start_sample(); }) - annotations_.begin();
+
+	// Only the blocks with an annotation ending within or after the range
+	// are looked at, the tree finds them without going through the others
+	const size_t block_end = (count + IndexBlockSize - 1) / IndexBlockSize;
+
+	// Only go through the annotations of the visible classes if some are hidden
+	vector<const vector<size_t>*> class_positions;
+	if (!all_ann_classes_enabled)
+		for (AnnotationClass* c : row_->ann_classes()) {
+			if (!c->visible())
+				continue;
+
+			const auto entry = class_positions_.find(c->id);
+			if (entry != class_positions_.end())
+				class_positions.push_back(&(entry->second));
+		}
+
+	for (size_t block = find_block_ending_after(0, start_sample); block < block_end;
+		block = find_block_ending_after(block + 1, start_sample)) {
+		const size_t first_pos = block * IndexBlockSize;
+		const size_t end_pos = min(count, first_pos + IndexBlockSize);
+
+		if (all_ann_classes_enabled) {
+			for (size_t i = first_pos; i < end_pos; i++)
+				if (annotations_[i].end_sample() > start_sample)
+					dest.push_back(&(annotations_[i]));
+			continue;
+		}
+
+		for (const vector<size_t>* positions : class_positions)
+			for (auto it = lower_bound(positions->begin(), positions->end(), first_pos);
+				(it != positions->end()) && (*it < end_pos); it++)
+				if (annotations_[*it].end_sample() > start_sample)
+					dest.push_back(&(annotations_[*it]));
 	}
+}
 
-	if (all_ann_classes_enabled) {
-		// No filtering, send everyting out as-is
-		for (const auto& annotation : annotations_)
-			if ((annotation.end_sample() > start_sample) &&
-				(annotation.start_sample() <= end_sample))
-				dest.push_back(&annotation);
-	} else {
-		if (!all_ann_classes_disabled) {
-			// Filter out invisible annotation classes
-			vector<size_t> class_visible;
-			class_visible.resize(max_ann_class_id + 1, 0);
-			for (AnnotationClass* c : row_->ann_classes())
-				if (c->visible())
-					class_visible[c->id] = 1;
-
-			for (const auto& annotation : annotations_)
-				if ((class_visible[annotation.ann_class_id()]) &&
-					(annotation.end_sample() > start_sample) &&
-					(annotation.start_sample() <= end_sample))
-					dest.push_back(&annotation);
+bool RowData::get_annotation_summary(vector<AnnotationSummary> &dest,
+	deque<const pv::data::decode::Annotation*> &details,
+	uint64_t start_sample, uint64_t end_sample, uint64_t bucket_size,
+	uint64_t detail_length) const
+{
+	if (bucket_size < (1ULL << SummaryBaseShift))
+		return false;
+
+	unsigned int level = 0;
+	while ((level + 1 < SummaryLevelCount) &&
+		((1ULL << (SummaryBaseShift + level + 1)) <= bucket_size))
+		level++;
+
+	const unsigned int shift = SummaryBaseShift + level;
+	const uint64_t first_bucket = start_sample >> shift;
+	const uint64_t last_bucket = end_sample >> shift;
+
+	// Annotations that start before the first bucket but reach into the range
+	if (first_bucket > 0)
+		get_annotation_subset(details, start_sample, (first_bucket << shift) - 1);
+
+	if (!summary_level_built_[level]) {
+		for (const Annotation& a : annotations_)
+			add_to_summary(level, a);
+		summary_level_built_[level] = true;
+	}
+
+	const vector<AnnotationSummary>& buckets = summary_levels_[level];
+	auto it = lower_bound(buckets.begin(), buckets.end(), first_bucket,
+		[](const AnnotationSummary& s, uint64_t bucket) { return s.bucket < bucket; });
+
+	for (; (it != buckets.end()) && (it->bucket <= last_bucket); it++) {
+		if (it->max_length < detail_length) {
+			dest.push_back(*it);
+			continue;
 		}
+
+		// Some annotation is long enough to be shown on its own, so use
+		// the annotations themselves instead of the summary
+		const uint64_t bucket_start = it->bucket << shift;
+		const uint64_t bucket_end = bucket_start + (1ULL << shift);
+		auto ann_it = lower_bound(annotations_.begin(), annotations_.end(), bucket_start,
+			[](const Annotation& a, uint64_t sample) { return a.start_sample() < sample; });
+		for (; (ann_it != annotations_.end()) && (ann_it->start_sample() < bucket_end); ann_it++)
+			details.push_back(&(*ann_it));
 	}
+
+	return true;
 }
 
 const deque<Annotation>& RowData::annotations() const
@@ -100,60 +214,296 @@ const deque<Annotation>& RowData::annotations() const
 	return annotations_;
 }
 
-const Annotation* RowData::emplace_annotation(srd_proto_data *pdata)
+uint64_t RowData::get_move_count() const
 {
-	const srd_proto_data_annotation *const pda = (const srd_proto_data_annotation*)pdata->data;
+	return move_count_;
+}
 
-	uint32_t ann_class_id = pda->ann_class;
+const Annotation* RowData::find_annotation(uint32_t ann_class_id,
+	uint64_t sample, bool forward) const
+{
+	const auto entry = class_positions_.find(ann_class_id);
+	if (entry == class_positions_.end())
+		return nullptr;
 
-	// Look up the longest annotation text to see if we have it in storage.
-	// This implies that if the longest text is the same, the shorter texts
-	// are expected to be the same, too. PDs that violate this assumption
-	// should be considered broken.
-	const char* const* ann_texts = (char**)pda->ann_text;
-	const QString ann0 = QString::fromUtf8(ann_texts[0]);
-	vector<QString>* storage_entry = &(ann_texts_[ann0]);
+	const vector<size_t>& positions = entry->second;
 
-	if (storage_entry->empty()) {
-		while (*ann_texts) {
-			storage_entry->emplace_back(QString::fromUtf8(*ann_texts));
-			ann_texts++;
+	if (forward) {
+		const auto it = upper_bound(positions.begin(), positions.end(), sample,
+			[&](uint64_t s, size_t pos) { return s < annotations_[pos].start_sample(); });
+		return (it != positions.end()) ? &(annotations_[*it]) : nullptr;
+	}
+
+	const auto it = lower_bound(positions.begin(), positions.end(), sample,
+		[&](size_t pos, uint64_t s) { return annotations_[pos].start_sample() < s; });
+	return (it != positions.begin()) ? &(annotations_[*(it - 1)]) : nullptr;
+}
+
+const Annotation* RowData::emplace_annotation(uint64_t start_sample,
+	uint64_t end_sample, uint32_t ann_class_id, const char* const* ann_texts)
+{
+	// Look up the class and longest annotation text to see if we have them
+	// in storage. This implies that if the longest text is the same, the
+	// shorter texts are expected to be the same, too. PDs that violate this
+	// assumption should be considered broken.
+	// The lookup works on the UTF-8 bytes so that no QString has to be
+	// created unless the texts are new.
+	const char* const ann0 = ann_texts[0];
+	const size_t ann0_length = strlen(ann0);
+	size_t hash = boost::hash_range(ann0, ann0 + ann0_length);
+	boost::hash_combine(hash, ann_class_id);
+
+	const Annotation::Properties* properties = nullptr;
+
+	const auto range = ann_properties_.equal_range(hash);
+	for (auto it = range.first; it != range.second; it++)
+		if ((it->second.second.ann_class_id == ann_class_id) &&
+			(it->second.first.size() == ann0_length) &&
+			(memcmp(it->second.first.data(), ann0, ann0_length) == 0)) {
+			properties = &(it->second.second);
+			break;
 		}
-		storage_entry->shrink_to_fit();
+
+	if (!properties) {
+		vector<QString> texts;
+		for (const char* const* t = ann_texts; *t; t++)
+			texts.emplace_back(QString::fromUtf8(*t));
+		texts.shrink_to_fit();
+
+		properties = &(ann_properties_.emplace(hash, make_pair(string(ann0, ann0_length),
+			Annotation::Properties{this, ann_class_id, std::move(texts)}))->second.second);
 	}
 
+	return insert_annotation(start_sample, end_sample, properties);
+}
 
+void RowData::remove_annotations_before(uint64_t sample)
+{
+	const size_t count = get_annotation_count_before(sample);
+	if (count == 0)
+		return;
+
+	// Erasing at the front of a deque doesn't move the other annotations
+	annotations_.erase(annotations_.begin(), annotations_.begin() + count);
+	move_count_++;
+
+	rebuild_index();
+
+	unordered_set<const vector<QString>*> used_texts;
+	for (const Annotation& a : annotations_)
+		used_texts.insert(a.annotations());
+
+	for (auto it = ann_properties_.begin(); it != ann_properties_.end();)
+		if (used_texts.count(&(it->second.second.texts)) == 0)
+			it = ann_properties_.erase(it);
+		else
+			it++;
+}
+
+const Annotation* RowData::insert_annotation(uint64_t start_sample,
+	uint64_t end_sample, const Annotation::Properties* properties)
+{
 	const Annotation* result = nullptr;
 
 	// We insert the annotation in a way so that the annotation list
 	// is sorted by start sample. Otherwise, we'd have to sort when
 	// painting, which is expensive
 
-	if (pdata->start_sample < prev_ann_start_sample_) {
+	if (start_sample < prev_ann_start_sample_) {
 		// Find location to insert the annotation at
 
 		auto it = annotations_.end();
 		do {
 			it--;
-		} while ((it->start_sample() > pdata->start_sample) && (it != annotations_.begin()));
+		} while ((it->start_sample() > start_sample) && (it != annotations_.begin()));
 
 		// Allow inserting at the front
 		if (it != annotations_.begin())
 			it++;
 
-		it = annotations_.emplace(it, pdata->start_sample, pdata->end_sample,
-			storage_entry, ann_class_id, this);
+		it = annotations_.emplace(it, start_sample, end_sample, properties);
 		result = &(*it);
+		move_count_++;
+		update_index(it - annotations_.begin());
 	} else {
-		annotations_.emplace_back(pdata->start_sample, pdata->end_sample,
-			storage_entry, ann_class_id, this);
+		annotations_.emplace_back(start_sample, end_sample, properties);
 		result = &(annotations_.back());
-		prev_ann_start_sample_ = pdata->start_sample;
+		prev_ann_start_sample_ = start_sample;
+		update_index(annotations_.size() - 1);
 	}
 
 	return result;
 }
 
+void RowData::update_index(size_t pos)
+{
+	const size_t block_count = (annotations_.size() + IndexBlockSize - 1) / IndexBlockSize;
+	if (block_count > block_tree_.size() / 2)
+		resize_block_tree(block_count);
+
+	// An appended annotation can only raise the maximum of the last block
+	// while an inserted one moves all annotations that follow it
+	const bool appended = (pos == annotations_.size() - 1);
+	const size_t leaf_count = block_tree_.size() / 2;
+
+	if (appended) {
+		size_t node = leaf_count + pos / IndexBlockSize;
+		block_tree_[node] = max(block_tree_[node], annotations_[pos].end_sample());
+		for (node /= 2; node > 0; node /= 2)
+			block_tree_[node] = max(block_tree_[2 * node], block_tree_[2 * node + 1]);
+	} else {
+		for (size_t block = pos / IndexBlockSize; block < block_count; block++)
+			block_tree_[leaf_count + block] = get_block_max_end(block);
+		update_block_tree_parents(pos / IndexBlockSize, block_count - 1);
+	}
+
+	// Positions at or after an inserted annotation all move by one. They're
+	// at the end of each list, so this costs as much as the insert itself
+	if (!appended)
+		for (auto& entry : class_positions_)
+			for (auto it = entry.second.rbegin();
+				(it != entry.second.rend()) && (*it >= pos); it++)
+				(*it)++;
+
+	vector<size_t>& positions = class_positions_[annotations_[pos].ann_class_id()];
+	positions.insert(upper_bound(positions.begin(), positions.end(), pos), pos);
+
+	update_summary(annotations_[pos]);
+}
+
+void RowData::rebuild_index()
+{
+	const size_t block_count = (annotations_.size() + IndexBlockSize - 1) / IndexBlockSize;
+	block_tree_.clear();
+	resize_block_tree(block_count);
+	class_positions_.clear();
+	for (unsigned int level = 0; level < SummaryLevelCount; level++)
+		if (summary_level_built_[level]) {
+			summary_levels_[level] = vector<AnnotationSummary>();
+			summary_level_built_[level] = false;
+		}
+
+	const size_t leaf_count = block_tree_.size() / 2;
+	for (size_t i = 0; i < annotations_.size(); i++) {
+		const Annotation& a = annotations_[i];
+		uint64_t& max_end = block_tree_[leaf_count + i / IndexBlockSize];
+		max_end = max(max_end, a.end_sample());
+		class_positions_[a.ann_class_id()].push_back(i);
+	}
+
+	if (block_count > 0)
+		update_block_tree_parents(0, block_count - 1);
+}
+
+uint64_t RowData::get_block_max_end(size_t block) const
+{
+	const size_t end = min(annotations_.size(), (block + 1) * IndexBlockSize);
+
+	uint64_t max_end = 0;
+	for (size_t i = block * IndexBlockSize; i < end; i++)
+		max_end = max(max_end, annotations_[i].end_sample());
+
+	return max_end;
+}
+
+void RowData::resize_block_tree(size_t block_count)
+{
+	// The leaf count is a power of two so that every node has two children.
+	// Growing it by doubling keeps the cost per annotation constant
+	const size_t old_leaf_count = block_tree_.size() / 2;
+	size_t leaf_count = max(old_leaf_count, (size_t)1);
+	while (leaf_count < block_count)
+		leaf_count *= 2;
+
+	if (leaf_count == old_leaf_count)
+		return;
+
+	vector<uint64_t> tree(2 * leaf_count, 0);
+	copy(block_tree_.begin() + old_leaf_count, block_tree_.end(),
+		tree.begin() + leaf_count);
+	block_tree_.swap(tree);
+
+	if (old_leaf_count > 0)
+		update_block_tree_parents(0, old_leaf_count - 1);
+}
+
+void RowData::update_block_tree_parents(size_t first_block, size_t last_block)
+{
+	const size_t leaf_count = block_tree_.size() / 2;
+
+	for (size_t first = (leaf_count + first_block) / 2, last = (leaf_count + last_block) / 2;
+		first > 0; first /= 2, last /= 2)
+		for (size_t node = first; node <= last; node++)
+			block_tree_[node] = max(block_tree_[2 * node], block_tree_[2 * node + 1]);
+}
+
+size_t RowData::find_block_ending_after(size_t block, uint64_t sample) const
+{
+	const size_t leaf_count = block_tree_.size() / 2;
+	if (block >= leaf_count)
+		return leaf_count;
+
+	// Go right until a subtree holds a matching block, moving up while the
+	// node is the right child of its parent. The root is node 1, so moving
+	// up from it ends at 0
+	size_t node = leaf_count + block;
+	while (block_tree_[node] <= sample) {
+		while (node & 1)
+			node /= 2;
+		if (node == 0)
+			return leaf_count;
+		node++;
+	}
+
+	// Then go down to the first matching block within that subtree
+	while (node < leaf_count)
+		node = (block_tree_[2 * node] > sample) ? (2 * node) : (2 * node + 1);
+
+	return node - leaf_count;
+}
+
+void RowData::update_summary(const Annotation& a)
+{
+	for (unsigned int level = 0; level < SummaryLevelCount; level++)
+		if (summary_level_built_[level])
+			add_to_summary(level, a);
+}
+
+void RowData::add_to_summary(unsigned int level, const Annotation& a) const
+{
+	const uint64_t length = a.end_sample() - a.start_sample();
+	const uint64_t bucket = a.start_sample() >> (SummaryBaseShift + level);
+	vector<AnnotationSummary>& buckets = summary_levels_[level];
+
+	// Annotations mostly arrive in order, so the bucket is usually the last one
+	auto it = buckets.end();
+	if (buckets.empty() || (buckets.back().bucket < bucket))
+		it = buckets.insert(it, AnnotationSummary());
+	else {
+		it = lower_bound(buckets.begin(), buckets.end(), bucket,
+			[](const AnnotationSummary& s, uint64_t b) { return s.bucket < b; });
+		if (it->bucket != bucket)
+			it = buckets.insert(it, AnnotationSummary());
+	}
+
+	AnnotationSummary& s = *it;
+	if (s.count == 0) {
+		s.bucket = bucket;
+		s.start_sample = a.start_sample();
+		s.end_sample = a.end_sample();
+		s.max_length = length;
+		s.ann_class = a.ann_class_id();
+		s.class_uniform = true;
+	} else {
+		s.start_sample = min(s.start_sample, a.start_sample());
+		s.end_sample = max(s.end_sample, a.end_sample());
+		s.max_length = max(s.max_length, length);
+		if (a.ann_class_id() != s.ann_class)
+			s.class_uniform = false;
+	}
+	s.count++;
+}
+
 }  // namespace decode
 }  // namespace data
 }  // namespace pv
@@ -20,11 +20,13 @@
 #ifndef PULSEVIEW_PV_DATA_DECODE_ROWDATA_HPP
 #define PULSEVIEW_PV_DATA_DECODE_ROWDATA_HPP
 
+#include <deque>
+#include <map>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-#include <QtGlobal>
-#include <QHash>
 #include <QString>
 
 #include <libsigrokdecode/libsigrokdecode.h>
@@ -32,17 +34,10 @@
 #include <pv/data/decode/annotation.hpp>
 
 using std::deque;
-using std::unordered_map;
-
-#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
-namespace std {
-	template<> struct hash<QString> {
-		std::size_t operator()(const QString& s) const noexcept {
-			return (size_t) qHash(s);
-		}
-	};
-}
-#endif
+using std::map;
+using std::pair;
+using std::string;
+using std::unordered_multimap;
 
 namespace pv {
 namespace data {
@@ -50,8 +45,28 @@ namespace decode {
 
 class Row;
 
+/**
+ * Summary of the annotations that start within one bucket of samples. It's
+ * used to draw annotations as blocks without looking at each of them.
+ */
+struct AnnotationSummary
+{
+	uint64_t bucket;
+	uint64_t start_sample;  ///< Lowest start sample in the bucket
+	uint64_t end_sample;  ///< Highest end sample in the bucket
+	uint64_t max_length;  ///< Length of the longest annotation in the bucket
+	uint64_t count;
+	uint32_t ann_class;  ///< Class of the first annotation in the bucket
+	bool class_uniform;  ///< Whether all annotations are of that class
+};
+
 class RowData
 {
+private:
+	static const size_t IndexBlockSize;
+	static const unsigned int SummaryBaseShift;
+	static const unsigned int SummaryLevelCount;
+
 public:
 	RowData(Row* row);
 
@@ -61,23 +76,117 @@ public:
 
 	uint64_t get_annotation_count() const;
 
+	/// Returns the number of annotations that start before the given sample
+	uint64_t get_annotation_count_before(uint64_t sample) const;
+
+	/// Returns about how many bytes the annotations, their texts and indices use
+	uint64_t get_memory_usage() const;
+
 	/**
 	 * Extracts annotations between the given sample range into a vector.
 	 * Note: The annotations are unsorted and only annotations that fully
 	 * fit into the sample range are considered.
+	 * Annotations are looked up by their start sample and a tree of the
+	 * maximum end sample of blocks of annotations, so only blocks that can
+	 * overlap the range are scanned. If classes are hidden, only the annotations of the
+	 * visible classes are looked at.
 	 */
 	void get_annotation_subset(deque<const pv::data::decode::Annotation*> &dest,
 		uint64_t start_sample, uint64_t end_sample) const;
 
+	/**
+	 * Extracts summaries of the annotations in the given sample range, using
+	 * the largest buckets that aren't larger than @a bucket_size samples.
+	 * Buckets that contain annotations at least @a detail_length samples long
+	 * are not summarized, their annotations are added to @a details instead,
+	 * as are annotations that started before the first bucket.
+	 * The summaries of a bucket size are only built when they're first asked
+	 * for, so this must not be called concurrently with other readers.
+	 * @return false if @a bucket_size is below the smallest bucket size, in
+	 * which case nothing is extracted.
+	 */
+	bool get_annotation_summary(vector<AnnotationSummary> &dest,
+		deque<const pv::data::decode::Annotation*> &details,
+		uint64_t start_sample, uint64_t end_sample, uint64_t bucket_size,
+		uint64_t detail_length) const;
+
 	const deque<Annotation>& annotations() const;
 
-	const Annotation* emplace_annotation(srd_proto_data *pdata);
+	/**
+	 * Returns how often annotations were moved in memory, which happens when
+	 * one is inserted before the end of the deque or some are removed.
+	 * Pointers to annotations are only valid while this doesn't change.
+	 */
+	uint64_t get_move_count() const;
+
+	/**
+	 * Finds the first annotation of the given class that starts after
+	 * @a sample or, if @a forward is false, the last one that starts
+	 * before it.
+	 * @return nullptr if there is no such annotation.
+	 */
+	const Annotation* find_annotation(uint32_t ann_class_id, uint64_t sample,
+		bool forward) const;
+
+	/**
+	 * Adds an annotation with the texts given as a null-terminated array,
+	 * as the decoders provide them.
+	 */
+	const Annotation* emplace_annotation(uint64_t start_sample, uint64_t end_sample,
+		uint32_t ann_class_id, const char* const* ann_texts);
+
+	/**
+	 * Removes the annotations that start before the given sample, along with
+	 * the texts that aren't used anymore. The indices are rebuilt, so this is
+	 * meant for removing many annotations at once. Pointers to the remaining
+	 * annotations stay valid.
+	 */
+	void remove_annotations_before(uint64_t sample);
+
+private:
+	const Annotation* insert_annotation(uint64_t start_sample, uint64_t end_sample,
+		const Annotation::Properties* properties);
+
+	/**
+	 * Updates the block and class indices after the annotation at the given
+	 * position was added. The blocks up to it stay as they are.
+	 */
+	void update_index(size_t pos);
+
+	/// Builds the block, class and summary indices from scratch
+	void rebuild_index();
+
+	/// Returns the highest end sample of the annotations in the given block
+	uint64_t get_block_max_end(size_t block) const;
+
+	/// Makes room for the given number of blocks in the tree
+	void resize_block_tree(size_t block_count);
+
+	/// Updates the tree nodes above the given range of blocks
+	void update_block_tree_parents(size_t first_block, size_t last_block);
+
+	/**
+	 * Returns the first block at or after the given one that contains an
+	 * annotation ending after @a sample, or the tree's leaf count if none does.
+	 */
+	size_t find_block_ending_after(size_t block, uint64_t sample) const;
+
+	/// Adds the given annotation to the bucket it starts in on every built level
+	void update_summary(const Annotation& a);
+
+	/// Adds the given annotation to the bucket it starts in on the given level
+	void add_to_summary(unsigned int level, const Annotation& a) const;
 
 private:
 	deque<Annotation> annotations_;
-	unordered_map<QString, vector<QString> > ann_texts_;  // unordered_map since pointers must not change
+	vector<uint64_t> block_tree_;  ///< Max-end segment tree, the second half holds the highest end sample of each block
+	map<uint32_t, vector<size_t> > class_positions_;  ///< Sorted positions of each class' annotations
+	mutable vector< vector<AnnotationSummary> > summary_levels_;  ///< Non-empty buckets of each level, sorted
+	mutable vector<bool> summary_level_built_;  ///< Levels are built on their first query
+	unordered_multimap<size_t, pair<string, Annotation::Properties> > ann_properties_;  // Keyed by the hash of the class and the first text's UTF-8 bytes, node based since pointers must not change
 	Row* row_;
 	uint64_t prev_ann_start_sample_;
+	uint64_t move_count_;
 };
 
 }  // namespace decode
@@ -19,11 +19,20 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <cstring>
 #include <forward_list>
 #include <limits>
 
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
 #include <QRegularExpression>
 #endif
@@ -33,18 +42,32 @@
 #include "decodesignal.hpp"
 #include "signaldata.hpp"
 
+#ifdef HAVE_SHM_OPEN
+#include <pv/data/decode/decodeprocess.hpp>
+#endif
 #include <pv/data/decode/decoder.hpp>
+#include <pv/data/decode/idlegaps.hpp>
 #include <pv/data/decode/row.hpp>
+#include <pv/decoderloader.hpp>
 #include <pv/globalsettings.hpp>
 #include <pv/session.hpp>
 
 using std::dynamic_pointer_cast;
 using std::lock_guard;
+using std::lower_bound;
+using std::max;
+using std::make_pair;
 using std::make_shared;
 using std::min;
+using std::numeric_limits;
 using std::out_of_range;
 using std::shared_ptr;
+using std::sort;
+using std::unique;
 using std::unique_lock;
+using std::upper_bound;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
 using pv::data::decode::AnnotationClass;
 using pv::data::decode::DecodeChannel;
 
@@ -54,18 +77,199 @@ namespace data {
 const double DecodeSignal::DecodeMargin = 1.0;
 const double DecodeSignal::DecodeThreshold = 0.2;
 const int64_t DecodeSignal::DecodeChunkLength = 256 * 1024;
+// Python decoders share the interpreter lock, so more threads don't pay off
+const unsigned int DecodeSignal::MaxDecodeThreads = 4;
+// Roughly a hundred bit times of a 115200 baud UART or a 100 kHz I2C bus
+const double DecodeSignal::SplitIdleGapTime = 0.001;
+const uint64_t DecodeSignal::SplitMinPartitionLength = 4 * 1024 * 1024;
+// Bounds the annotations a decode thread collects, e.g. when a decoder
+// emits its output all at once at the end of the data
+const size_t DecodeSignal::AnnotationBatchSize = 16 * 1024;
+// Must be increased whenever the cache file layout or the key changes
+const uint32_t DecodeSignal::CacheFormatVersion = 2;
+// The least recently written cache files are removed beyond this size
+const qint64 DecodeSignal::CacheMaxSize = 2LL * 1024 * 1024 * 1024;
+
+static const quint32 CacheFileMagic = 0x50564443;  // "PVDC"
+
+// Large enough that a page holds many chunks of a typical decoder
+const uint64_t DecodeBinaryClass::PageSize = 64 * 1024;
+
+struct CachedAnnotation
+{
+	quint32 decoder_index;
+	quint64 start_sample, end_sample;
+	quint32 ann_class_id;
+	vector<quint32> texts;  ///< Indices into the text table of the cache file
+};
+
+struct CachedBinaryChunk
+{
+	quint32 decoder_index;
+	quint32 bin_class_id;
+	quint64 sample;
+	vector<uint8_t> data;
+};
+
+static QString get_cache_dir()
+{
+	return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/decode";
+}
+
+/**
+ * Adds the names, sizes and modification times of the files of a decoder
+ * module to the hash, so that cached results aren't used anymore once the
+ * decoder was changed. The module is looked up in the search paths the same
+ * way libsigrokdecode does it, assuming its directory is named like it.
+ */
+static void add_decoder_files(QCryptographicHash &hash, const char *module)
+{
+	GSList *paths = srd_searchpaths_get();
+	for (GSList *l = paths; l; l = l->next) {
+		const QDir dir(QString::fromUtf8((const char*)l->data) + "/" + module);
+		if (!dir.exists())
+			continue;
+
+		for (const QFileInfo& info : dir.entryInfoList(QDir::Files, QDir::Name)) {
+			const qint64 size = info.size();
+			const qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+			hash.addData(info.fileName().toUtf8());
+			hash.addData(QByteArray((const char*)&size, sizeof(size)));
+			hash.addData(QByteArray((const char*)&mtime, sizeof(mtime)));
+		}
+		break;
+	}
+	g_slist_free_full(paths, g_free);
+}
+
+static uint64_t elapsed_ns(steady_clock::time_point start)
+{
+	return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+}
+
+static void write_cache_blob(QDataStream &stream, const uint8_t *data, uint64_t size)
+{
+	stream << (quint64)size;
+
+	// writeRawData() takes an int, so larger blobs are written in pieces
+	const uint64_t max_piece = numeric_limits<int>::max();
+	for (uint64_t i = 0; i < size; i += max_piece)
+		stream.writeRawData((const char*)data + i, (int)min(size - i, max_piece));
+}
+
+static bool read_cache_blob(QDataStream &stream, vector<uint8_t> &data)
+{
+	quint64 size;
+	stream >> size;
+
+	// Don't trust the size of a damaged file
+	if ((stream.status() != QDataStream::Ok) ||
+		(size > (quint64)stream.device()->bytesAvailable()))
+		return false;
+
+	data.resize(size);
+
+	const uint64_t max_piece = numeric_limits<int>::max();
+	for (uint64_t i = 0; i < size; i += max_piece) {
+		const int piece = (int)min(size - i, max_piece);
+		if (stream.readRawData((char*)data.data() + i, piece) != piece)
+			return false;
+	}
+
+	return true;
+}
+
+
+void DecodeBinaryClass::append(uint64_t sample, const uint8_t* data, uint64_t length)
+{
+	// The data is added before the chunk so that readers never see a chunk
+	// without its data
+	uint64_t end = size;
+	while (length > 0) {
+		const uint64_t page_offset = end % PageSize;
+		if (page_offset == 0)
+			pages.emplace_back(PageSize);
+
+		const uint64_t n = min(length, PageSize - page_offset);
+		memcpy(pages.back().data() + page_offset, data, n);
+		data += n;
+		length -= n;
+		end += n;
+	}
+
+	if (!chunks.empty() && (sample < chunks.back().sample))
+		chunks_in_sample_order = false;
+
+	chunks.push_back({size, sample});
+	size = end;
+}
+
+uint64_t DecodeBinaryClass::chunk_size(size_t chunk_id) const
+{
+	const uint64_t end = ((chunk_id + 1) < chunks.size()) ?
+		chunks[chunk_id + 1].offset : size;
+
+	return end - chunks[chunk_id].offset;
+}
+
+size_t DecodeBinaryClass::chunk_at_offset(uint64_t offset) const
+{
+	// Empty chunks share their offset with the next chunk, which is the
+	// one that is found
+	const auto it = upper_bound(chunks.begin(), chunks.end(), offset,
+		[](uint64_t o, const DecodeBinaryDataChunk& c) { return o < c.offset; });
+
+	return (it != chunks.begin()) ? (it - chunks.begin() - 1) : 0;
+}
+
+uint8_t DecodeBinaryClass::byte_at(uint64_t offset) const
+{
+	return pages[offset / PageSize][offset % PageSize];
+}
 
+void DecodeBinaryClass::for_each_span(uint64_t start, uint64_t end,
+	function<void(const uint8_t*, uint64_t)> f) const
+{
+	end = min(end, size);
+
+	while (start < end) {
+		const uint64_t page_offset = start % PageSize;
+		const uint64_t n = min(end - start, PageSize - page_offset);
+		f(pages[start / PageSize].data() + page_offset, n);
+		start += n;
+	}
+}
 
 DecodeSignal::DecodeSignal(pv::Session &session) :
 	SignalBase(nullptr, SignalBase::DecodeChannel),
 	session_(session),
-	srd_session_(nullptr),
 	logic_mux_data_invalid_(false),
+	decode_from_input_(false),
 	stack_config_changed_(true),
-	current_segment_id_(0)
+	busy_decode_threads_(0),
+	decode_in_order_(true),
+	priority_segment_(0),
+	split_at_idle_gaps_(false),
+	use_decode_processes_(false),
+	cache_results_(false),
+	annotation_limit_enabled_(true),
+	max_annotations_(0),
+	decode_range_set_(false),
+	decode_range_start_(0),
+	decode_range_end_(0),
+	decode_range_warm_up_(0),
+	stats_run_time_(0),
+	stats_send_time_(0),
+	stats_callback_time_(0),
+	stats_lock_wait_time_(0),
+	stats_samples_decoded_(0)
 {
 	connect(&session_, SIGNAL(capture_state_changed(int)),
 		this, SLOT(on_capture_state_changed(int)));
+
+	// Connected first so that old annotations are discarded before the
+	// views look at the new ones
+	connect(this, SIGNAL(new_annotations()), this, SLOT(on_new_annotations()));
 }
 
 DecodeSignal::~DecodeSignal()
@@ -145,6 +349,20 @@ void DecodeSignal::remove_decoder(int index)
 	begin_decode();
 }
 
+void DecodeSignal::set_decoder_option(const shared_ptr<Decoder> &dec,
+	const char *id, GVariant *value)
+{
+	assert(dec);
+
+	// The decode threads read the options when they set up their decoder
+	// instances, so they must be done before the options change
+	join_decode_threads();
+
+	dec->set_option(id, value);
+
+	begin_decode();
+}
+
 bool DecodeSignal::toggle_decoder_visibility(int index)
 {
 	auto iter = stack_.cbegin();
@@ -165,34 +383,35 @@ bool DecodeSignal::toggle_decoder_visibility(int index)
 
 void DecodeSignal::reset_decode(bool shutting_down)
 {
-	resume_decode();  // Make sure the decode thread isn't blocked by pausing
-
-	if (stack_config_changed_ || shutting_down)
-		stop_srd_session();
-	else
-		terminate_srd_session();
+	resume_decode();  // Make sure the decode threads aren't blocked by pausing
 
-	if (decode_thread_.joinable()) {
+	// Terminating the sessions also interrupts decoders that are still busy
+	if (decode_threads_running())
 		decode_interrupt_ = true;
-		decode_input_cond_.notify_one();
-		decode_thread_.join();
-	}
+	for (DecodeWorker& worker : decode_workers_)
+		terminate_srd_session(worker);
 
-	if (logic_mux_thread_.joinable()) {
-		logic_mux_interrupt_ = true;
-		logic_mux_cond_.notify_one();
-		logic_mux_thread_.join();
-	}
+	join_decode_threads();
+
+	if (stack_config_changed_ || shutting_down)
+		for (DecodeWorker& worker : decode_workers_)
+			stop_srd_session(worker);
+
+	// The mux keeps running for the other decode signals that use it
+	if (logic_mux_)
+		logic_mux_->remove_listener(this);
 
-	current_segment_id_ = 0;
 	segments_.clear();
+	decode_splits_.clear();
 
 	for (const shared_ptr<decode::Decoder>& dec : stack_)
 		if (dec->has_logic_output())
 			output_logic_[dec->get_srd_decoder()]->clear();
 
-	logic_mux_data_.reset();
-	logic_mux_data_invalid_ = true;
+	// The muxed data is kept for the next run unless its input changed
+	if (logic_mux_data_invalid_ || shutting_down)
+		release_logic_mux();
+	decode_input_data_.reset();
 
 	if (!error_message_.isEmpty()) {
 		error_message_.clear();
@@ -205,20 +424,17 @@ void DecodeSignal::reset_decode(bool shutting_down)
 
 void DecodeSignal::begin_decode()
 {
-	if (decode_thread_.joinable()) {
-		decode_interrupt_ = true;
-		decode_input_cond_.notify_one();
-		decode_thread_.join();
-	}
-
-	if (logic_mux_thread_.joinable()) {
-		logic_mux_interrupt_ = true;
-		logic_mux_cond_.notify_one();
-		logic_mux_thread_.join();
-	}
+	join_decode_threads();
 
 	reset_decode();
 
+	stats_start_time_ = steady_clock::now();
+	stats_run_time_ = 0;
+	stats_send_time_ = 0;
+	stats_callback_time_ = 0;
+	stats_lock_wait_time_ = 0;
+	stats_samples_decoded_ = 0;
+
 	if (stack_.size() == 0) {
 		set_error_message(tr("No decoders"));
 		return;
@@ -246,26 +462,91 @@ void DecodeSignal::begin_decode()
 			return;
 		}
 
-	// Free the logic data and its segment(s) if it needs to be updated
-	if (logic_mux_data_invalid_)
-		logic_mux_data_.reset();
+	const shared_ptr<Logic> direct_input_data = get_direct_input_data();
+	if ((direct_input_data != nullptr) != decode_from_input_) {
+		// The data of the assigned signals changed since the decoder channels
+		// were committed, so the bit positions the decoders use are stale
+		logic_mux_data_invalid_ = true;
+		for (DecodeWorker& worker : decode_workers_)
+			stop_srd_session(worker);
+		commit_decoder_channels();
+	}
+
+	// Stop using the muxed data if it needs to be updated. If only decoder
+	// options or the stack changed, the muxed data is reused
+	const vector<LogicMux::Input> mux_inputs = get_logic_mux_inputs();
+	if (logic_mux_ && (logic_mux_data_invalid_ || decode_from_input_ ||
+		!logic_mux_->has_inputs(mux_inputs)))
+		release_logic_mux();
 
-	if (!logic_mux_data_) {
-		const uint32_t ch_count = get_assigned_signal_count();
-		logic_mux_unit_size_ = (ch_count + 7) / 8;
-		logic_mux_data_ = make_shared<Logic>(ch_count);
+	if (decode_from_input_) {
+		decode_input_data_ = direct_input_data;
+	} else {
+		// Other decode signals with the same inputs may have muxed them already
+		if (!logic_mux_) {
+			logic_mux_ = session_.get_logic_mux(mux_inputs);
+			logic_mux_data_invalid_ = false;
+		}
+		decode_input_data_ = logic_mux_->data();
 	}
 
 	if (get_input_segment_count() == 0)
 		set_error_message(tr("No input data"));
 
-	// Make sure the logic output data is complete and up-to-date
-	logic_mux_interrupt_ = false;
-	logic_mux_thread_ = std::thread(&DecodeSignal::logic_mux_proc, this);
+	// Make sure the muxed data is complete and up-to-date
+	if (!decode_from_input_) {
+		logic_mux_->add_listener(this, [this]() { notify_decode_threads(); });
+		logic_mux_->start();
+	}
+
+	// Decode the input data, with several segments being decoded at the same
+	// time. Logic output is appended in the order it is produced, so the
+	// segments must be decoded one after another in that case
+	decode_in_order_ = false;
+	for (const shared_ptr<Decoder>& dec : stack_)
+		if (dec->has_logic_output())
+			decode_in_order_ = true;
+
+	// Splitting a segment at idle gaps assumes that the decoders don't
+	// carry state across them, so it has to be enabled by the user
+	GlobalSettings settings;
+	split_at_idle_gaps_ = settings.value(GlobalSettings::Key_Dec_SplitAtIdleGaps).toBool();
+
+	max_annotations_ = annotation_limit_enabled_ ?
+		settings.value(GlobalSettings::Key_Dec_MaxAnnotations).toUInt() * 1000000ULL : 0;
+
+	// Results with discarded annotations can't be reused
+	cache_results_ = settings.value(GlobalSettings::Key_Dec_CacheResults).toBool() &&
+		(max_annotations_ == 0);
+
+#ifdef HAVE_SHM_OPEN
+	// Helper processes don't support logic output, which must be decoded in order
+	use_decode_processes_ = !decode_in_order_ &&
+		settings.value(GlobalSettings::Key_Dec_UseProcesses).toBool();
+#endif
+
+	const unsigned int thread_count = decode_in_order_ ? 1 : get_decode_thread_count();
+
+	while (decode_workers_.size() > thread_count) {
+		stop_srd_session(decode_workers_.back());
+		decode_workers_.pop_back();
+	}
+
+	while (decode_workers_.size() < thread_count) {
+		decode_workers_.emplace_back();
+		decode_workers_.back().owner = this;
+	}
+
+	{
+		lock_guard<mutex> lock(input_mutex_);
+		segment_claimed_.clear();
+		decode_splits_.clear();
+		busy_decode_threads_ = 0;
+	}
 
-	// Decode the muxed logic data
 	decode_interrupt_ = false;
-	decode_thread_ = std::thread(&DecodeSignal::decode_proc, this);
+	for (DecodeWorker& worker : decode_workers_)
+		worker.thread = std::thread(&DecodeSignal::decode_proc, this, &worker);
 }
 
 void DecodeSignal::pause_decode()
@@ -278,7 +559,7 @@ void DecodeSignal::resume_decode()
 	// Manual unlocking is done before notifying, to avoid waking up the
 	// waiting thread only to block again (see notify_one for details)
 	decode_pause_mutex_.unlock();
-	decode_pause_cond_.notify_one();
+	decode_pause_cond_.notify_all();
 	decode_paused_ = false;
 }
 
@@ -287,6 +568,56 @@ bool DecodeSignal::is_paused() const
 	return decode_paused_;
 }
 
+bool DecodeSignal::is_decode_finished() const
+{
+	// The run time is only set when the last segment was decoded
+	return stats_run_time_ > 0;
+}
+
+void DecodeSignal::set_annotation_limit_enabled(bool enabled)
+{
+	annotation_limit_enabled_ = enabled;
+}
+
+void DecodeSignal::set_priority_segment(uint32_t segment_id)
+{
+	priority_segment_ = segment_id;
+}
+
+void DecodeSignal::set_decode_range(uint64_t start_sample, uint64_t end_sample,
+	uint64_t warm_up)
+{
+	decode_range_set_ = true;
+	decode_range_start_ = min(start_sample, end_sample);
+	decode_range_end_ = max(start_sample, end_sample);
+	decode_range_warm_up_ = warm_up;
+
+	begin_decode();
+}
+
+void DecodeSignal::clear_decode_range()
+{
+	if (!decode_range_set_)
+		return;
+
+	decode_range_set_ = false;
+
+	begin_decode();
+}
+
+bool DecodeSignal::has_decode_range() const
+{
+	return decode_range_set_;
+}
+
+pair<uint64_t, uint64_t> DecodeSignal::decode_range() const
+{
+	if (!decode_range_set_)
+		return make_pair(0, std::numeric_limits<uint64_t>::max());
+
+	return make_pair(decode_range_start_, decode_range_end_);
+}
+
 const vector<decode::DecodeChannel> DecodeSignal::get_channels() const
 {
 	return channels_;
@@ -357,7 +688,6 @@ void DecodeSignal::auto_assign_signals(const shared_ptr<Decoder> dec)
 		// Receive notifications when new sample data is available
 		connect_input_notifiers();
 
-		logic_mux_data_invalid_ = true;
 		stack_config_changed_ = true;
 		commit_decoder_channels();
 		channels_updated();
@@ -370,10 +700,8 @@ void DecodeSignal::assign_signal(const uint16_t channel_id, shared_ptr<const Sig
 	disconnect_input_notifiers();
 
 	for (decode::DecodeChannel& ch : channels_)
-		if (ch.id == channel_id) {
+		if (ch.id == channel_id)
 			ch.assigned_signal = signal;
-			logic_mux_data_invalid_ = true;
-		}
 
 	// Receive notifications when new sample data is available
 	connect_input_notifiers();
@@ -579,6 +907,20 @@ uint64_t DecodeSignal::get_annotation_count(const Row* row, uint32_t segment_id)
 	return rd->get_annotation_count();
 }
 
+uint64_t DecodeSignal::get_annotation_count(uint32_t segment_id) const
+{
+	lock_guard<mutex> lock(output_mutex_);
+
+	if (segment_id >= segments_.size())
+		return 0;
+
+	uint64_t count = 0;
+	for (const auto& row_data : segments_.at(segment_id).annotation_rows)
+		count += row_data.second.get_annotation_count();
+
+	return count;
+}
+
 void DecodeSignal::get_annotation_subset(deque<const Annotation*> &dest,
 	const Row* row, uint32_t segment_id, uint64_t start_sample,
 	uint64_t end_sample) const
@@ -608,36 +950,60 @@ void DecodeSignal::get_annotation_subset(deque<const Annotation*> &dest,
 		get_annotation_subset(dest, row, segment_id, start_sample, end_sample);
 }
 
-uint32_t DecodeSignal::get_binary_data_chunk_count(uint32_t segment_id,
-	const Decoder* dec, uint32_t bin_class_id) const
+bool DecodeSignal::get_annotation_summary(vector<AnnotationSummary> &dest,
+	deque<const Annotation*> &details, const Row* row, uint32_t segment_id,
+	uint64_t start_sample, uint64_t end_sample, uint64_t bucket_size,
+	uint64_t detail_length) const
 {
-	if ((segments_.size() == 0) || (segment_id >= segments_.size()))
-		return 0;
+	lock_guard<mutex> lock(output_mutex_);
 
-	const DecodeSegment *segment = &(segments_[segment_id]);
+	if (segment_id >= segments_.size())
+		return true;
 
-	for (const DecodeBinaryClass& bc : segment->binary_classes)
-		if ((bc.decoder == dec) && (bc.info->bin_class_id == bin_class_id))
-			return bc.chunks.size();
+	const DecodeSegment* segment = &(segments_.at(segment_id));
+
+	auto row_it = segment->annotation_rows.find(row);
+	if (row_it == segment->annotation_rows.end())
+		return true;
 
-	return 0;
+	return row_it->second.get_annotation_summary(dest, details, start_sample,
+		end_sample, bucket_size, detail_length);
 }
 
-void DecodeSignal::get_binary_data_chunk(uint32_t segment_id,
-	const  Decoder* dec, uint32_t bin_class_id, uint32_t chunk_id,
-	const vector<uint8_t> **dest, uint64_t *size)
+bool DecodeSignal::find_annotation(const Row* row, uint32_t segment_id,
+	uint32_t ann_class_id, uint64_t sample, bool forward,
+	uint64_t &start_sample, uint64_t &end_sample) const
 {
+	lock_guard<mutex> lock(output_mutex_);
+
 	if (segment_id >= segments_.size())
-		return;
+		return false;
 
-	const DecodeSegment *segment = &(segments_[segment_id]);
+	const DecodeSegment* segment = &(segments_.at(segment_id));
 
-	for (const DecodeBinaryClass& bc : segment->binary_classes)
-		if ((bc.decoder == dec) && (bc.info->bin_class_id == bin_class_id)) {
-			if (dest) *dest = &(bc.chunks.at(chunk_id).data);
-			if (size) *size = bc.chunks.at(chunk_id).data.size();
-			return;
-		}
+	auto row_it = segment->annotation_rows.find(row);
+	if (row_it == segment->annotation_rows.end())
+		return false;
+
+	const Annotation* a = row_it->second.find_annotation(ann_class_id, sample, forward);
+	if (!a)
+		return false;
+
+	start_sample = a->start_sample();
+	end_sample = a->end_sample();
+
+	return true;
+}
+
+uint32_t DecodeSignal::get_binary_data_chunk_count(uint32_t segment_id,
+	const Decoder* dec, uint32_t bin_class_id) const
+{
+	lock_guard<mutex> lock(output_mutex_);
+
+	const DecodeBinaryClass* bin_class =
+		get_binary_data_class(segment_id, dec, bin_class_id);
+
+	return bin_class ? bin_class->chunks.size() : 0;
 }
 
 void DecodeSignal::get_merged_binary_data_chunks_by_sample(uint32_t segment_id,
@@ -646,38 +1012,42 @@ void DecodeSignal::get_merged_binary_data_chunks_by_sample(uint32_t segment_id,
 {
 	assert(dest != nullptr);
 
-	if (segment_id >= segments_.size())
+	lock_guard<mutex> lock(output_mutex_);
+
+	const DecodeBinaryClass* bin_class =
+		get_binary_data_class(segment_id, dec, bin_class_id);
+	if (!bin_class)
 		return;
 
-	const DecodeSegment *segment = &(segments_[segment_id]);
+	const deque<DecodeBinaryDataChunk>& chunks = bin_class->chunks;
 
-	const DecodeBinaryClass* bin_class = nullptr;
-	for (const DecodeBinaryClass& bc : segment->binary_classes)
-		if ((bc.decoder == dec) && (bc.info->bin_class_id == bin_class_id))
-			bin_class = &bc;
-
-	// Determine overall size before copying to resize dest vector only once
-	uint64_t size = 0;
-	uint64_t matches = 0;
-	for (const DecodeBinaryDataChunk& chunk : bin_class->chunks)
-		if ((chunk.sample >= start_sample) && (chunk.sample < end_sample)) {
-			size += chunk.data.size();
-			matches++;
-		}
-	dest->resize(size);
-
-	uint64_t offset = 0;
-	uint64_t matches2 = 0;
-	for (const DecodeBinaryDataChunk& chunk : bin_class->chunks)
-		if ((chunk.sample >= start_sample) && (chunk.sample < end_sample)) {
-			memcpy(dest->data() + offset, chunk.data.data(), chunk.data.size());
-			offset += chunk.data.size();
-			matches2++;
-
-			// Make sure we don't overwrite memory if the array grew in the meanwhile
-			if (matches2 == matches)
-				break;
-		}
+	if (bin_class->chunks_in_sample_order) {
+		// The chunks within the sample range are stored back to back
+		auto by_sample = [](const DecodeBinaryDataChunk& c, uint64_t sample) {
+			return c.sample < sample; };
+		const auto first = lower_bound(chunks.begin(), chunks.end(), start_sample, by_sample);
+		const auto last = lower_bound(first, chunks.end(), end_sample, by_sample);
+
+		const uint64_t start = (first != chunks.end()) ? first->offset : bin_class->size;
+		const uint64_t end = (last != chunks.end()) ? last->offset : bin_class->size;
+
+		dest->resize(end - start);
+		uint8_t* d = dest->data();
+		bin_class->for_each_span(start, end, [&](const uint8_t* data, uint64_t size) {
+			memcpy(d, data, size);
+			d += size;
+		});
+		return;
+	}
+
+	dest->clear();
+	for (size_t i = 0; i < chunks.size(); i++)
+		if ((chunks[i].sample >= start_sample) && (chunks[i].sample < end_sample))
+			bin_class->for_each_span(chunks[i].offset,
+				chunks[i].offset + bin_class->chunk_size(i),
+				[&](const uint8_t* data, uint64_t size) {
+					dest->insert(dest->end(), data, data + size);
+				});
 }
 
 void DecodeSignal::get_merged_binary_data_chunks_by_offset(uint32_t segment_id,
@@ -686,39 +1056,33 @@ void DecodeSignal::get_merged_binary_data_chunks_by_offset(uint32_t segment_id,
 {
 	assert(dest != nullptr);
 
-	if (segment_id >= segments_.size())
+	lock_guard<mutex> lock(output_mutex_);
+
+	const DecodeBinaryClass* bin_class =
+		get_binary_data_class(segment_id, dec, bin_class_id);
+	if (!bin_class)
 		return;
 
-	const DecodeSegment *segment = &(segments_[segment_id]);
+	end = min(end, bin_class->size);
+	dest->resize((start < end) ? (end - start) : 0);
 
-	const DecodeBinaryClass* bin_class = nullptr;
-	for (const DecodeBinaryClass& bc : segment->binary_classes)
-		if ((bc.decoder == dec) && (bc.info->bin_class_id == bin_class_id))
-			bin_class = &bc;
-
-	// Determine overall size before copying to resize dest vector only once
-	uint64_t size = 0;
-	uint64_t offset = 0;
-	for (const DecodeBinaryDataChunk& chunk : bin_class->chunks) {
-		if (offset >= start)
-			size += chunk.data.size();
-		offset += chunk.data.size();
-		if (offset >= end)
-			break;
-	}
-	dest->resize(size);
-
-	offset = 0;
-	uint64_t dest_offset = 0;
-	for (const DecodeBinaryDataChunk& chunk : bin_class->chunks) {
-		if (offset >= start) {
-			memcpy(dest->data() + dest_offset, chunk.data.data(), chunk.data.size());
-			dest_offset += chunk.data.size();
-		}
-		offset += chunk.data.size();
-		if (offset >= end)
-			break;
-	}
+	uint8_t* d = dest->data();
+	bin_class->for_each_span(start, end, [&](const uint8_t* data, uint64_t size) {
+		memcpy(d, data, size);
+		d += size;
+	});
+}
+
+void DecodeSignal::get_binary_data_spans(uint32_t segment_id, const Decoder* dec,
+	uint32_t bin_class_id, uint64_t start, uint64_t end,
+	function<void(const uint8_t*, uint64_t)> f) const
+{
+	lock_guard<mutex> lock(output_mutex_);
+
+	const DecodeBinaryClass* bin_class =
+		get_binary_data_class(segment_id, dec, bin_class_id);
+	if (bin_class)
+		bin_class->for_each_span(start, end, f);
 }
 
 const DecodeBinaryClass* DecodeSignal::get_binary_data_class(uint32_t segment_id,
@@ -736,15 +1100,59 @@ const DecodeBinaryClass* DecodeSignal::get_binary_data_class(uint32_t segment_id
 	return nullptr;
 }
 
-const deque<const Annotation*>* DecodeSignal::get_all_annotations_by_segment(
-	uint32_t segment_id) const
+DecodeStatistics DecodeSignal::get_statistics() const
 {
-	if (segment_id >= segments_.size())
-		return nullptr;
+	DecodeStatistics stats;
+
+	const uint64_t run_time = stats_run_time_;
+	stats.run_time = ((run_time > 0) ? run_time : elapsed_ns(stats_start_time_)) / 1e9;
+	stats.mux_time = logic_mux_ ? (logic_mux_->mux_time() / 1e9) : 0;
+	stats.send_time = stats_send_time_ / 1e9;
+	stats.callback_time = stats_callback_time_ / 1e9;
+	stats.lock_wait_time = stats_lock_wait_time_ / 1e9;
+	stats.samples_decoded = stats_samples_decoded_;
+	stats.annotation_count = 0;
+	stats.annotation_memory = 0;
+	stats.binary_memory = 0;
 
-	const DecodeSegment *segment = &(segments_[segment_id]);
+	lock_guard<mutex> lock(output_mutex_);
+
+	for (const DecodeSegment& segment : segments_) {
+		for (const auto& entry : segment.annotation_rows) {
+			stats.annotation_count += entry.second.get_annotation_count();
+			stats.annotation_memory += entry.second.get_memory_usage();
+		}
+
+		for (const DecodeBinaryClass& bc : segment.binary_classes)
+			stats.binary_memory += bc.pages.size() * DecodeBinaryClass::PageSize +
+				bc.chunks.size() * sizeof(DecodeBinaryDataChunk);
+	}
+
+	return stats;
+}
 
-	return &(segment->all_annotations);
+void DecodeSignal::merge_annotations(AnnotationCursor &cursor,
+	uint32_t segment_id, size_t count) const
+{
+	lock_guard<mutex> lock(output_mutex_);
+
+	if (segment_id >= segments_.size()) {
+		cursor.clear();
+		return;
+	}
+
+	const DecodeSegment* segment = &(segments_.at(segment_id));
+
+	// Use the order of the decoder stack for annotations that start at the
+	// same sample and have the same length
+	vector<const RowData*> rows;
+	for (const Row* row : get_rows()) {
+		auto row_it = segment->annotation_rows.find(row);
+		if (row_it != segment->annotation_rows.end())
+			rows.push_back(&(row_it->second));
+	}
+
+	cursor.advance(rows, count);
 }
 
 void DecodeSignal::save_settings(QSettings &settings) const
@@ -825,6 +1233,14 @@ void DecodeSignal::save_settings(QSettings &settings) const
 		settings.endGroup();
 	}
 
+	// Save decode range
+	settings.setValue("decode_range", decode_range_set_);
+	if (decode_range_set_) {
+		settings.setValue("decode_range_start", (qulonglong)decode_range_start_);
+		settings.setValue("decode_range_end", (qulonglong)decode_range_end_);
+		settings.setValue("decode_range_warm_up", (qulonglong)decode_range_warm_up_);
+	}
+
 	// TODO Save logic output signal settings
 }
 
@@ -833,8 +1249,6 @@ void DecodeSignal::restore_settings(QSettings &settings)
 	SignalBase::restore_settings(settings);
 
 	// Restore decoder stack
-	GSList *dec_list = g_slist_copy((GSList*)srd_decoder_list());
-
 	int decoders = settings.value("decoders").toInt();
 
 	for (int decoder_idx = 0; decoder_idx < decoders; decoder_idx++) {
@@ -842,53 +1256,48 @@ void DecodeSignal::restore_settings(QSettings &settings)
 
 		QString id = settings.value("id").toString();
 
-		for (GSList *entry = dec_list; entry; entry = entry->next) {
-			const srd_decoder *dec = (srd_decoder*)entry->data;
-			if (!dec)
-				continue;
-
-			if (QString::fromUtf8(dec->id) == id) {
-				shared_ptr<Decoder> decoder = make_shared<Decoder>(dec, stack_.size());
+		// Load the decoder right away if the background loader didn't get to it yet
+		const srd_decoder *dec = DecoderLoader::get_decoder(id.toUtf8());
 
-				connect(decoder.get(), SIGNAL(annotation_visibility_changed()),
-					this, SLOT(on_annotation_visibility_changed()));
+		if (dec) {
+			shared_ptr<Decoder> decoder = make_shared<Decoder>(dec, stack_.size());
 
-				stack_.push_back(decoder);
-				decoder->set_visible(settings.value("visible", true).toBool());
+			connect(decoder.get(), SIGNAL(annotation_visibility_changed()),
+				this, SLOT(on_annotation_visibility_changed()));
 
-				// Restore decoder options that differ from their default
-				int options = settings.value("options").toInt();
+			stack_.push_back(decoder);
+			decoder->set_visible(settings.value("visible", true).toBool());
 
-				for (int i = 0; i < options; i++) {
-					settings.beginGroup("option" + QString::number(i));
-					QString name = settings.value("name").toString();
-					GVariant *value = GlobalSettings::restore_gvariant(settings);
-					decoder->set_option(name.toUtf8(), value);
-					settings.endGroup();
-				}
+			// Restore decoder options that differ from their default
+			int options = settings.value("options").toInt();
 
-				// Include the newly created decode channels in the channel lists
-				update_channel_list();
+			for (int i = 0; i < options; i++) {
+				settings.beginGroup("option" + QString::number(i));
+				QString name = settings.value("name").toString();
+				GVariant *value = GlobalSettings::restore_gvariant(settings);
+				decoder->set_option(name.toUtf8(), value);
+				settings.endGroup();
+			}
 
-				// Restore row properties
-				int i = 0;
-				for (Row* row : decoder->get_rows()) {
-					settings.beginGroup("row" + QString::number(i));
-					row->set_visible(settings.value("visible", true).toBool());
-					settings.endGroup();
-					i++;
-				}
+			// Include the newly created decode channels in the channel lists
+			update_channel_list();
 
-				// Restore class properties
-				i = 0;
-				for (AnnotationClass* ann_class : decoder->ann_classes()) {
-					settings.beginGroup("ann_class" + QString::number(i));
-					ann_class->set_visible(settings.value("visible", true).toBool());
-					settings.endGroup();
-					i++;
-				}
+			// Restore row properties
+			int i = 0;
+			for (Row* row : decoder->get_rows()) {
+				settings.beginGroup("row" + QString::number(i));
+				row->set_visible(settings.value("visible", true).toBool());
+				settings.endGroup();
+				i++;
+			}
 
-				break;
+			// Restore class properties
+			i = 0;
+			for (AnnotationClass* ann_class : decoder->ann_classes()) {
+				settings.beginGroup("ann_class" + QString::number(i));
+				ann_class->set_visible(settings.value("visible", true).toBool());
+				settings.endGroup();
+				i++;
 			}
 		}
 
@@ -924,6 +1333,14 @@ void DecodeSignal::restore_settings(QSettings &settings)
 		settings.endGroup();
 	}
 
+	// Restore decode range
+	decode_range_set_ = settings.value("decode_range", false).toBool();
+	if (decode_range_set_) {
+		decode_range_start_ = settings.value("decode_range_start").toULongLong();
+		decode_range_end_ = settings.value("decode_range_end").toULongLong();
+		decode_range_warm_up_ = settings.value("decode_range_warm_up").toULongLong();
+	}
+
 	connect_input_notifiers();
 
 	// Update the internal structures
@@ -982,30 +1399,6 @@ uint32_t DecodeSignal::get_input_segment_count() const
 	return (no_signals_assigned ? 0 : count);
 }
 
-double DecodeSignal::get_input_samplerate(uint32_t segment_id) const
-{
-	double samplerate = 0;
-
-	for (const decode::DecodeChannel& ch : channels_)
-		if (ch.assigned_signal) {
-			const shared_ptr<Logic> logic_data = ch.assigned_signal->logic_data();
-			if (!logic_data || logic_data->logic_segments().empty())
-				continue;
-
-			try {
-				const shared_ptr<const LogicSegment> segment =
-					logic_data->logic_segments().at(segment_id)->get_shared_ptr();
-				if (segment)
-					samplerate = segment->samplerate();
-			} catch (out_of_range&) {
-				// Do nothing
-			}
-			break;
-		}
-
-	return samplerate;
-}
-
 Decoder* DecodeSignal::get_decoder_by_instance(const srd_decoder *const srd_dec)
 {
 	for (shared_ptr<Decoder>& d : stack_)
@@ -1074,25 +1467,6 @@ void DecodeSignal::update_channel_list()
 		}
 	}
 
-	// Invalidate the logic output data if the channel assignment changed
-	if (prev_channels.size() != channels_.size()) {
-		// The number of channels changed, there's definitely a difference
-		logic_mux_data_invalid_ = true;
-	} else {
-		// Same number but assignment may still differ, so compare all channels
-		for (size_t i = 0; i < channels_.size(); i++) {
-			const decode::DecodeChannel& p_ch = prev_channels[i];
-			const decode::DecodeChannel& ch = channels_[i];
-
-			if ((p_ch.pdch_ != ch.pdch_) ||
-				(p_ch.assigned_signal != ch.assigned_signal)) {
-				logic_mux_data_invalid_ = true;
-				break;
-			}
-		}
-
-	}
-
 	channels_updated();
 }
 
@@ -1109,199 +1483,314 @@ void DecodeSignal::commit_decoder_channels()
 		dec->set_channels(channel_list);
 	}
 
-	// Channel bit IDs must be in sync with the channel's apperance in channels_
+	// When decoding the input data directly, the decoders use the bit
+	// positions of the assigned signals. Otherwise, channel bit IDs must be
+	// in sync with the channel's apperance in channels_
+	decode_from_input_ = (get_direct_input_data() != nullptr);
+
 	int id = 0;
 	for (decode::DecodeChannel& ch : channels_)
 		if (ch.assigned_signal)
-			ch.bit_id = id++;
+			ch.bit_id = decode_from_input_ ?
+				ch.assigned_signal->logic_bit_index() : id++;
 }
 
-void DecodeSignal::mux_logic_samples(uint32_t segment_id, const int64_t start, const int64_t end)
+vector<LogicMux::Input> DecodeSignal::get_logic_mux_inputs() const
 {
-	// Enforce end to be greater than start
-	if (end <= start)
-		return;
+	vector<LogicMux::Input> inputs;
 
-	// Fetch the channel segments and their data
-	vector<shared_ptr<const LogicSegment> > segments;
-	vector<const uint8_t*> signal_data;
-	vector<uint8_t> signal_in_bytepos;
-	vector<uint8_t> signal_in_bitpos;
+	for (const decode::DecodeChannel& ch : channels_)
+		if (ch.assigned_signal)
+			inputs.emplace_back(ch.assigned_signal->logic_data(),
+				ch.assigned_signal->logic_bit_index());
 
-	for (decode::DecodeChannel& ch : channels_)
+	return inputs;
+}
+
+void DecodeSignal::release_logic_mux()
+{
+	if (!logic_mux_)
+		return;
+
+	logic_mux_->remove_listener(this);
+	if (logic_mux_data_invalid_)
+		logic_mux_->invalidate();
+
+	logic_mux_.reset();
+}
+
+shared_ptr<Logic> DecodeSignal::get_direct_input_data() const
+{
+	// libsigrokdecode can take the samples from the input data as-is if all
+	// channels are bits of the same logic data. This saves the muxed copy
+	shared_ptr<Logic> input_data;
+
+	for (const decode::DecodeChannel& ch : channels_)
 		if (ch.assigned_signal) {
+			if (ch.assigned_signal->type() != SignalBase::LogicChannel)
+				return nullptr;
+
 			const shared_ptr<Logic> logic_data = ch.assigned_signal->logic_data();
+			if (!logic_data || (input_data && (logic_data != input_data)))
+				return nullptr;
 
-			shared_ptr<const LogicSegment> segment;
-			if (segment_id < logic_data->logic_segments().size()) {
-				segment = logic_data->logic_segments().at(segment_id)->get_shared_ptr();
-			} else {
-				qDebug() << "Muxer error for" << name() << ":" << ch.assigned_signal->name() \
-					<< "has no logic segment" << segment_id;
-				logic_mux_interrupt_ = true;
-				return;
-			}
+			input_data = logic_data;
+		}
 
-			if (!segment)
-				return;
+	return input_data;
+}
 
-			segments.push_back(segment);
+unsigned int DecodeSignal::get_decode_thread_count() const
+{
+	const unsigned int cores = std::thread::hardware_concurrency();
 
-			uint8_t* data = new uint8_t[(end - start) * segment->unit_size()];
-			segment->get_samples(start, end, data);
-			signal_data.push_back(data);
+	// Every helper process has an interpreter of its own
+	if (use_decode_processes_)
+		return max(1U, cores);
 
-			const int bitpos = ch.assigned_signal->logic_bit_index();
-			signal_in_bytepos.push_back(bitpos / 8);
-			signal_in_bitpos.push_back(bitpos % 8);
-		}
+	return max(1U, min(cores, MaxDecodeThreads));
+}
+
+bool DecodeSignal::decode_threads_running() const
+{
+	for (const DecodeWorker& worker : decode_workers_)
+		if (worker.thread.joinable())
+			return true;
 
-	shared_ptr<LogicSegment> output_segment;
-	try {
-		output_segment = logic_mux_data_->logic_segments().at(segment_id);
-	} catch (out_of_range&) {
-		qDebug() << "Muxer error for" << name() << ": no logic mux segment" \
-			<< segment_id << "in mux_logic_samples(), mux segments size is" \
-			<< logic_mux_data_->logic_segments().size();
-		logic_mux_interrupt_ = true;
+	return false;
+}
+
+void DecodeSignal::join_decode_threads()
+{
+	if (!decode_threads_running())
 		return;
-	}
 
-	// Perform the muxing of signal data into the output data
-	uint8_t* output = new uint8_t[(end - start) * output_segment->unit_size()];
-	unsigned int signal_count = signal_data.size();
+	decode_interrupt_ = true;
+	notify_decode_threads();
 
-	for (int64_t sample_cnt = 0; !logic_mux_interrupt_ && (sample_cnt < (end - start));
-		sample_cnt++) {
+	for (DecodeWorker& worker : decode_workers_)
+		if (worker.thread.joinable())
+			worker.thread.join();
+}
 
-		int bitpos = 0;
-		uint8_t bytepos = 0;
+void DecodeSignal::notify_decode_threads()
+{
+	// Taking the lock makes sure that a decode thread either sees the new
+	// state before it starts waiting or receives the notification
+	{
+		lock_guard<mutex> lock(input_mutex_);
+	}
 
-		const int out_sample_pos = sample_cnt * output_segment->unit_size();
-		for (unsigned int i = 0; i < output_segment->unit_size(); i++)
-			output[out_sample_pos + i] = 0;
+	decode_input_cond_.notify_all();
+}
 
-		for (unsigned int i = 0; i < signal_count; i++) {
-			const int in_sample_pos = sample_cnt * segments[i]->unit_size();
-			const uint8_t in_sample = 1 &
-				((signal_data[i][in_sample_pos + signal_in_bytepos[i]]) >> (signal_in_bitpos[i]));
+bool DecodeSignal::find_undecoded_segment(uint32_t &segment_id) const
+{
+	// Must be called with input_mutex_ locked
+	const uint32_t count = decode_input_data_->logic_segments().size();
+
+	// The segment being viewed comes first unless the order matters
+	const uint32_t priority_segment = priority_segment_;
+	if (!decode_in_order_ && (priority_segment < count) &&
+		((priority_segment >= segment_claimed_.size()) || !segment_claimed_[priority_segment])) {
+		segment_id = priority_segment;
+		return true;
+	}
 
-			const uint8_t out_sample = output[out_sample_pos + bytepos];
+	for (uint32_t i = 0; i < count; i++)
+		if ((i >= segment_claimed_.size()) || !segment_claimed_[i]) {
+			segment_id = i;
+			return true;
+		}
 
-			output[out_sample_pos + bytepos] = out_sample | (in_sample << bitpos);
+	return false;
+}
 
-			bitpos++;
-			if (bitpos > 7) {
-				bitpos = 0;
-				bytepos++;
+bool DecodeSignal::find_undecoded_partition(DecodeSplit *&split,
+	uint32_t &partition) const
+{
+	// Must be called with input_mutex_ locked
+	for (const DecodeSplit& s : decode_splits_)
+		for (uint32_t i = 0; i < s.claimed.size(); i++)
+			if (!s.claimed[i]) {
+				split = const_cast<DecodeSplit*>(&s);
+				partition = i;
+				return true;
 			}
-		}
+
+	return false;
+}
+
+vector<uint64_t> DecodeSignal::find_idle_gap_splits(
+	const shared_ptr<LogicSegment> input_segment, uint64_t start, uint64_t end,
+	uint64_t &warm_up) const
+{
+	const uint64_t sample_count = end - start;
+	const uint64_t gap_length = (uint64_t)(input_segment->samplerate() * SplitIdleGapTime);
+	const uint64_t partition_length = max(SplitMinPartitionLength,
+		sample_count / (decode_workers_.size() * 4));
+
+	if ((gap_length == 0) || (sample_count < 2 * partition_length))
+		return vector<uint64_t>();
+
+	// Collect the places where any of the decoder inputs changes. The
+	// resolution lets the mipmaps skip over the idle stretches quickly, an
+	// edge at position p means there is activity in [p, p + block_length)
+	const float resolution = gap_length / 8.0f;
+	const uint64_t block_length = (uint64_t)max(resolution, 1.0f);
+
+	vector<uint64_t> activity;
+	vector<LogicSegment::EdgePair> edges;
+	for (const decode::DecodeChannel& ch : channels_) {
+		if (!ch.assigned_signal)
+			continue;
+
+		edges.clear();
+		input_segment->get_subsampled_edges(edges, start, end, resolution, ch.bit_id);
+		for (const LogicSegment::EdgePair& edge : edges)
+			activity.push_back(edge.first);
 	}
 
-	output_segment->append_payload(output, (end - start) * output_segment->unit_size());
-	delete[] output;
+	sort(activity.begin(), activity.end());
+	activity.erase(unique(activity.begin(), activity.end()), activity.end());
 
-	for (const uint8_t* data : signal_data)
-		delete[] data;
+	// Split in the middle of the gaps so that the decoders of the next
+	// partition see half a gap of idle bus before the first transition
+	warm_up = gap_length / 2;
+
+	return decode::find_idle_gap_splits(activity, block_length, gap_length,
+		partition_length, start, end);
 }
 
-void DecodeSignal::logic_mux_proc()
+DecodeSplit* DecodeSignal::split_segment(uint32_t segment_id,
+	const shared_ptr<LogicSegment> input_segment)
 {
-	uint32_t input_segment_count;
-	do {
-		input_segment_count = get_input_segment_count();
-		if (input_segment_count == 0) {
-			// Wait for input data
-			unique_lock<mutex> logic_mux_lock(logic_mux_mutex_);
-			logic_mux_cond_.wait(logic_mux_lock);
-		}
-	} while ((!logic_mux_interrupt_) && (input_segment_count == 0));
+	const uint64_t sample_count = input_segment->get_sample_count();
+	uint64_t start = 0, end = sample_count;
+	if (decode_range_set_) {
+		start = min(decode_range_start_, sample_count);
+		end = min(decode_range_end_, sample_count);
+	}
 
-	if (logic_mux_interrupt_)
-		return;
+	uint64_t warm_up = 0;
+	vector<uint64_t> splits;
+	if (split_at_idle_gaps_ && (decode_workers_.size() > 1))
+		splits = find_idle_gap_splits(input_segment, start, end, warm_up);
 
-	assert(logic_mux_data_);
+	// A decode range always needs a split, even with a single partition
+	if (splits.empty() && !decode_range_set_)
+		return nullptr;
 
-	uint32_t segment_id = 0;
+	DecodeSplit* split;
+	{
+		lock_guard<mutex> lock(input_mutex_);
 
-	// Create initial logic mux segment
-	shared_ptr<LogicSegment> output_segment =
-		make_shared<LogicSegment>(*logic_mux_data_, segment_id, logic_mux_unit_size_, 0);
-	logic_mux_data_->push_segment(output_segment);
+		decode_splits_.emplace_back();
+		split = &(decode_splits_.back());
+		split->segment_id = segment_id;
 
-	output_segment->set_samplerate(get_input_samplerate(0));
+		split->bounds.push_back(start);
+		split->feed_starts.push_back(start - min(start, decode_range_warm_up_));
+		for (uint64_t s : splits) {
+			split->bounds.push_back(s);
+			split->feed_starts.push_back(s - warm_up);
+		}
+		split->bounds.push_back(end);
+
+		const size_t partition_count = splits.size() + 1;
+		split->claimed.assign(partition_count, false);
+		split->finished.assign(partition_count, false);
+		split->staged_annotations.resize(partition_count);
+		split->staged_texts.resize(partition_count);
+		split->staged_binary.resize(partition_count);
+		split->committed = 0;
+
+		// The calling thread decodes the first partition
+		split->claimed[0] = true;
+	}
 
-	// Logic mux data is being updated
-	logic_mux_data_invalid_ = false;
+	if (!splits.empty()) {
+		qDebug().nospace() << name() << ": Decoding segment " << segment_id <<
+			" as " << (splits.size() + 1) << " partitions";
 
-	uint64_t samples_to_process;
-	do {
-		do {
-			const uint64_t input_sample_count = get_working_sample_count(segment_id);
-			const uint64_t output_sample_count = output_segment->get_sample_count();
+		// Let the other threads help out
+		notify_decode_threads();
+	}
 
-			samples_to_process =
-				(input_sample_count > output_sample_count) ?
-				(input_sample_count - output_sample_count) : 0;
+	return split;
+}
 
-			if (samples_to_process > 0) {
-				const uint64_t unit_size = output_segment->unit_size();
-				const uint64_t chunk_sample_count = DecodeChunkLength / unit_size;
+void DecodeSignal::finish_partition(DecodeWorker &worker)
+{
+	DecodeSplit* split = worker.split;
+	assert(split);
 
-				uint64_t processed_samples = 0;
-				do {
-					const uint64_t start_sample = output_sample_count + processed_samples;
-					const uint64_t sample_count =
-						min(samples_to_process - processed_samples,	chunk_sample_count);
+	vector< pair<const Decoder*, uint32_t> > new_binary_classes;
+	bool split_done;
 
-					mux_logic_samples(segment_id, start_sample, start_sample + sample_count);
-					processed_samples += sample_count;
+	{
+		lock_guard<mutex> lock(output_mutex_);
 
-					// ...and process the newly muxed logic data
-					decode_input_cond_.notify_one();
-				} while (!logic_mux_interrupt_ && (processed_samples < samples_to_process));
-			}
-		} while (!logic_mux_interrupt_ && (samples_to_process > 0));
+		const uint32_t committed_before = split->committed;
+		split->finished[worker.partition] = true;
 
-		if (!logic_mux_interrupt_) {
-			// samples_to_process is now 0, we've exhausted the currently available input data
+		DecodeSegment& segment = segments_.at(split->segment_id);
 
-			// If the input segments are complete, we've completed this segment
-			if (all_input_segments_complete(segment_id)) {
-				if (!output_segment->is_complete())
-					output_segment->set_complete();
+		// Add the held back output of all partitions whose predecessors are done
+		while ((split->committed < split->finished.size()) &&
+			split->finished[split->committed]) {
 
-				if (segment_id < get_input_segment_count() - 1) {
+			const uint32_t p = split->committed;
 
-					// Process next segment
-					segment_id++;
+			add_staged_annotations(segment, split->staged_annotations[p],
+				split->staged_texts[p]);
+			split->staged_annotations[p].clear();
+			split->staged_texts[p].clear();
 
-					output_segment =
-						make_shared<LogicSegment>(*logic_mux_data_, segment_id,
-							logic_mux_unit_size_, 0);
-					logic_mux_data_->push_segment(output_segment);
+			for (DecodeStagedBinary& b : split->staged_binary[p])
+				for (DecodeBinaryClass& bc : segment.binary_classes)
+					if ((bc.decoder == b.decoder) && (bc.info->bin_class_id == b.bin_class_id)) {
+						bc.append(b.sample, b.data.data(), b.data.size());
+						new_binary_classes.emplace_back(b.decoder, b.bin_class_id);
+						break;
+					}
+			split->staged_binary[p].clear();
 
-					output_segment->set_samplerate(get_input_samplerate(segment_id));
-				} else {
-					// Wait for more input data if we're processing the currently last segment
-					unique_lock<mutex> logic_mux_lock(logic_mux_mutex_);
-					logic_mux_cond_.wait(logic_mux_lock);
-				}
-			} else {
-				// Input segments aren't all complete yet but samples_to_process is 0, wait for more input data
-				unique_lock<mutex> logic_mux_lock(logic_mux_mutex_);
-				logic_mux_cond_.wait(logic_mux_lock);
-			}
+			segment.samples_decoded_incl = split->bounds[p + 1];
+			segment.samples_decoded_excl = split->bounds[p + 1];
+
+			split->committed++;
 		}
-	} while (!logic_mux_interrupt_);
+
+		split_done = (committed_before < split->finished.size()) &&
+			(split->committed == split->finished.size());
+	}
+
+	// Whoever adds the output of the last partitions stores the results
+	if (split_done && !split->cache_key.isEmpty() && !decode_interrupt_)
+		store_cached_results(split->segment_id, split->cache_key,
+			split->cache_logic_starts);
+
+	new_annotations();
+
+	sort(new_binary_classes.begin(), new_binary_classes.end());
+	new_binary_classes.erase(unique(new_binary_classes.begin(),
+		new_binary_classes.end()), new_binary_classes.end());
+	for (const pair<const Decoder*, uint32_t>& bc : new_binary_classes)
+		new_binary_data(split->segment_id, (void*)bc.first, bc.second);
 }
 
-void DecodeSignal::decode_data(
+void DecodeSignal::decode_data(DecodeWorker &worker,
 	const int64_t abs_start_samplenum, const int64_t sample_count,
 	const shared_ptr<const LogicSegment> input_segment)
 {
 	const int64_t unit_size = input_segment->unit_size();
 	const int64_t chunk_sample_count = DecodeChunkLength / unit_size;
+	const int64_t offset = worker.sample_offset;
+
+	// The output of later partitions is held back, so only the first one
+	// shows its progress
+	const bool show_progress = !worker.split || (worker.partition == 0);
 
 	for (int64_t i = abs_start_samplenum;
 		!decode_interrupt_ && (i < (abs_start_samplenum + sample_count));
@@ -1310,28 +1799,49 @@ void DecodeSignal::decode_data(
 		const int64_t chunk_end = min(i + chunk_sample_count,
 			abs_start_samplenum + sample_count);
 
-		{
+		if (show_progress) {
 			lock_guard<mutex> lock(output_mutex_);
 			// Update the sample count showing the samples including currently processed ones
-			segments_.at(current_segment_id_).samples_decoded_incl = chunk_end;
+			segments_.at(worker.segment_id).samples_decoded_incl = chunk_end;
+		}
+
+		const int64_t data_size = (chunk_end - i) * unit_size;
+
+		// Hand the samples to the decoders right from the segment's memory
+		// and only copy them if that isn't possible, e.g. at chunk boundaries
+		const uint8_t* data = input_segment->get_sample_span(i, chunk_end);
+		if (!data) {
+			worker.buffer.resize(data_size);
+			input_segment->get_samples(i, chunk_end, worker.buffer.data());
+			data = worker.buffer.data();
 		}
 
-		int64_t data_size = (chunk_end - i) * unit_size;
-		uint8_t* chunk = new uint8_t[data_size];
-		input_segment->get_samples(i, chunk_end, chunk);
+		// libsigrokdecode expects the sample numbers of a session to start at 0
+		const steady_clock::time_point send_start = steady_clock::now();
+		bool ok;
+#ifdef HAVE_SHM_OPEN
+		if (worker.process)
+			ok = worker.process->send(i - offset, chunk_end - offset, data,
+				data_size, unit_size);
+		else
+#endif
+			ok = (srd_session_send(worker.session, i - offset, chunk_end - offset,
+				data, data_size, unit_size) == SRD_OK);
+
+		stats_send_time_ += elapsed_ns(send_start);
+		stats_samples_decoded_ += chunk_end - i;
 
-		if (srd_session_send(srd_session_, i, chunk_end, chunk,
-				data_size, unit_size) != SRD_OK) {
+		if (!ok) {
 			set_error_message(tr("Decoder reported an error"));
 			decode_interrupt_ = true;
 		}
 
-		delete[] chunk;
+		flush_annotations(worker);
 
-		{
+		if (show_progress) {
 			lock_guard<mutex> lock(output_mutex_);
 			// Now that all samples are processed, the exclusive sample count catches up
-			segments_.at(current_segment_id_).samples_decoded_excl = chunk_end;
+			segments_.at(worker.segment_id).samples_decoded_excl = chunk_end;
 		}
 
 		// Notify the frontend that we processed some data and
@@ -1345,105 +1855,577 @@ void DecodeSignal::decode_data(
 	}
 }
 
-void DecodeSignal::decode_proc()
+void DecodeSignal::decode_proc(DecodeWorker *worker)
 {
-	current_segment_id_ = 0;
+	assert(worker);
 
-	// If there is no input data available yet, wait until it is or we're interrupted
-	do {
-		if (logic_mux_data_->logic_segments().size() == 0) {
-			// Wait for input data
+	while (!decode_interrupt_) {
+		uint32_t segment_id = 0;
+		DecodeSplit* split = nullptr;
+		uint32_t partition = 0;
+
+		{
+			// Wait for a partition or segment that no other decode thread has
+			// taken yet. Partitions come first as their segment is already
+			// being worked on
 			unique_lock<mutex> input_wait_lock(input_mutex_);
-			decode_input_cond_.wait(input_wait_lock);
+			decode_input_cond_.wait(input_wait_lock, [&] {
+				return decode_interrupt_ || find_undecoded_partition(split, partition) ||
+					find_undecoded_segment(segment_id); });
+
+			if (decode_interrupt_)
+				return;
+
+			if (split) {
+				split->claimed[partition] = true;
+				segment_id = split->segment_id;
+			} else {
+				if (segment_claimed_.size() <= segment_id)
+					segment_claimed_.resize(segment_id + 1, false);
+				segment_claimed_[segment_id] = true;
+			}
+			busy_decode_threads_++;
 		}
-	} while ((!decode_interrupt_) && (logic_mux_data_->logic_segments().size() == 0));
 
-	if (decode_interrupt_)
-		return;
+		shared_ptr<LogicSegment> input_segment;
+		try {
+			input_segment = decode_input_data_->logic_segments().at(segment_id);
+		} catch (out_of_range&) {
+			qDebug() << "Decode error for" << name() << ": no input segment" \
+				<< segment_id << "in decode_proc(), input segments size is" \
+				<< decode_input_data_->logic_segments().size();
+			decode_interrupt_ = true;
+			return;
+		}
 
-	shared_ptr<const LogicSegment> input_segment = logic_mux_data_->logic_segments().front()->get_shared_ptr();
-	if (!input_segment)
-		return;
+		if (!input_segment)
+			return;
 
-	// Create the initial segment and set its sample rate so that we can pass it to SRD
-	create_decode_segment();
-	segments_.at(current_segment_id_).samplerate = input_segment->samplerate();
-	segments_.at(current_segment_id_).start_time = input_segment->start_time();
+		// Create the segment and set its sample rate so that we can pass it to SRD
+		worker->samplerate = create_decode_segment(segment_id);
+
+		worker->segment_id = segment_id;
+		worker->split = split;
+		worker->partition = partition;
+		worker->sample_offset = split ? split->feed_starts[partition] : 0;
+		worker->cache_key.clear();
+		worker->pending_annotations.clear();  // Left over if decoding was interrupted
+		worker->pending_texts.clear();
+		worker->discard_output = false;
+
+		if (!split && cache_results_ && all_input_segments_complete(segment_id)) {
+			// The key covers all of the input, so the muxing must be done
+			{
+				unique_lock<mutex> input_wait_lock(input_mutex_);
+				decode_input_cond_.wait(input_wait_lock, [&] {
+					return decode_interrupt_ || input_segment->is_complete(); });
+			}
 
-	start_srd_session();
+			if (!decode_interrupt_)
+				worker->cache_key = get_cache_key(input_segment);
 
-	uint64_t samples_to_process = 0;
-	uint64_t abs_start_samplenum = 0;
-	do {
-		// Keep processing new samples until we exhaust the input data
-		do {
-			samples_to_process = input_segment->get_sample_count() - abs_start_samplenum;
+			if (decode_interrupt_)
+				return;
 
-			if (samples_to_process > 0) {
-				decode_data(abs_start_samplenum, samples_to_process, input_segment);
-				abs_start_samplenum += samples_to_process;
+			if (load_cached_results(*worker)) {
+				qDebug().nospace() << name() << ": Using cached results for segment " <<
+					segment_id;
+				finish_decode_work();
+				continue;
 			}
-		} while (!decode_interrupt_ && (samples_to_process > 0));
 
-		if (!decode_interrupt_) {
-			// samples_to_process is now 0, we've exhausted the currently available input data
+			worker->cache_logic_starts = get_logic_output_sample_counts();
+		}
 
-			// If the input segment is complete, we've exhausted this segment
-			if (input_segment->is_complete()) {
-#if defined HAVE_SRD_SESSION_SEND_EOF && HAVE_SRD_SESSION_SEND_EOF
-				// Tell protocol decoders about the end of
-				// the input data, which may result in more
-				// annotations being emitted
-				(void)srd_session_send_eof(srd_session_);
-				new_annotations();
-#endif
+		if (!split && decode_range_set_) {
+			// The decoders only work on the range, so wait until it has
+			// been acquired completely
+			{
+				unique_lock<mutex> input_wait_lock(input_mutex_);
+				decode_input_cond_.wait(input_wait_lock, [&] {
+					return decode_interrupt_ || input_segment->is_complete() ||
+						(input_segment->get_sample_count() >= decode_range_end_); });
+			}
 
-				if (current_segment_id_ < (logic_mux_data_->logic_segments().size() - 1)) {
-					// Process next segment
-					current_segment_id_++;
-
-					try {
-						input_segment = logic_mux_data_->logic_segments().at(current_segment_id_);
-					} catch (out_of_range&) {
-						qDebug() << "Decode error for" << name() << ": no logic mux segment" \
-							<< current_segment_id_ << "in decode_proc(), mux segments size is" \
-							<< logic_mux_data_->logic_segments().size();
-						decode_interrupt_ = true;
-						return;
-					}
-					abs_start_samplenum = 0;
-
-					// Create the next segment and set its metadata
-					create_decode_segment();
-					segments_.at(current_segment_id_).samplerate = input_segment->samplerate();
-					segments_.at(current_segment_id_).start_time = input_segment->start_time();
-
-					// Reset decoder state but keep the decoder stack intact
-					terminate_srd_session();
-				} else {
-					// All segments have been processed
-					if (!decode_interrupt_)
-						decode_finished();
-
-					// Wait for more input data
-					unique_lock<mutex> input_wait_lock(input_mutex_);
-					decode_input_cond_.wait(input_wait_lock);
+			if (decode_interrupt_)
+				return;
+
+			split = split_segment(segment_id, input_segment);
+		} else if (!split && split_at_idle_gaps_ && (decode_workers_.size() > 1) &&
+			input_segment->is_complete()) {
+			// A complete segment can be split up so that the other threads can help
+			split = split_segment(segment_id, input_segment);
+		}
+
+		// A split this thread just created takes over storing the results
+		if (split && !worker->cache_key.isEmpty()) {
+			split->cache_key = worker->cache_key;
+			split->cache_logic_starts = worker->cache_logic_starts;
+			worker->cache_key.clear();
+		}
+
+		worker->split = split;
+		worker->partition = partition;
+		worker->sample_offset = split ? split->feed_starts[partition] : 0;
+
+		start_srd_session(*worker);
+		if (!worker->session && !worker->process) {
+			decode_interrupt_ = true;
+			return;
+		}
+
+		if (split) {
+			const int64_t end = split->bounds[partition + 1];
+			decode_data(*worker, worker->sample_offset,
+				end - worker->sample_offset, input_segment);
+		} else {
+			// Keep processing new samples until the input segment is complete
+			int64_t abs_start_samplenum = 0;
+			while (!decode_interrupt_) {
+				const int64_t sample_count = input_segment->get_sample_count();
+
+				if (sample_count > abs_start_samplenum) {
+					decode_data(*worker, abs_start_samplenum,
+						sample_count - abs_start_samplenum, input_segment);
+					abs_start_samplenum = sample_count;
+					continue;
 				}
-			} else {
-				// Input segment isn't complete yet but samples_to_process is 0, wait for more input data
+
+				if (input_segment->is_complete())
+					break;
+
+				// Wait for more input data
 				unique_lock<mutex> input_wait_lock(input_mutex_);
-				decode_input_cond_.wait(input_wait_lock);
+				decode_input_cond_.wait(input_wait_lock, [&] {
+					return decode_interrupt_ || input_segment->is_complete() ||
+						((int64_t)input_segment->get_sample_count() > abs_start_samplenum); });
+			}
+		}
+
+		if (decode_interrupt_)
+			return;
+
+		// The decoders of all but the last partition only see the end of the
+		// data at a split, where the unsplit decode would carry on. What they
+		// emit at that point doesn't exist in the unsplit decode, so drop it
+		const bool partition_end = split && (partition + 2 < split->bounds.size());
+
+#ifdef HAVE_SHM_OPEN
+		if (worker->process) {
+			// The output for the samples must be in before it's discarded.
+			// Sending EOF also waits for the rest of the decoder output
+			const steady_clock::time_point send_start = steady_clock::now();
+			bool ok = worker->process->wait_until_done();
+			worker->discard_output = partition_end;
+			ok = ok && worker->process->send_eof();
+			stats_send_time_ += elapsed_ns(send_start);
+
+			if (!ok) {
+				set_error_message(tr("Decoder reported an error"));
+				decode_interrupt_ = true;
+				return;
 			}
+			flush_annotations(*worker);
+			new_annotations();
+		}
+#endif
+
+#if defined HAVE_SRD_SESSION_SEND_EOF && HAVE_SRD_SESSION_SEND_EOF
+		// Tell protocol decoders about the end of
+		// the input data, which may result in more
+		// annotations being emitted
+		if (worker->session) {
+			worker->discard_output = partition_end;
+			const steady_clock::time_point send_start = steady_clock::now();
+			(void)srd_session_send_eof(worker->session);
+			stats_send_time_ += elapsed_ns(send_start);
+			flush_annotations(*worker);
+			new_annotations();
+		}
+#endif
+
+		worker->discard_output = false;
+
+		if (split)
+			finish_partition(*worker);
+		else if (!worker->cache_key.isEmpty())
+			store_cached_results(segment_id, worker->cache_key,
+				worker->cache_logic_starts);
+
+		finish_decode_work();
+	}
+}
+
+void DecodeSignal::finish_decode_work()
+{
+	bool all_segments_decoded;
+	{
+		lock_guard<mutex> lock(input_mutex_);
+		busy_decode_threads_--;
+
+		DecodeSplit* next_split;
+		uint32_t next_id;
+		all_segments_decoded = (busy_decode_threads_ == 0) &&
+			!find_undecoded_partition(next_split, next_id) &&
+			!find_undecoded_segment(next_id);
+	}
+
+	if (all_segments_decoded) {
+		stats_run_time_ = max(elapsed_ns(stats_start_time_), (uint64_t)1);
+		decode_finished();
+	}
+}
+
+QString DecodeSignal::get_cache_key(const shared_ptr<const LogicSegment> input_segment) const
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+
+	const auto add_value = [&](uint64_t value) {
+		hash.addData(QByteArray((const char*)&value, sizeof(value)));
+	};
+	const auto add_string = [&](const char* str) {
+		hash.addData(QByteArray(str, strlen(str) + 1));
+	};
+
+	// The same decoders may behave differently in another version
+	add_value(CacheFormatVersion);
+	add_string(srd_lib_version_string_get());
+
+	// Decoder stack and options. The decoders may have been updated without
+	// the library, so their files are part of the key, as are the helpers
+	// they share
+	add_decoder_files(hash, "common");
+	for (const shared_ptr<Decoder>& dec : stack_) {
+		add_string(dec->get_srd_decoder()->id);
+		add_decoder_files(hash, dec->get_srd_decoder()->id);
+
+		add_value(dec->options().size());
+		for (const auto& option : dec->options()) {
+			gchar *const value = g_variant_print(option.second, true);
+			add_string(option.first.c_str());
+			add_string(value);
+			g_free(value);
+		}
+	}
+
+	// Channel mapping
+	for (const decode::DecodeChannel& ch : channels_) {
+		add_value(ch.id);
+		add_value(ch.assigned_signal ? ch.bit_id : numeric_limits<uint64_t>::max());
+		add_value(ch.initial_pin_state);
+	}
+
+	// Settings that affect which output is kept
+	add_value(split_at_idle_gaps_);
+	add_value(decode_range_set_);
+	if (decode_range_set_) {
+		add_value(decode_range_start_);
+		add_value(decode_range_end_);
+		add_value(decode_range_warm_up_);
+	}
+
+	// The input data itself
+	const double samplerate = input_segment->samplerate();
+	hash.addData(QByteArray((const char*)&samplerate, sizeof(samplerate)));
+
+	const int64_t unit_size = input_segment->unit_size();
+	const int64_t sample_count = input_segment->get_sample_count();
+	const int64_t chunk_sample_count = DecodeChunkLength / unit_size;
+	add_value(unit_size);
+	add_value(sample_count);
+
+	vector<uint8_t> buffer;
+	for (int64_t i = 0; !decode_interrupt_ && (i < sample_count); i += chunk_sample_count) {
+		const int64_t chunk_end = min(i + chunk_sample_count, sample_count);
+		const int64_t data_size = (chunk_end - i) * unit_size;
+
+		const uint8_t* data = input_segment->get_sample_span(i, chunk_end);
+		if (!data) {
+			buffer.resize(data_size);
+			input_segment->get_samples(i, chunk_end, buffer.data());
+			data = buffer.data();
+		}
+
+		hash.addData(QByteArray::fromRawData((const char*)data, data_size));
+	}
+
+	return QString::fromLatin1(hash.result().toHex());
+}
+
+bool DecodeSignal::load_cached_results(DecodeWorker &worker)
+{
+	QFile file(get_cache_dir() + "/" + worker.cache_key);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&file);
+
+	quint32 magic, version;
+	quint64 samples_decoded;
+	stream >> magic >> version >> samples_decoded;
+
+	if ((stream.status() != QDataStream::Ok) || (magic != CacheFileMagic) ||
+		(version != CacheFormatVersion))
+		return false;
+
+	// Read everything before adding anything so that a damaged file is
+	// treated like a missing one
+	quint32 count;
+	stream >> count;
+	vector<QByteArray> texts;
+	for (quint32 i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++) {
+		texts.emplace_back();
+		stream >> texts.back();
+	}
+
+	stream >> count;
+	deque<CachedAnnotation> annotations;
+	for (quint32 i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++) {
+		annotations.emplace_back();
+		CachedAnnotation& a = annotations.back();
+
+		quint32 text_count;
+		stream >> a.decoder_index >> a.start_sample >> a.end_sample >>
+			a.ann_class_id >> text_count;
+
+		for (quint32 t = 0; (t < text_count) && (stream.status() == QDataStream::Ok); t++) {
+			quint32 text_id;
+			stream >> text_id;
+			if (text_id >= texts.size())
+				return false;
+			a.texts.push_back(text_id);
+		}
+
+		if (a.decoder_index >= stack_.size())
+			return false;
+	}
+
+	stream >> count;
+	deque<CachedBinaryChunk> binary_chunks;
+	for (quint32 i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++) {
+		binary_chunks.emplace_back();
+		CachedBinaryChunk& b = binary_chunks.back();
+
+		stream >> b.decoder_index >> b.bin_class_id >> b.sample;
+		if (!read_cache_blob(stream, b.data) || (b.decoder_index >= stack_.size()))
+			return false;
+	}
+
+	stream >> count;
+	vector< pair<quint32, vector<uint8_t>> > logic_outputs;
+	for (quint32 i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++) {
+		logic_outputs.emplace_back();
+		stream >> logic_outputs.back().first;
+		if (!read_cache_blob(stream, logic_outputs.back().second))
+			return false;
+
+		const quint32 decoder_index = logic_outputs.back().first;
+		if ((decoder_index >= stack_.size()) || !stack_[decoder_index]->has_logic_output())
+			return false;
+	}
+
+	if (stream.status() != QDataStream::Ok)
+		return false;
+
+	for (const CachedAnnotation& a : annotations) {
+		vector<const char*> ann_texts;
+		for (quint32 text_id : a.texts)
+			ann_texts.push_back(texts[text_id].constData());
+		ann_texts.push_back(nullptr);
+
+		add_decoder_annotation(worker, stack_[a.decoder_index].get(),
+			a.start_sample, a.end_sample, a.ann_class_id, ann_texts.data());
+	}
+	flush_annotations(worker);
+
+	for (const CachedBinaryChunk& b : binary_chunks)
+		add_decoder_binary(worker, stack_[b.decoder_index].get(), b.sample,
+			b.bin_class_id, b.data.data(), b.data.size());
+
+	{
+		lock_guard<mutex> lock(output_mutex_);
+
+		for (pair<quint32, vector<uint8_t>>& output : logic_outputs)
+			get_logic_output_segment(stack_[output.first]->get_srd_decoder())->
+				append_payload(output.second.data(), output.second.size());
+
+		DecodeSegment& segment = segments_.at(worker.segment_id);
+		segment.samples_decoded_incl = samples_decoded;
+		segment.samples_decoded_excl = samples_decoded;
+	}
+
+	new_annotations();
+
+	return true;
+}
+
+void DecodeSignal::store_cached_results(uint32_t segment_id, const QString &key,
+	const vector<uint64_t> &logic_starts)
+{
+	const QString cache_dir = get_cache_dir();
+	if (!QDir().mkpath(cache_dir)) {
+		qWarning() << "Can't create the decoder cache directory" << cache_dir;
+		return;
+	}
+
+	QSaveFile file(cache_dir + "/" + key);
+	if (!file.open(QIODevice::WriteOnly)) {
+		qWarning() << "Can't write decoder cache file" << file.fileName();
+		return;
+	}
+
+	QDataStream stream(&file);
+
+	// The segment is complete, but other decode threads may still be adding
+	// segments and annotations, so it's only read while holding the lock
+	unique_lock<mutex> lock(output_mutex_);
+	const DecodeSegment* segment = &(segments_.at(segment_id));
+
+	map<const Decoder*, quint32> decoder_indices;
+	for (size_t i = 0; i < stack_.size(); i++)
+		decoder_indices[stack_[i].get()] = i;
+
+	stream << CacheFileMagic << CacheFormatVersion << (quint64)segment->samples_decoded_excl;
+
+	// Annotations often repeat the same texts, so they're stored only once
+	map<QString, quint32> text_ids;
+	vector<const QString*> texts;
+	quint32 ann_count = 0;
+	for (const auto& row_data : segment->annotation_rows)
+		for (const Annotation& a : row_data.second.annotations()) {
+			for (const QString& text : *(a.annotations()))
+				if (text_ids.emplace(text, texts.size()).second)
+					texts.push_back(&text);
+			ann_count++;
+		}
 
+	stream << (quint32)texts.size();
+	for (const QString* text : texts)
+		stream << text->toUtf8();
+
+	stream << ann_count;
+	for (const auto& row_data : segment->annotation_rows)
+		for (const Annotation& a : row_data.second.annotations()) {
+			stream << decoder_indices.at(a.row()->decoder()) << (quint64)a.start_sample() <<
+				(quint64)a.end_sample() << a.ann_class_id() << (quint32)a.annotations()->size();
+			for (const QString& text : *(a.annotations()))
+				stream << text_ids.at(text);
 		}
-	} while (!decode_interrupt_);
+
+	quint32 chunk_count = 0;
+	for (const DecodeBinaryClass& bc : segment->binary_classes)
+		chunk_count += bc.chunks.size();
+
+	stream << chunk_count;
+	for (const DecodeBinaryClass& bc : segment->binary_classes)
+		for (size_t i = 0; i < bc.chunks.size(); i++) {
+			const DecodeBinaryDataChunk& chunk = bc.chunks[i];
+			const uint64_t size = bc.chunk_size(i);
+			stream << decoder_indices.at(bc.decoder) << bc.info->bin_class_id <<
+				(quint64)chunk.sample << (quint64)size;
+
+			// Same layout as write_cache_blob(), written a page at a time
+			bc.for_each_span(chunk.offset, chunk.offset + size,
+				[&](const uint8_t* data, uint64_t n) {
+					stream.writeRawData((const char*)data, (int)n);
+				});
+		}
+
+	lock.unlock();
+
+	// The logic output of all segments goes into one logic segment, so
+	// only the part that was added while decoding this segment is stored
+	const vector<uint64_t> logic_ends = get_logic_output_sample_counts();
+
+	quint32 logic_output_count = 0;
+	for (const shared_ptr<Decoder>& dec : stack_)
+		if (dec->has_logic_output())
+			logic_output_count++;
+
+	stream << logic_output_count;
+	for (size_t i = 0; i < stack_.size(); i++) {
+		if (!stack_[i]->has_logic_output())
+			continue;
+
+		shared_ptr<LogicSegment> output_segment;
+		{
+			lock_guard<mutex> output_lock(output_mutex_);
+			output_segment = get_logic_output_segment(stack_[i]->get_srd_decoder());
+		}
+
+		const uint64_t start = (i < logic_starts.size()) ? logic_starts[i] : 0;
+		const uint64_t end = max(start, logic_ends[i]);
+
+		vector<uint8_t> data((end - start) * output_segment->unit_size());
+		if (end > start)
+			output_segment->get_samples(start, end, data.data());
+
+		stream << (quint32)i;
+		write_cache_blob(stream, data.data(), data.size());
+	}
+
+	if ((stream.status() != QDataStream::Ok) || !file.commit()) {
+		qWarning() << "Failed to write decoder cache file" << file.fileName();
+		return;
+	}
+
+	// Make room by removing the least recently written files
+	qint64 total_size = 0;
+	for (const QFileInfo& info : QDir(cache_dir).entryInfoList(QDir::Files, QDir::Time)) {
+		total_size += info.size();
+		if (total_size > CacheMaxSize)
+			QFile::remove(info.absoluteFilePath());
+	}
 }
 
-void DecodeSignal::start_srd_session()
+vector<uint64_t> DecodeSignal::get_logic_output_sample_counts()
 {
+	vector<uint64_t> counts(stack_.size(), 0);
+
+	lock_guard<mutex> lock(output_mutex_);
+
+	for (size_t i = 0; i < stack_.size(); i++)
+		if (stack_[i]->has_logic_output())
+			counts[i] = get_logic_output_segment(
+				stack_[i]->get_srd_decoder())->get_sample_count();
+
+	return counts;
+}
+
+shared_ptr<LogicSegment> DecodeSignal::get_logic_output_segment(const srd_decoder *decoder)
+{
+	// Must be called with output_mutex_ locked
+	shared_ptr<Logic> output_logic = output_logic_.at(decoder);
+
+	vector< shared_ptr<Segment> > segments = output_logic->segments();
+
+	if (!segments.empty())
+		return dynamic_pointer_cast<LogicSegment>(segments.back());
+
+	// Happens when the data was cleared - all segments are gone then
+	// segment_id is always 0 as it's the first segment
+	shared_ptr<LogicSegment> segment = make_shared<data::LogicSegment>(
+		*output_logic, 0, (output_logic->num_channels() + 7) / 8, output_logic->get_samplerate());
+	output_logic->push_segment(segment);
+
+	return segment;
+}
+
+void DecodeSignal::start_srd_session(DecodeWorker &worker)
+{
+#ifdef HAVE_SHM_OPEN
+	if (use_decode_processes_) {
+		start_decode_process(worker);
+		return;
+	}
+
+	// The setting may have changed since the last run
+	worker.process.reset();
+#endif
+
 	// If there were stack changes, the session has been destroyed by now, so if
 	// it hasn't been destroyed, we can just reset and re-use it
-	if (srd_session_) {
+	if (worker.session) {
 		// When a decoder stack was created before, re-use it
 		// for the next stream of input data, after terminating
 		// potentially still executing operations, and resetting
@@ -1452,103 +2434,146 @@ void DecodeSignal::start_srd_session()
 
 		// TODO Reduce redundancy, use a common code path for
 		// the meta/start sequence?
-		terminate_srd_session();
-
-		// Metadata is cleared also, so re-set it
-		uint64_t samplerate = 0;
-		if (segments_.size() > 0)
-			samplerate = segments_.at(current_segment_id_).samplerate;
-		if (samplerate)
-			srd_session_metadata_set(srd_session_, SRD_CONF_SAMPLERATE,
-				g_variant_new_uint64(samplerate));
-		for (const shared_ptr<Decoder>& dec : stack_)
-			dec->apply_all_options();
-		srd_session_start(srd_session_);
+
+		// The worker is already set up for its next segment or partition,
+		// which the output of the old session doesn't belong to
+		worker.discard_output = true;
+		terminate_srd_session(worker);
+		worker.discard_output = false;
+
+		// Metadata is cleared also, so re-set it. The options may have
+		// changed since the last run, see set_decoder_option()
+		if (worker.samplerate)
+			srd_session_metadata_set(worker.session, SRD_CONF_SAMPLERATE,
+				g_variant_new_uint64(worker.samplerate));
+
+		for (size_t i = 0; i < worker.decoder_insts.size(); i++)
+			stack_.at(i)->apply_all_options(worker.decoder_insts[i]);
+
+		srd_session_start(worker.session);
 
 		return;
 	}
 
-	// Update the samplerates for the output logic channels
-	update_output_signals();
+	// Update the samplerates for the output logic channels. There is only
+	// one decode thread if any decoder has logic output
+	if (&worker == &decode_workers_.front())
+		update_output_signals();
 
 	// Create the session
-	srd_session_new(&srd_session_);
-	assert(srd_session_);
+	srd_session_new(&worker.session);
+	assert(worker.session);
 
 	// Create the decoders
+	worker.decoder_insts.clear();
 	srd_decoder_inst *prev_di = nullptr;
 	for (const shared_ptr<Decoder>& dec : stack_) {
-		srd_decoder_inst *const di = dec->create_decoder_inst(srd_session_);
+		srd_decoder_inst *const di = dec->create_decoder_inst(worker.session);
 
 		if (!di) {
 			set_error_message(tr("Failed to create decoder instance"));
-			srd_session_destroy(srd_session_);
-			srd_session_ = nullptr;
+			stop_srd_session(worker);
 			return;
 		}
 
 		if (prev_di)
-			srd_inst_stack(srd_session_, prev_di, di);
+			srd_inst_stack(worker.session, prev_di, di);
 
+		worker.decoder_insts.push_back(di);
 		prev_di = di;
 	}
 
 	// Start the session
-	if (segments_.size() > 0)
-		srd_session_metadata_set(srd_session_, SRD_CONF_SAMPLERATE,
-			g_variant_new_uint64(segments_.at(current_segment_id_).samplerate));
+	srd_session_metadata_set(worker.session, SRD_CONF_SAMPLERATE,
+		g_variant_new_uint64(worker.samplerate));
 
-	srd_pd_output_callback_add(srd_session_, SRD_OUTPUT_ANN,
-		DecodeSignal::annotation_callback, this);
+	srd_pd_output_callback_add(worker.session, SRD_OUTPUT_ANN,
+		DecodeSignal::annotation_callback, &worker);
 
-	srd_pd_output_callback_add(srd_session_, SRD_OUTPUT_BINARY,
-		DecodeSignal::binary_callback, this);
+	srd_pd_output_callback_add(worker.session, SRD_OUTPUT_BINARY,
+		DecodeSignal::binary_callback, &worker);
 
-	srd_pd_output_callback_add(srd_session_, SRD_OUTPUT_LOGIC,
-		DecodeSignal::logic_output_callback, this);
+	srd_pd_output_callback_add(worker.session, SRD_OUTPUT_LOGIC,
+		DecodeSignal::logic_output_callback, &worker);
 
-	srd_session_start(srd_session_);
+	srd_session_start(worker.session);
 
 	// We just recreated the srd session, so all stack changes are applied now
 	stack_config_changed_ = false;
 }
 
-void DecodeSignal::terminate_srd_session()
+#ifdef HAVE_SHM_OPEN
+void DecodeSignal::start_decode_process(DecodeWorker &worker)
+{
+	// The setting may have changed since the last run
+	if (worker.session)
+		stop_srd_session(worker);
+
+	// Re-use the process unless the stack changed, same as for the sessions
+	if (worker.process) {
+		if (!worker.process->reset(stack_, worker.samplerate)) {
+			qWarning().nospace() << name() << ": " <<
+				QString::fromStdString(worker.process->error());
+			set_error_message(tr("Decoder reported an error"));
+			worker.process.reset();
+		}
+		return;
+	}
+
+	DecodeWorker* const w = &worker;
+	worker.process = make_shared<decode::DecodeProcess>(
+		[this, w](uint32_t decoder_index, uint64_t start_sample, uint64_t end_sample,
+			uint32_t ann_class, const char* const* texts) {
+			if (decoder_index < stack_.size())
+				add_decoder_annotation(*w, stack_[decoder_index].get(),
+					start_sample, end_sample, ann_class, texts);
+		},
+		[this, w](uint32_t decoder_index, uint64_t start_sample,
+			uint32_t bin_class, const uint8_t* data, uint64_t size) {
+			if (decoder_index < stack_.size())
+				add_decoder_binary(*w, stack_[decoder_index].get(),
+					start_sample, bin_class, data, size);
+		});
+
+	if (!worker.process->start(stack_, worker.samplerate)) {
+		qWarning().nospace() << name() << ": " <<
+			QString::fromStdString(worker.process->error());
+		set_error_message(tr("Failed to start the decoder process"));
+		worker.process.reset();
+		return;
+	}
+
+	// The process was created with the current stack
+	stack_config_changed_ = false;
+}
+#endif
+
+void DecodeSignal::terminate_srd_session(DecodeWorker &worker)
 {
 	// Call the "terminate and reset" routine for the decoder stack
 	// (if available). This does not harm those stacks which already
 	// have completed their operation, and reduces response time for
 	// those stacks which still are processing data while the
 	// application no longer wants them to.
-	if (srd_session_) {
+	if (worker.session) {
 #if defined HAVE_SRD_SESSION_SEND_EOF && HAVE_SRD_SESSION_SEND_EOF
-		(void)srd_session_send_eof(srd_session_);
+		(void)srd_session_send_eof(worker.session);
 #endif
-		srd_session_terminate_reset(srd_session_);
-
-		// Metadata is cleared also, so re-set it
-		uint64_t samplerate = 0;
-		if (segments_.size() > 0)
-			samplerate = segments_.at(current_segment_id_).samplerate;
-		if (samplerate)
-			srd_session_metadata_set(srd_session_, SRD_CONF_SAMPLERATE,
-				g_variant_new_uint64(samplerate));
-		for (const shared_ptr<Decoder>& dec : stack_)
-			dec->apply_all_options();
+		srd_session_terminate_reset(worker.session);
 	}
 }
 
-void DecodeSignal::stop_srd_session()
+void DecodeSignal::stop_srd_session(DecodeWorker &worker)
 {
-	if (srd_session_) {
-		// Destroy the session
-		srd_session_destroy(srd_session_);
-		srd_session_ = nullptr;
-
-		// Mark the decoder instances as non-existant since they were deleted
-		for (const shared_ptr<Decoder>& dec : stack_)
-			dec->invalidate_decoder_inst();
+	if (worker.session) {
+		// Destroy the session, this also deletes the decoder instances
+		srd_session_destroy(worker.session);
+		worker.session = nullptr;
+		worker.decoder_insts.clear();
 	}
+
+	// Also terminates the helper process, if any
+	worker.process.reset();
 }
 
 void DecodeSignal::connect_input_notifiers()
@@ -1585,59 +2610,62 @@ void DecodeSignal::disconnect_input_notifiers()
 	}
 }
 
-void DecodeSignal::create_decode_segment()
+uint64_t DecodeSignal::create_decode_segment(uint32_t segment_id)
 {
-	// Create annotation segment
-	segments_.emplace_back();
+	lock_guard<mutex> lock(output_mutex_);
 
-	// Add annotation classes
-	for (const shared_ptr<Decoder>& dec : stack_)
-		for (Row* row : dec->get_rows())
-			segments_.back().annotation_rows.emplace(row, RowData(row));
+	// Segments may be decoded out of order, so create all segments up to
+	// the requested one. deque::emplace_back() keeps references to the
+	// existing segments valid for the other decode threads
+	while (segments_.size() <= segment_id) {
+		const uint32_t id = segments_.size();
 
-	// Prepare our binary output classes
-	for (const shared_ptr<Decoder>& dec : stack_) {
-		uint32_t n = dec->get_binary_class_count();
+		// Create annotation segment
+		segments_.emplace_back();
+		DecodeSegment& segment = segments_.back();
 
-		for (uint32_t i = 0; i < n; i++)
-			segments_.back().binary_classes.push_back(
-				{dec.get(), dec->get_binary_class(i), deque<DecodeBinaryDataChunk>()});
-	}
-}
+		shared_ptr<const LogicSegment> input_segment =
+			decode_input_data_->logic_segments().at(id);
+		segment.samplerate = input_segment->samplerate();
+		segment.start_time = input_segment->start_time();
+		segment.samples_decoded_incl = 0;
+		segment.samples_decoded_excl = 0;
 
-void DecodeSignal::annotation_callback(srd_proto_data *pdata, void *decode_signal)
-{
-	assert(pdata);
-	assert(decode_signal);
+		// Add annotation classes
+		for (const shared_ptr<Decoder>& dec : stack_)
+			for (Row* row : dec->get_rows())
+				segment.annotation_rows.emplace(row, RowData(row));
 
-	DecodeSignal *const ds = (DecodeSignal*)decode_signal;
-	assert(ds);
+		// Prepare our binary output classes
+		for (const shared_ptr<Decoder>& dec : stack_) {
+			uint32_t n = dec->get_binary_class_count();
 
-	if (ds->decode_interrupt_)
-		return;
+			for (uint32_t i = 0; i < n; i++)
+				segment.binary_classes.push_back(
+					{dec.get(), dec->get_binary_class(i), deque<DecodeBinaryDataChunk>(),
+					deque< vector<uint8_t> >(), 0, true});
+		}
+	}
 
-	if (ds->segments_.empty())
-		return;
+	return segments_[segment_id].samplerate;
+}
 
-	lock_guard<mutex> lock(ds->output_mutex_);
+void DecodeSignal::add_decoder_annotation(DecodeWorker &worker, Decoder *dec,
+	uint64_t start_sample, uint64_t end_sample, uint32_t ann_class_id,
+	const char* const* texts)
+{
+	assert(dec);
 
-	// Get the decoder and the annotation data
-	assert(pdata->pdo);
-	assert(pdata->pdo->di);
-	const srd_decoder *const srd_dec = pdata->pdo->di->decoder;
-	assert(srd_dec);
+	if (decode_interrupt_ || worker.discard_output)
+		return;
 
-	const srd_proto_data_annotation *const pda = (const srd_proto_data_annotation*)pdata->data;
-	assert(pda);
+	const steady_clock::time_point callback_start = steady_clock::now();
 
 	// Find the row
-	Decoder* dec = ds->get_decoder_by_instance(srd_dec);
-	assert(dec);
-
-	AnnotationClass* ann_class = dec->get_ann_class_by_id(pda->ann_class);
+	AnnotationClass* ann_class = dec->get_ann_class_by_id(ann_class_id);
 	if (!ann_class) {
-		qWarning() << "Decoder" << ds->display_name() << "wanted to add annotation" <<
-			"with class ID" << pda->ann_class << "but there are only" <<
+		qWarning() << "Decoder" << display_name() << "wanted to add annotation" <<
+			"with class ID" << ann_class_id << "but there are only" <<
 			dec->ann_classes().size() << "known classes";
 		return;
 	}
@@ -1647,130 +2675,219 @@ void DecodeSignal::annotation_callback(srd_proto_data *pdata, void *decode_signa
 	if (!row)
 		row = dec->get_row_by_id(0);
 
-	RowData& row_data = ds->segments_[ds->current_segment_id_].annotation_rows.at(row);
+	if (worker.split) {
+		// Only keep the annotations that start within the partition, the
+		// others belong to the warm-up or to the next partition
+		DecodeSplit *const split = worker.split;
+		start_sample += worker.sample_offset;
+		end_sample += worker.sample_offset;
 
-	// Add the annotation to the row
-	const Annotation* ann = row_data.emplace_annotation(pdata);
+		if ((start_sample < split->bounds[worker.partition]) ||
+			(start_sample >= split->bounds[worker.partition + 1]))
+			return;
+	}
 
-	// We insert the annotation into the global annotation list in a way so that
-	// the annotation list is sorted by start sample and length. Otherwise, we'd
-	// have to sort the model, which is expensive
-	deque<const Annotation*>& all_annotations =
-		ds->segments_[ds->current_segment_id_].all_annotations;
+	// The annotation is only collected here and added along with the others
+	// of the same chunk, so that output_mutex_ isn't taken for every single one.
+	// The texts are copied into a buffer that is reused for every batch
+	const size_t texts_offset = worker.pending_texts.size();
+	uint32_t text_count = 0;
+	for (const char* const* t = texts; *t; t++, text_count++)
+		worker.pending_texts.insert(worker.pending_texts.end(), *t, *t + strlen(*t) + 1);
 
-	if (all_annotations.empty()) {
-		all_annotations.emplace_back(ann);
-	} else {
-		const uint64_t new_ann_len = (pdata->end_sample - pdata->start_sample);
-		bool ann_has_earlier_start = (pdata->start_sample < all_annotations.back()->start_sample());
-		bool ann_is_longer = (new_ann_len >
-			(all_annotations.back()->end_sample() - all_annotations.back()->start_sample()));
-
-		if (ann_has_earlier_start && ann_is_longer) {
-			bool ann_has_same_start;
-			auto it = all_annotations.end();
-
-			do {
-				it--;
-				ann_has_earlier_start = (pdata->start_sample < (*it)->start_sample());
-				ann_has_same_start = (pdata->start_sample == (*it)->start_sample());
-				ann_is_longer = (new_ann_len > (*it)->length());
-			} while ((ann_has_earlier_start || (ann_has_same_start && ann_is_longer)) && (it != all_annotations.begin()));
-
-			// Allow inserting at the front
-			if (it != all_annotations.begin())
-				it++;
-
-			all_annotations.emplace(it, ann);
-		} else
-			all_annotations.emplace_back(ann);
-	}
-
-	// When emplace_annotation() inserts instead of appends an annotation,
-	// the pointers in all_annotations that follow the inserted annotation and
-	// point to annotations for this row are off by one and must be updated
-	if (&(row_data.annotations().back()) != ann) {
-		// Search backwards until we find the annotation we just added
-		auto row_it = row_data.annotations().end();
-		auto all_it = all_annotations.end();
-		do {
-			all_it--;
-			if ((*all_it)->row_data() == &row_data)
-				row_it--;
-		} while (&(*row_it) != ann);
-
-		// Update the annotation addresses for this row's annotations until the end
-		do {
-			if ((*all_it)->row_data() == &row_data) {
-				*all_it = &(*row_it);
-				row_it++;
+	worker.pending_annotations.push_back(
+		{row, start_sample, end_sample, ann_class_id, text_count, texts_offset});
+
+	worker.callback_time += elapsed_ns(callback_start);
+
+	if (worker.pending_annotations.size() >= AnnotationBatchSize)
+		flush_annotations(worker);
+}
+
+void DecodeSignal::flush_annotations(DecodeWorker &worker)
+{
+	// This runs after every chunk, so the worker's statistics are passed on
+	// here instead of updating the shared counters for every annotation
+	stats_callback_time_ += worker.callback_time;
+	stats_lock_wait_time_ += worker.lock_wait_time;
+	worker.callback_time = 0;
+	worker.lock_wait_time = 0;
+
+	if (worker.pending_annotations.empty())
+		return;
+
+	{
+		const steady_clock::time_point wait_start = steady_clock::now();
+		lock_guard<mutex> lock(output_mutex_);
+		stats_lock_wait_time_ += elapsed_ns(wait_start);
+
+		if (worker.split && (worker.partition > 0)) {
+			// Hold back the annotations of all but the first partition until
+			// the partitions before are done, see finish_partition()
+			vector<DecodeStagedAnnotation>& staged =
+				worker.split->staged_annotations[worker.partition];
+			vector<char>& staged_texts = worker.split->staged_texts[worker.partition];
+
+			const size_t texts_offset = staged_texts.size();
+			staged_texts.insert(staged_texts.end(),
+				worker.pending_texts.begin(), worker.pending_texts.end());
+
+			for (DecodeStagedAnnotation a : worker.pending_annotations) {
+				a.texts += texts_offset;
+				staged.push_back(a);
 			}
-			all_it++;
-		} while (all_it != all_annotations.end());
+		} else
+			add_staged_annotations(segments_.at(worker.segment_id),
+				worker.pending_annotations, worker.pending_texts);
 	}
+
+	worker.pending_annotations.clear();
+	worker.pending_texts.clear();
 }
 
-void DecodeSignal::binary_callback(srd_proto_data *pdata, void *decode_signal)
+void DecodeSignal::add_staged_annotations(DecodeSegment &segment,
+	const vector<DecodeStagedAnnotation> &annotations, const vector<char> &texts)
 {
-	assert(pdata);
-	assert(decode_signal);
+	vector<const char*> ann_texts;
+
+	for (const DecodeStagedAnnotation& a : annotations) {
+		ann_texts.clear();
+		const char* t = texts.data() + a.texts;
+		for (uint32_t i = 0; i < a.text_count; i++) {
+			ann_texts.push_back(t);
+			t += strlen(t) + 1;
+		}
+		ann_texts.push_back(nullptr);
 
-	DecodeSignal *const ds = (DecodeSignal*)decode_signal;
-	assert(ds);
+		segment.annotation_rows.at(a.row).emplace_annotation(
+			a.start_sample, a.end_sample, a.ann_class_id, ann_texts.data());
+	}
+}
 
-	if (ds->decode_interrupt_)
+void DecodeSignal::add_decoder_binary(DecodeWorker &worker, Decoder *dec,
+	uint64_t start_sample, uint32_t bin_class_id, const uint8_t* data, uint64_t size)
+{
+	if (decode_interrupt_ || worker.discard_output)
 		return;
 
-	// Get the decoder and the binary data
+	const steady_clock::time_point callback_start = steady_clock::now();
+	const uint64_t sample = start_sample + worker.sample_offset;
+
+	if (worker.split) {
+		// Same as for the annotations, see add_decoder_annotation()
+		DecodeSplit *const split = worker.split;
+		if ((sample < split->bounds[worker.partition]) ||
+			(sample >= split->bounds[worker.partition + 1]))
+			return;
+
+		if (worker.partition > 0) {
+			const steady_clock::time_point wait_start = steady_clock::now();
+			lock_guard<mutex> lock(output_mutex_);
+			worker.lock_wait_time += elapsed_ns(wait_start);
+
+			split->staged_binary[worker.partition].emplace_back();
+			DecodeStagedBinary& staged = split->staged_binary[worker.partition].back();
+			staged.decoder = dec;
+			staged.bin_class_id = bin_class_id;
+			staged.sample = sample;
+			staged.data.assign(data, data + size);
+			worker.callback_time += elapsed_ns(callback_start);
+			return;
+		}
+	}
+
+	{
+		const steady_clock::time_point wait_start = steady_clock::now();
+		lock_guard<mutex> lock(output_mutex_);
+		worker.lock_wait_time += elapsed_ns(wait_start);
+
+		// Find the matching DecodeBinaryClass
+		DecodeSegment* segment = &(segments_.at(worker.segment_id));
+
+		DecodeBinaryClass* bin_class = nullptr;
+		for (DecodeBinaryClass& bc : segment->binary_classes)
+			if ((bc.decoder == dec) && (bc.info->bin_class_id == bin_class_id))
+				bin_class = &bc;
+
+		if (!bin_class) {
+			qWarning() << "Could not find valid DecodeBinaryClass in segment" <<
+					worker.segment_id << "for binary class ID" << bin_class_id <<
+					", segment only knows" << segment->binary_classes.size() << "classes";
+			return;
+		}
+
+		bin_class->append(sample, data, size);
+	}
+
+	worker.callback_time += elapsed_ns(callback_start);
+
+	new_binary_data(worker.segment_id, (void*)dec, bin_class_id);
+}
+
+void DecodeSignal::annotation_callback(srd_proto_data *pdata, void *decode_worker)
+{
+	assert(pdata);
+	assert(decode_worker);
+
+	DecodeWorker *const worker = (DecodeWorker*)decode_worker;
+	DecodeSignal *const ds = worker->owner;
+	assert(ds);
+
+	// Get the decoder and the annotation data
 	assert(pdata->pdo);
 	assert(pdata->pdo->di);
 	const srd_decoder *const srd_dec = pdata->pdo->di->decoder;
 	assert(srd_dec);
 
-	const srd_proto_data_binary *const pdb = (const srd_proto_data_binary*)pdata->data;
-	assert(pdb);
+	const srd_proto_data_annotation *const pda = (const srd_proto_data_annotation*)pdata->data;
+	assert(pda);
+
+	Decoder* dec = ds->get_decoder_by_instance(srd_dec);
+	assert(dec);
 
-	// Find the matching DecodeBinaryClass
-	DecodeSegment* segment = &(ds->segments_.at(ds->current_segment_id_));
+	ds->add_decoder_annotation(*worker, dec, pdata->start_sample,
+		pdata->end_sample, pda->ann_class, (char**)pda->ann_text);
+}
 
-	DecodeBinaryClass* bin_class = nullptr;
-	for (DecodeBinaryClass& bc : segment->binary_classes)
-		if ((bc.decoder->get_srd_decoder() == srd_dec) &&
-			(bc.info->bin_class_id == (uint32_t)pdb->bin_class))
-			bin_class = &bc;
+void DecodeSignal::binary_callback(srd_proto_data *pdata, void *decode_worker)
+{
+	assert(pdata);
+	assert(decode_worker);
 
-	if (!bin_class) {
-		qWarning() << "Could not find valid DecodeBinaryClass in segment" <<
-				ds->current_segment_id_ << "for binary class ID" << pdb->bin_class <<
-				", segment only knows" << segment->binary_classes.size() << "classes";
-		return;
-	}
+	DecodeWorker *const worker = (DecodeWorker*)decode_worker;
+	DecodeSignal *const ds = worker->owner;
+	assert(ds);
 
-	// Add the data chunk
-	bin_class->chunks.emplace_back();
-	DecodeBinaryDataChunk* chunk = &(bin_class->chunks.back());
+	// Get the decoder and the binary data
+	assert(pdata->pdo);
+	assert(pdata->pdo->di);
+	const srd_decoder *const srd_dec = pdata->pdo->di->decoder;
+	assert(srd_dec);
 
-	chunk->sample = pdata->start_sample;
-	chunk->data.resize(pdb->size);
-	memcpy(chunk->data.data(), pdb->data, pdb->size);
+	const srd_proto_data_binary *const pdb = (const srd_proto_data_binary*)pdata->data;
+	assert(pdb);
 
 	Decoder* dec = ds->get_decoder_by_instance(srd_dec);
 
-	ds->new_binary_data(ds->current_segment_id_, (void*)dec, pdb->bin_class);
+	ds->add_decoder_binary(*worker, dec, pdata->start_sample, pdb->bin_class,
+		pdb->data, pdb->size);
 }
 
-void DecodeSignal::logic_output_callback(srd_proto_data *pdata, void *decode_signal)
+void DecodeSignal::logic_output_callback(srd_proto_data *pdata, void *decode_worker)
 {
 	assert(pdata);
-	assert(decode_signal);
+	assert(decode_worker);
 
-	DecodeSignal *const ds = (DecodeSignal*)decode_signal;
+	DecodeWorker *const worker = (DecodeWorker*)decode_worker;
+	DecodeSignal *const ds = worker->owner;
 	assert(ds);
 
 	if (ds->decode_interrupt_)
 		return;
 
+	const steady_clock::time_point callback_start = steady_clock::now();
 	lock_guard<mutex> lock(ds->output_mutex_);
+	worker->lock_wait_time += elapsed_ns(callback_start);
 
 	assert(pdata->pdo);
 	assert(pdata->pdo->di);
@@ -1787,21 +2904,7 @@ void DecodeSignal::logic_output_callback(srd_proto_data *pdata, void *decode_sig
 		return;
 	}
 
-	shared_ptr<Logic> output_logic = ds->output_logic_.at(decc);
-
-	vector< shared_ptr<Segment> > segments = output_logic->segments();
-
-	shared_ptr<LogicSegment> last_segment;
-
-	if (!segments.empty())
-		last_segment = dynamic_pointer_cast<LogicSegment>(segments.back());
-	else {
-		// Happens when the data was cleared - all segments are gone then
-		// segment_id is always 0 as it's the first segment
-		last_segment = make_shared<data::LogicSegment>(
-			*output_logic, 0, (output_logic->num_channels() + 7) / 8, output_logic->get_samplerate());
-		output_logic->push_segment(last_segment);
-	}
+	shared_ptr<LogicSegment> last_segment = ds->get_logic_output_segment(decc);
 
 	if (pdata->start_sample < pdata->end_sample) {
 		vector<uint8_t> data;
@@ -1825,6 +2928,7 @@ void DecodeSignal::logic_output_callback(srd_proto_data *pdata, void *decode_sig
 				memcpy((void*)&data.data()[i * unit_size], (void*)pdl->data, unit_size);
 
 		last_segment->append_payload(data.data(), data.size());
+		worker->callback_time += elapsed_ns(callback_start);
 	} else
 		qWarning() << "Ignoring malformed logic output state change for group" << pdl->logic_group << "from decoder" \
 			<< QString::fromUtf8(decc->name) << "from" << pdata->start_sample << "to" << pdata->end_sample;
@@ -1841,6 +2945,7 @@ void DecodeSignal::on_capture_state_changed(int state)
 
 void DecodeSignal::on_data_cleared()
 {
+	logic_mux_data_invalid_ = true;
 	reset_decode();
 }
 
@@ -1858,16 +2963,79 @@ void DecodeSignal::on_data_received()
 		qDebug().nospace() << name() << ": Input data available, error cleared";
 	}
 
-	if (!logic_mux_thread_.joinable())
+	if (decode_from_input_) {
+		if (!decode_threads_running())
+			begin_decode();
+		else
+			notify_decode_threads();
+	} else if (!logic_mux_)
 		begin_decode();
 	else
-		logic_mux_cond_.notify_one();
+		logic_mux_->notify();
 }
 
 void DecodeSignal::on_input_segment_completed()
 {
-	if (!logic_mux_thread_.joinable())
-		logic_mux_cond_.notify_one();
+	if (decode_from_input_)
+		notify_decode_threads();
+	else if (logic_mux_)
+		logic_mux_->notify();
+}
+
+void DecodeSignal::on_new_annotations()
+{
+	if (max_annotations_ == 0)
+		return;
+
+	{
+		lock_guard<mutex> lock(output_mutex_);
+
+		uint64_t count = 0;
+		for (const DecodeSegment& segment : segments_)
+			for (const auto& row_data : segment.annotation_rows)
+				count += row_data.second.get_annotation_count();
+
+		if (count <= max_annotations_)
+			return;
+
+		uint64_t excess = count - (max_annotations_ / 4) * 3;
+
+		// Whole segments go first, the remainder is cut off the front of the
+		// next segment at the same sample for all rows
+		for (DecodeSegment& segment : segments_) {
+			if (excess == 0)
+				break;
+
+			uint64_t segment_count = 0, max_sample = 0;
+			for (const auto& row_data : segment.annotation_rows) {
+				segment_count += row_data.second.get_annotation_count();
+				max_sample = max(max_sample, row_data.second.get_max_sample());
+			}
+
+			uint64_t cut = max_sample + 1;
+			if (segment_count > excess) {
+				uint64_t low = 0;
+				while (low < cut) {
+					const uint64_t mid = low + (cut - low) / 2;
+					uint64_t count_before = 0;
+					for (const auto& row_data : segment.annotation_rows)
+						count_before += row_data.second.get_annotation_count_before(mid);
+
+					if (count_before < excess)
+						low = mid + 1;
+					else
+						cut = mid;
+				}
+			}
+
+			for (auto& row_data : segment.annotation_rows) {
+				excess -= min(excess, row_data.second.get_annotation_count_before(cut));
+				row_data.second.remove_annotations_before(cut);
+			}
+		}
+	}
+
+	annotations_removed();
 }
 
 void DecodeSignal::on_annotation_visibility_changed()
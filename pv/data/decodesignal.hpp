@@ -21,9 +21,13 @@
 #define PULSEVIEW_PV_DATA_DECODESIGNAL_HPP
 
 #include <atomic>
+#include <chrono>
 #include <deque>
 #include <condition_variable>
+#include <functional>
+#include <thread>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <QDebug>
@@ -31,7 +35,9 @@
 
 #include <libsigrokdecode/libsigrokdecode.h>
 
+#include <pv/data/decode/annotationcursor.hpp>
 #include <pv/data/decode/decoder.hpp>
+#include <pv/data/decode/logicmux.hpp>
 #include <pv/data/decode/row.hpp>
 #include <pv/data/decode/rowdata.hpp>
 #include <pv/data/signalbase.hpp>
@@ -40,15 +46,22 @@
 using std::atomic;
 using std::condition_variable;
 using std::deque;
+using std::function;
 using std::map;
 using std::mutex;
+using std::pair;
 using std::vector;
 using std::shared_ptr;
+using std::weak_ptr;
+using std::chrono::steady_clock;
 
 using pv::data::decode::Annotation;
+using pv::data::decode::AnnotationCursor;
+using pv::data::decode::AnnotationSummary;
 using pv::data::decode::DecodeBinaryClassInfo;
 using pv::data::decode::DecodeChannel;
 using pv::data::decode::Decoder;
+using pv::data::decode::LogicMux;
 using pv::data::decode::Row;
 using pv::data::decode::RowData;
 
@@ -57,6 +70,11 @@ class Session;
 
 namespace data {
 
+namespace decode {
+class DecodeProcess;
+}
+
+class DecodeSignal;
 class Logic;
 class LogicSegment;
 class SignalBase;
@@ -64,15 +82,38 @@ class SignalData;
 
 struct DecodeBinaryDataChunk
 {
-	vector<uint8_t> data;
+	uint64_t offset;   ///< Where the data starts within the data of the class
 	uint64_t sample;   ///< Number of the sample where this data was provided by the PD
 };
 
+/**
+ * The binary output of one class of a decoder. The data of all chunks is
+ * stored back to back in pages that don't move once allocated, so that it
+ * can be read in place while more data is added.
+ */
 struct DecodeBinaryClass
 {
+	static const uint64_t PageSize;
+
 	const Decoder* decoder;
 	const DecodeBinaryClassInfo* info;
 	deque<DecodeBinaryDataChunk> chunks;
+	deque< vector<uint8_t> > pages;
+	uint64_t size;
+	bool chunks_in_sample_order;  ///< Whether no chunk has a lower sample than the one before
+
+	void append(uint64_t sample, const uint8_t* data, uint64_t length);
+
+	uint64_t chunk_size(size_t chunk_id) const;
+
+	/// Returns the number of the chunk that contains the byte at the given offset
+	size_t chunk_at_offset(uint64_t offset) const;
+
+	uint8_t byte_at(uint64_t offset) const;
+
+	/// Calls @a f for the data between the given offsets, one page at a time
+	void for_each_span(uint64_t start, uint64_t end,
+		function<void(const uint8_t*, uint64_t)> f) const;
 };
 
 struct DecodeSegment
@@ -87,7 +128,99 @@ struct DecodeSegment
 	double samplerate;
 	int64_t samples_decoded_incl, samples_decoded_excl;
 	vector<DecodeBinaryClass> binary_classes;
-	deque<const Annotation*> all_annotations;
+};
+
+struct DecodeStagedAnnotation
+{
+	const Row* row;
+	uint64_t start_sample, end_sample;
+	uint32_t ann_class_id;
+	uint32_t text_count;
+	size_t texts;  ///< Offset of the null-terminated texts in the text buffer
+};
+
+struct DecodeStagedBinary
+{
+	const Decoder* decoder;
+	uint32_t bin_class_id;
+	uint64_t sample;
+	vector<uint8_t> data;
+};
+
+/**
+ * A segment, or the part of it within the decode range, that is decoded as
+ * one or more partitions at the same time. The partitions are split in gaps
+ * where all input signals are idle. The output of all partitions but the
+ * first is held back until the partitions before it are done, so that it is
+ * added to the segment in order.
+ *
+ * The output matches that of an unsplit decode as long as the decoders are
+ * done with everything before a gap by its middle: what they emit at the
+ * end of a partition's data is dropped, and an annotation that is only
+ * completed by activity after the split is lost.
+ */
+struct DecodeSplit
+{
+	uint32_t segment_id;
+	vector<uint64_t> bounds;  ///< Partition i covers [bounds[i], bounds[i + 1])
+	vector<uint64_t> feed_starts;  ///< Where decoding starts, ahead of bounds[i] to warm up
+	vector<bool> claimed;  ///< Guarded by input_mutex_
+	vector<bool> finished;  ///< Guarded by output_mutex_
+	vector< vector<DecodeStagedAnnotation> > staged_annotations;
+	vector< vector<char> > staged_texts;
+	vector< deque<DecodeStagedBinary> > staged_binary;
+	uint32_t committed;  ///< Number of leading partitions added to the segment
+	QString cache_key;  ///< See DecodeWorker
+	vector<uint64_t> cache_logic_starts;
+};
+
+/**
+ * A decode thread with its own libsigrokdecode session or decoder helper
+ * process, decoding one segment or partition at a time. Passed to the srd
+ * output callbacks so that they know where the output belongs.
+ */
+struct DecodeWorker
+{
+	DecodeWorker() : owner(nullptr), session(nullptr), segment_id(0),
+		samplerate(0), split(nullptr), partition(0), sample_offset(0),
+		discard_output(false), callback_time(0), lock_wait_time(0) { };
+
+	DecodeSignal* owner;
+	struct srd_session *session;
+	vector<srd_decoder_inst*> decoder_insts;  ///< One instance per stacked decoder
+	shared_ptr<decode::DecodeProcess> process;  ///< Used instead of the session if set
+	uint32_t segment_id;
+	uint64_t samplerate;  ///< Of the segment, copied so that it's read without output_mutex_
+	DecodeSplit* split;  ///< nullptr when decoding the whole segment
+	uint32_t partition;
+	uint64_t sample_offset;  ///< Added to the sample numbers the decoders report
+	bool discard_output;  ///< Set while the decoders flush output that belongs nowhere
+	vector<uint8_t> buffer;  ///< Sample data that can't be passed in place
+	vector<DecodeStagedAnnotation> pending_annotations;  ///< Not yet added, see flush_annotations()
+	vector<char> pending_texts;  ///< Texts of the pending annotations
+	uint64_t callback_time;  ///< In ns, not yet added to the statistics, see flush_annotations()
+	uint64_t lock_wait_time;  ///< In ns, same as callback_time
+	QString cache_key;  ///< Where the results are stored when done, empty if not cached
+	vector<uint64_t> cache_logic_starts;  ///< Logic output sample counts before decoding
+	std::thread thread;
+};
+
+/**
+ * Where the time of a decode run went, see DecodeSignal::get_statistics().
+ * The times are in seconds and add up over all decode threads, so they may
+ * exceed the run time.
+ */
+struct DecodeStatistics
+{
+	double run_time;  ///< Since decoding started, until it finished
+	double mux_time;  ///< Spent muxing the decoder input, shared with signals that use the same input
+	double send_time;  ///< Spent handing samples to the decoders, includes callback_time
+	double callback_time;  ///< Spent in the output callbacks of the decoders
+	double lock_wait_time;  ///< Spent waiting for output_mutex_ to add the output
+	uint64_t samples_decoded;
+	uint64_t annotation_count;
+	uint64_t annotation_memory;  ///< Approximate bytes held by the annotations
+	uint64_t binary_memory;  ///< Bytes held by the binary output
 };
 
 class DecodeSignal : public SignalBase
@@ -98,6 +231,12 @@ private:
 	static const double DecodeMargin;
 	static const double DecodeThreshold;
 	static const int64_t DecodeChunkLength;
+	static const unsigned int MaxDecodeThreads;
+	static const double SplitIdleGapTime;
+	static const uint64_t SplitMinPartitionLength;
+	static const size_t AnnotationBatchSize;
+	static const uint32_t CacheFormatVersion;
+	static const qint64 CacheMaxSize;
 
 public:
 	DecodeSignal(pv::Session &session);
@@ -120,12 +259,47 @@ public:
 	void remove_decoder(int index);
 	bool toggle_decoder_visibility(int index);
 
+	/**
+	 * Changes an option of a decoder in the stack and restarts decoding, as
+	 * the decoder instances only pick up their options when they're set up
+	 * for a new run.
+	 */
+	void set_decoder_option(const shared_ptr<Decoder> &dec, const char *id,
+		GVariant *value);
+
 	void reset_decode(bool shutting_down = false);
 	void begin_decode();
 	void pause_decode();
 	void resume_decode();
 	bool is_paused() const;
 
+	/// Returns true once all segments of the current decode run are decoded
+	bool is_decode_finished() const;
+
+	/**
+	 * Allows discarding the oldest annotations as set by the user, which is
+	 * on by default. Takes effect when decoding is started the next time.
+	 */
+	void set_annotation_limit_enabled(bool enabled);
+
+	/**
+	 * Makes the decoders work on the given segment before any other
+	 * segments that haven't been decoded yet, e.g. the one being viewed.
+	 */
+	void set_priority_segment(uint32_t segment_id);
+
+	/**
+	 * Restricts decoding to the samples in [start_sample, end_sample) of
+	 * each segment and restarts the decoders. They are fed warm_up samples
+	 * ahead of the range so that they can synchronize to the input, but
+	 * only the output within the range is kept.
+	 */
+	void set_decode_range(uint64_t start_sample, uint64_t end_sample,
+		uint64_t warm_up = 0);
+	void clear_decode_range();
+	bool has_decode_range() const;
+	pair<uint64_t, uint64_t> decode_range() const;
+
 	const vector<decode::DecodeChannel> get_channels() const;
 	void auto_assign_signals(const shared_ptr<Decoder> dec);
 	void assign_signal(const uint16_t channel_id, shared_ptr<const SignalBase> signal);
@@ -160,6 +334,7 @@ public:
 	vector<const Row*> get_rows(bool visible_only=false) const;
 
 	uint64_t get_annotation_count(const Row* row, uint32_t segment_id) const;
+	uint64_t get_annotation_count(uint32_t segment_id) const;
 
 	/**
 	 * Extracts annotations from a single row into a vector.
@@ -177,11 +352,26 @@ public:
 	void get_annotation_subset(deque<const Annotation*> &dest, uint32_t segment_id,
 		uint64_t start_sample, uint64_t end_sample) const;
 
+	/**
+	 * Extracts summaries of the annotations of a single row for drawing
+	 * them when zoomed out, see RowData::get_annotation_summary().
+	 * @return false if summaries can't be used for the given bucket size.
+	 */
+	bool get_annotation_summary(vector<AnnotationSummary> &dest,
+		deque<const Annotation*> &details, const Row* row, uint32_t segment_id,
+		uint64_t start_sample, uint64_t end_sample, uint64_t bucket_size,
+		uint64_t detail_length) const;
+
+	/**
+	 * Finds the next annotation of the given class after @a sample or, if
+	 * @a forward is false, the previous one before it.
+	 * @return false if there is no such annotation.
+	 */
+	bool find_annotation(const Row* row, uint32_t segment_id, uint32_t ann_class_id,
+		uint64_t sample, bool forward, uint64_t &start_sample, uint64_t &end_sample) const;
+
 	uint32_t get_binary_data_chunk_count(uint32_t segment_id,
 		const Decoder* dec, uint32_t bin_class_id) const;
-	void get_binary_data_chunk(uint32_t segment_id, const Decoder* dec,
-		uint32_t bin_class_id, uint32_t chunk_id, const vector<uint8_t> **dest,
-		uint64_t *size);
 	void get_merged_binary_data_chunks_by_sample(uint32_t segment_id,
 		const Decoder* dec, uint32_t bin_class_id,
 		uint64_t start_sample, uint64_t end_sample,
@@ -190,10 +380,30 @@ public:
 		const Decoder* dec, uint32_t bin_class_id,
 		uint64_t start, uint64_t end,
 		vector<uint8_t> *dest) const;
+
+	/**
+	 * Calls @a f for the binary data between the given offsets, without
+	 * copying it. No data is added while this runs.
+	 */
+	void get_binary_data_spans(uint32_t segment_id, const Decoder* dec,
+		uint32_t bin_class_id, uint64_t start, uint64_t end,
+		function<void(const uint8_t*, uint64_t)> f) const;
 	const DecodeBinaryClass* get_binary_data_class(uint32_t segment_id,
 		const Decoder* dec, uint32_t bin_class_id) const;
 
-	const deque<const Annotation*>* get_all_annotations_by_segment(uint32_t segment_id) const;
+	/**
+	 * Returns the statistics of the current or last decode run. Also works
+	 * while decoding, to show the progress.
+	 */
+	DecodeStatistics get_statistics() const;
+
+	/**
+	 * Merges the annotations of all rows into @a cursor, sorted by start
+	 * sample with longer annotations first, until it holds at least @a count
+	 * of them or none are left. See decode::AnnotationCursor.
+	 */
+	void merge_annotations(AnnotationCursor &cursor, uint32_t segment_id,
+		size_t count) const;
 
 	virtual void save_settings(QSettings &settings) const;
 
@@ -202,7 +412,6 @@ public:
 private:
 	bool all_input_segments_complete(uint32_t segment_id) const;
 	uint32_t get_input_segment_count() const;
-	double get_input_samplerate(uint32_t segment_id) const;
 
 	Decoder* get_decoder_by_instance(const srd_decoder *const srd_dec);
 
@@ -210,25 +419,65 @@ private:
 
 	void commit_decoder_channels();
 
-	void mux_logic_samples(uint32_t segment_id, const int64_t start, const int64_t end);
-	void logic_mux_proc();
+	shared_ptr<Logic> get_direct_input_data() const;
 
-	void decode_data(const int64_t abs_start_samplenum, const int64_t sample_count,
-		const shared_ptr<const LogicSegment> input_segment);
-	void decode_proc();
+	/// Returns the bits of the assigned signals, in the order of the channels
+	vector<LogicMux::Input> get_logic_mux_inputs() const;
 
-	void start_srd_session();
-	void terminate_srd_session();
-	void stop_srd_session();
+	/**
+	 * Stops using the muxed data. If it's outdated, it's not handed out to
+	 * other decode signals anymore either.
+	 */
+	void release_logic_mux();
+
+	unsigned int get_decode_thread_count() const;
+	bool decode_threads_running() const;
+	void join_decode_threads();
+	void notify_decode_threads();
+	bool find_undecoded_segment(uint32_t &segment_id) const;
+	bool find_undecoded_partition(DecodeSplit *&split, uint32_t &partition) const;
+
+	vector<uint64_t> find_idle_gap_splits(const shared_ptr<LogicSegment> input_segment,
+		uint64_t start, uint64_t end, uint64_t &warm_up) const;
+	DecodeSplit* split_segment(uint32_t segment_id,
+		const shared_ptr<LogicSegment> input_segment);
+	void finish_partition(DecodeWorker &worker);
+	void finish_decode_work();
+
+	QString get_cache_key(const shared_ptr<const LogicSegment> input_segment) const;
+	bool load_cached_results(DecodeWorker &worker);
+	void store_cached_results(uint32_t segment_id, const QString &key,
+		const vector<uint64_t> &logic_starts);
+	vector<uint64_t> get_logic_output_sample_counts();
+	shared_ptr<LogicSegment> get_logic_output_segment(const srd_decoder *decoder);
+
+	void decode_data(DecodeWorker &worker, const int64_t abs_start_samplenum,
+		const int64_t sample_count, const shared_ptr<const LogicSegment> input_segment);
+	void decode_proc(DecodeWorker *worker);
+
+	void start_srd_session(DecodeWorker &worker);
+	void terminate_srd_session(DecodeWorker &worker);
+	void stop_srd_session(DecodeWorker &worker);
+	void start_decode_process(DecodeWorker &worker);
 
 	void connect_input_notifiers();
 	void disconnect_input_notifiers();
 
-	void create_decode_segment();
+	/// Returns the sample rate of the segment, read under output_mutex_
+	uint64_t create_decode_segment(uint32_t segment_id);
+
+	void add_decoder_annotation(DecodeWorker &worker, Decoder *dec,
+		uint64_t start_sample, uint64_t end_sample, uint32_t ann_class,
+		const char* const* texts);
+	void flush_annotations(DecodeWorker &worker);
+	void add_staged_annotations(DecodeSegment &segment,
+		const vector<DecodeStagedAnnotation> &annotations, const vector<char> &texts);
+	void add_decoder_binary(DecodeWorker &worker, Decoder *dec,
+		uint64_t start_sample, uint32_t bin_class, const uint8_t* data, uint64_t size);
 
-	static void annotation_callback(srd_proto_data *pdata, void *decode_signal);
-	static void binary_callback(srd_proto_data *pdata, void *decode_signal);
-	static void logic_output_callback(srd_proto_data *pdata, void *decode_signal);
+	static void annotation_callback(srd_proto_data *pdata, void *decode_worker);
+	static void binary_callback(srd_proto_data *pdata, void *decode_worker);
+	static void logic_output_callback(srd_proto_data *pdata, void *decode_worker);
 
 Q_SIGNALS:
 	void decoder_stacked(void* decoder); ///< decoder is of type decode::Decoder*
@@ -236,6 +485,7 @@ Q_SIGNALS:
 	void new_annotations(); // TODO Supply segment for which they belong to
 	void new_binary_data(unsigned int segment_id, void* decoder, unsigned int bin_class_id);
 	void decode_reset();
+	void annotations_removed();  ///< The oldest annotations were discarded, see on_new_annotations()
 	void decode_finished();
 	void channels_updated();
 	void annotation_visibility_changed();
@@ -246,6 +496,13 @@ private Q_SLOTS:
 	void on_data_received();
 	void on_input_segment_completed();
 
+	/**
+	 * Discards the oldest annotations once there are more than the user
+	 * allows, going down to three quarters of the maximum so that this
+	 * doesn't happen on every new annotation.
+	 */
+	void on_new_annotations();
+
 	void on_annotation_visibility_changed();
 
 private:
@@ -253,24 +510,41 @@ private:
 
 	vector<decode::DecodeChannel> channels_;
 
-	struct srd_session *srd_session_;
-
-	shared_ptr<Logic> logic_mux_data_;
-	uint32_t logic_mux_unit_size_;
+	shared_ptr<LogicMux> logic_mux_;  ///< Shared with other decode signals with the same inputs
 	bool logic_mux_data_invalid_;
 
+	bool decode_from_input_;
+	shared_ptr<Logic> decode_input_data_;
+
 	vector< shared_ptr<Decoder> > stack_;
 	bool stack_config_changed_;
 
 	deque<DecodeSegment> segments_;
-	uint32_t current_segment_id_;
-
-	mutable mutex input_mutex_, output_mutex_, decode_pause_mutex_, logic_mux_mutex_;
-	mutable condition_variable decode_input_cond_, decode_pause_cond_,
-		logic_mux_cond_;
 
-	std::thread decode_thread_, logic_mux_thread_;
-	atomic<bool> decode_interrupt_, logic_mux_interrupt_;
+	deque<DecodeWorker> decode_workers_;
+	vector<bool> segment_claimed_;  ///< Segments taken by a decode thread, guarded by input_mutex_
+	unsigned int busy_decode_threads_;
+	bool decode_in_order_;
+	atomic<uint32_t> priority_segment_;
+	bool split_at_idle_gaps_;
+	bool use_decode_processes_;
+	bool cache_results_;
+	bool annotation_limit_enabled_;
+	uint64_t max_annotations_;  ///< 0 if unlimited
+	deque<DecodeSplit> decode_splits_;  ///< Added to with input_mutex_ locked
+	bool decode_range_set_;
+	uint64_t decode_range_start_, decode_range_end_, decode_range_warm_up_;
+
+	mutable mutex input_mutex_, output_mutex_, decode_pause_mutex_;
+	mutable condition_variable decode_input_cond_, decode_pause_cond_;
+
+	atomic<bool> decode_interrupt_;
+
+	// Statistics of the decode run, in ns, see get_statistics()
+	steady_clock::time_point stats_start_time_;
+	atomic<uint64_t> stats_run_time_;  ///< 0 while decoding
+	atomic<uint64_t> stats_send_time_, stats_callback_time_, stats_lock_wait_time_;
+	atomic<uint64_t> stats_samples_decoded_;
 
 	bool decode_paused_;
 
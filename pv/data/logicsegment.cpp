@@ -403,6 +403,29 @@ void LogicSegment::get_samples(int64_t start_sample,
 	get_raw_samples(start_sample, (end_sample - start_sample), dest);
 }
 
+void LogicSegment::get_sample_spans(int64_t start_sample, int64_t end_sample,
+	function<void(const uint8_t*, uint64_t)> callback) const
+{
+	assert(start_sample >= 0);
+	assert(end_sample <= (int64_t)sample_count_);
+	assert(start_sample <= end_sample);
+
+	if (start_sample == end_sample)
+		return;
+
+	get_raw_sample_spans(start_sample, (end_sample - start_sample), callback);
+}
+
+const uint8_t* LogicSegment::get_sample_span(int64_t start_sample,
+	int64_t end_sample) const
+{
+	assert(start_sample >= 0);
+	assert(end_sample <= (int64_t)sample_count_);
+	assert(start_sample < end_sample);
+
+	return get_raw_sample_span(start_sample, (end_sample - start_sample));
+}
+
 void LogicSegment::get_subsampled_edges(
 	vector<EdgePair> &edges,
 	uint64_t start, uint64_t end,
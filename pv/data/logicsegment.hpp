@@ -101,6 +101,22 @@ public:
 
 	void get_samples(int64_t start_sample, int64_t end_sample, uint8_t* dest) const;
 
+	/**
+	 * Passes the samples from @a start_sample to @a end_sample to
+	 * @a callback without copying them, one contiguous span at a time.
+	 * The segment is locked while the callback runs.
+	 */
+	void get_sample_spans(int64_t start_sample, int64_t end_sample,
+		function<void(const uint8_t*, uint64_t)> callback) const;
+
+	/**
+	 * Returns a pointer to the samples from @a start_sample to @a end_sample
+	 * if they are stored contiguously in memory that will neither change nor
+	 * move for the lifetime of the segment. Returns nullptr otherwise, in
+	 * which case get_samples() must be used.
+	 */
+	const uint8_t* get_sample_span(int64_t start_sample, int64_t end_sample) const;
+
 	/**
 	 * Parses a logic data segment to generate a list of transitions
 	 * in a time interval to a given level of detail.
@@ -255,6 +255,57 @@ void Segment::get_raw_samples(uint64_t start, uint64_t count, uint8_t* dest) con
 	}
 }
 
+void Segment::get_raw_sample_spans(uint64_t start, uint64_t count,
+	function<void(const uint8_t*, uint64_t)> callback) const
+{
+	assert(start < sample_count_);
+	assert(start + count <= sample_count_);
+	assert(count > 0);
+
+	uint64_t chunk_num = (start * unit_size_) / chunk_size_;
+	uint64_t chunk_offs = (start * unit_size_) % chunk_size_;
+
+	// The lock is held while the callback runs, so the chunks stay in place
+	lock_guard<recursive_mutex> lock(mutex_);  // Because of free_unused_memory()
+
+	while (count > 0) {
+		const uint8_t* chunk = data_chunks_[chunk_num];
+
+		const uint64_t span_samples = min(count,
+			(chunk_size_ - chunk_offs) / unit_size_);
+
+		callback(chunk + chunk_offs, span_samples);
+
+		count -= span_samples;
+
+		chunk_num++;
+		chunk_offs = 0;
+	}
+}
+
+const uint8_t* Segment::get_raw_sample_span(uint64_t start, uint64_t count) const
+{
+	assert(start < sample_count_);
+	assert(start + count <= sample_count_);
+	assert(count > 0);
+
+	const uint64_t chunk_num = (start * unit_size_) / chunk_size_;
+	const uint64_t chunk_offs = (start * unit_size_) % chunk_size_;
+
+	if (chunk_offs + count * unit_size_ > chunk_size_)
+		return nullptr;
+
+	lock_guard<recursive_mutex> lock(mutex_);
+
+	// Only the current chunk is written to or re-allocated by
+	// free_unused_memory(), all others stay as they are until we're destroyed
+	const uint8_t* chunk = data_chunks_[chunk_num];
+	if (chunk == current_chunk_)
+		return nullptr;
+
+	return chunk + chunk_offs;
+}
+
 SegmentDataIterator* Segment::begin_sample_iteration(uint64_t start)
 {
 	SegmentDataIterator* it = new SegmentDataIterator;
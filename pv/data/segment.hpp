@@ -28,12 +28,14 @@
 #include <mutex>
 #include <thread>
 #include <deque>
+#include <functional>
 
 #include <QObject>
 
 using std::atomic;
 using std::recursive_mutex;
 using std::deque;
+using std::function;
 
 namespace SegmentTest {
 struct SmallSize8Single;
@@ -92,6 +94,9 @@ protected:
 	void append_samples(void *data, uint64_t samples);
 	const uint8_t* get_raw_sample(uint64_t sample_num) const;
 	void get_raw_samples(uint64_t start, uint64_t count, uint8_t *dest) const;
+	void get_raw_sample_spans(uint64_t start, uint64_t count,
+		function<void(const uint8_t*, uint64_t)> callback) const;
+	const uint8_t* get_raw_sample_span(uint64_t start, uint64_t count) const;
 
 	SegmentDataIterator* begin_sample_iteration(uint64_t start);
 	void continue_sample_iteration(SegmentDataIterator* it, uint64_t increase);
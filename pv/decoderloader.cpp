@@ -0,0 +1,168 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cassert>
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+#include <libsigrokdecode/libsigrokdecode.h>
+
+#include "decoderloader.hpp"
+
+using std::lock_guard;
+using std::unique_lock;
+
+namespace pv {
+
+DecoderLoader *DecoderLoader::instance_ = nullptr;
+
+DecoderLoader::DecoderLoader() :
+	load_finished_(false),
+	loaded_(false),
+	interrupt_(false)
+{
+	assert(!instance_);
+	instance_ = this;
+
+	load_thread_ = std::thread(&DecoderLoader::load_proc, this);
+}
+
+DecoderLoader::~DecoderLoader()
+{
+	stop();
+	instance_ = nullptr;
+}
+
+DecoderLoader* DecoderLoader::instance()
+{
+	return instance_;
+}
+
+bool DecoderLoader::is_loaded()
+{
+	return !instance_ || instance_->loaded_;
+}
+
+void DecoderLoader::wait_until_loaded()
+{
+	if (!instance_)
+		return;
+
+	unique_lock<mutex> lock(instance_->load_mutex_);
+	instance_->load_finished_cond_.wait(lock,
+		[] { return instance_->load_finished_; });
+}
+
+const srd_decoder* DecoderLoader::get_decoder(const char *id)
+{
+	unique_lock<mutex> lock;
+	if (instance_)
+		lock = unique_lock<mutex>(instance_->load_mutex_);
+
+	const srd_decoder *decoder = srd_decoder_get_by_id(id);
+
+	// Not loaded yet, so load it right now instead of waiting for its turn
+	if (!decoder && (srd_decoder_load(id) == SRD_OK))
+		decoder = srd_decoder_get_by_id(id);
+
+	return decoder;
+}
+
+const GSList* DecoderLoader::get_decoders()
+{
+	wait_until_loaded();
+
+	return srd_decoder_list();
+}
+
+void DecoderLoader::stop()
+{
+	interrupt_ = true;
+
+	if (load_thread_.joinable())
+		load_thread_.join();
+}
+
+vector<string> DecoderLoader::find_decoder_modules()
+{
+	vector<string> modules;
+
+	// Same as srd_decoder_load_all(): every directory in a search path is
+	// a decoder module, except for Python's own ones like __pycache__
+	GSList *paths = srd_searchpaths_get();
+	for (GSList *l = paths; l; l = l->next) {
+		const QDir dir(QString::fromUtf8((const char*)l->data));
+
+		for (const QString &entry : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+			if (entry.startsWith("__"))
+				continue;
+
+			if (QFileInfo(dir.filePath(entry + "/__init__.py")).exists())
+				modules.push_back(entry.toStdString());
+		}
+	}
+	g_slist_free_full(paths, g_free);
+
+	return modules;
+}
+
+void DecoderLoader::load_proc()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	const vector<string> modules = find_decoder_modules();
+
+	if (modules.empty()) {
+		// The decoders aren't plain directories on this platform, let
+		// libsigrokdecode find them itself
+		lock_guard<mutex> lock(load_mutex_);
+		srd_decoder_load_all();
+	}
+
+	for (const string &module : modules) {
+		if (interrupt_)
+			break;
+
+		// Lock per decoder so that get_decoder() only ever waits for one
+		lock_guard<mutex> lock(load_mutex_);
+		srd_decoder_load(module.c_str());
+	}
+
+	{
+		lock_guard<mutex> lock(load_mutex_);
+		load_finished_ = true;
+	}
+	load_finished_cond_.notify_all();
+
+	qDebug() << "Loaded" << g_slist_length((GSList*)srd_decoder_list()) <<
+		"protocol decoders in" << timer.elapsed() << "ms";
+
+	QMetaObject::invokeMethod(this, "on_load_finished", Qt::QueuedConnection);
+}
+
+void DecoderLoader::on_load_finished()
+{
+	loaded_ = true;
+	loaded();
+}
+
+} // namespace pv
@@ -0,0 +1,118 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PULSEVIEW_PV_DECODERLOADER_HPP
+#define PULSEVIEW_PV_DECODERLOADER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glib.h>
+
+#include <QObject>
+
+using std::atomic;
+using std::condition_variable;
+using std::mutex;
+using std::string;
+using std::vector;
+
+struct srd_decoder;
+
+namespace pv {
+
+/**
+ * Loads the libsigrokdecode protocol decoders on a background thread so that
+ * the main window doesn't have to wait for all the Python modules. Decoders
+ * that are needed right away are loaded ahead of the rest by get_decoder().
+ *
+ * libsigrokdecode doesn't protect its decoder list, so it must only be
+ * accessed through get_decoder() and get_decoders(), never by calling
+ * srd_decoder_get_by_id() or srd_decoder_list() directly. GUI code that
+ * doesn't want to block should check is_loaded() and wait for loaded()
+ * before calling get_decoders().
+ * Without a DecoderLoader instance, the decoders are assumed to be loaded.
+ */
+class DecoderLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	DecoderLoader();
+
+	~DecoderLoader();
+
+	static DecoderLoader* instance();
+
+	/**
+	 * Returns true once loaded() was emitted. As both happen on the main
+	 * thread, checking this and then connecting to loaded() can't miss it.
+	 */
+	static bool is_loaded();
+
+	static void wait_until_loaded();
+
+	/**
+	 * Returns the decoder with the given ID, loading it first if needed.
+	 * @return The decoder or nullptr if no such decoder could be loaded.
+	 */
+	static const srd_decoder* get_decoder(const char *id);
+
+	/**
+	 * Returns the list of all decoders, waiting for the loader to finish
+	 * first. The list isn't changed anymore after that.
+	 */
+	static const GSList* get_decoders();
+
+	/**
+	 * Stops loading after the current decoder and waits for the loader
+	 * thread. Must be called before libsigrokdecode is shut down.
+	 */
+	void stop();
+
+Q_SIGNALS:
+	void loaded();
+
+private Q_SLOTS:
+	void on_load_finished();
+
+private:
+	static vector<string> find_decoder_modules();
+
+	void load_proc();
+
+private:
+	static DecoderLoader *instance_;
+
+	mutex load_mutex_;
+	condition_variable load_finished_cond_;
+	bool load_finished_;
+
+	bool loaded_;
+
+	atomic<bool> interrupt_;
+	std::thread load_thread_;
+};
+
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DECODERLOADER_HPP
@@ -20,19 +20,25 @@
 #include "devicemanager.hpp"
 #include "session.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 
 #include <libsigrokcxx/libsigrokcxx.hpp>
 
 #include <QApplication>
 #include <QDebug>
-#include <QObject>
-#include <QProgressDialog>
+#include <QMetaObject>
 
 #include <boost/filesystem.hpp>
 
@@ -40,14 +46,24 @@
 #include <pv/util.hpp>
 
 using std::bind;
+using std::condition_variable;
+using std::deque;
 using std::list;
+using std::lock_guard;
+using std::make_shared;
 using std::map;
+using std::min;
+using std::mutex;
 using std::placeholders::_1;
 using std::placeholders::_2;
+using std::set;
 using std::shared_ptr;
 using std::string;
-using std::unique_ptr;
+using std::thread;
+using std::unique_lock;
 using std::vector;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
 
 using Glib::VariantBase;
 
@@ -57,16 +73,57 @@ using sigrok::Driver;
 
 namespace pv {
 
+// Driver scans mostly wait for USB, serial or network I/O rather than the
+// CPU, so this doesn't need to follow the number of cores
+const unsigned int DeviceManager::ScanThreadCount = 4;
+
+// Drivers taking longer than this many ms to scan are no longer waited for.
+// Their results are still added should they arrive later on.
+const int DeviceManager::ScanTimeout = 5000;
+
+const int DeviceManager::ScanWatchdogInterval = 250;
+
+struct DeviceManager::ScanJob
+{
+	shared_ptr<Driver> driver;
+	map<const ConfigKey *, VariantBase> options;
+	bool user_spec;
+
+	vector< shared_ptr<sigrok::HardwareDevice> > devices;
+	string error;
+
+	steady_clock::time_point started;
+	bool timed_out;
+};
+
+struct DeviceManager::ScanState
+{
+	mutex state_mutex;
+	condition_variable workers_done;
+
+	deque< shared_ptr<ScanJob> > queued, running, done;
+	unsigned int workers;
+
+	// Names of the drivers currently scanning, see driver_scan()
+	set<string> scanning;
+	condition_variable scan_done;
+
+	// Set to nullptr when the manager is destroyed. Workers can still be
+	// stuck in a driver that timed out at that point, which is why they
+	// keep the context alive.
+	DeviceManager *owner;
+	shared_ptr<Context> context;
+};
+
 DeviceManager::DeviceManager(shared_ptr<Context> context,
 	std::string driver, bool do_scan) :
-	context_(context)
+	context_(context),
+	scan_state_(make_shared<ScanState>()),
+	scan_in_progress_(false)
 {
-	unique_ptr<QProgressDialog> progress(new QProgressDialog("",
-		QObject::tr("Cancel"), 0, context->drivers().size() + 1));
-	progress->setWindowModality(Qt::WindowModal);
-	progress->setMinimumDuration(1);  // To show the dialog immediately
-
-	int entry_num = 1;
+	scan_state_->workers = 0;
+	scan_state_->owner = this;
+	scan_state_->context = context;
 
 	/*
 	 * Check the presence of an optional user spec for device scans.
@@ -81,38 +138,15 @@ DeviceManager::DeviceManager(shared_ptr<Context> context,
 		user_opts.erase(user_opts.begin());
 	}
 
-	/*
-	 * Scan for devices. No specific options apply here, this is
-	 * best effort auto detection.
-	 */
-	for (auto& entry : context->drivers()) {
-		if (!do_scan)
-			break;
-
-		// Skip drivers we won't scan anyway
-		if (!driver_supported(entry.second))
-			continue;
-
-		progress->setLabelText(QObject::tr("Scanning for devices that driver %1 can access...")
-			.arg(QString::fromStdString(entry.first)));
-
-		if (entry.first == user_name)
-			continue;
-		driver_scan(entry.second, map<const ConfigKey *, VariantBase>());
-
-		progress->setValue(entry_num++);
-		QApplication::processEvents();
-		if (progress->wasCanceled())
-			break;
-	}
-
 	/*
 	 * Optionally run another scan with potentially more specific
 	 * options when requested by the user. This is motivated by
 	 * several different uses: It can find devices that are not
-	 * covered by the above auto detection (UART, TCP). It can
-	 * prefer one out of multiple found devices, and have this
-	 * device pre-selected for new sessions upon user's request.
+	 * covered by the auto detection (UART, TCP). It can prefer
+	 * one out of multiple found devices, and have this device
+	 * pre-selected for new sessions upon user's request.
+	 *
+	 * This scan is queued first so that its device shows up first.
 	 */
 	user_spec_device_.reset();
 	if (!driver.empty()) {
@@ -120,44 +154,41 @@ DeviceManager::DeviceManager(shared_ptr<Context> context,
 		qDebug() << "Driver string:" << QString::fromStdString(driver);
 		qDebug() << "User name:" << QString::fromStdString(user_name);
 		qDebug() << "User opts size:" << user_opts.size();
-		
-		shared_ptr<sigrok::Driver> scan_drv;
-		map<const ConfigKey *, VariantBase> scan_opts;
 
 		/*
 		 * Lookup the device driver name.
 		 */
 		map<string, shared_ptr<Driver>> drivers = context->drivers();
 		auto entry = drivers.find(user_name);
-		scan_drv = (entry != drivers.end()) ? entry->second : nullptr;
-		
-		qDebug() << "Driver lookup result:" << (scan_drv ? "Found" : "Not found");
+		shared_ptr<sigrok::Driver> scan_drv =
+			(entry != drivers.end()) ? entry->second : nullptr;
 
-		/*
-		 * Convert generic string representation of options
-		 * to the driver specific data types.
-		 */
-		if (scan_drv && !user_opts.empty()) {
-			auto drv_opts = scan_drv->scan_options();
-			scan_opts = drive_scan_options(user_opts, drv_opts);
-			qDebug() << "Converted scan options, size:" << scan_opts.size();
-		}
+		qDebug() << "Driver lookup result:" << (scan_drv ? "Found" : "Not found");
 
-		/*
-		 * Run another scan for the specified driver, passing
-		 * user provided scan options this time.
-		 */
-		list< shared_ptr<devices::HardwareDevice> > found;
-		if (scan_drv) {
-			qDebug() << "Running targeted scan for driver:" << QString::fromStdString(user_name);
-			found = driver_scan(scan_drv, scan_opts);
-			qDebug() << "Targeted scan found" << found.size() << "devices";
-			if (!found.empty()) {
-				user_spec_device_ = found.front();
-				qDebug() << "USER SPEC DEVICE SET:" << QString::fromStdString(user_spec_device_->display_name(*this));
-			} else {
-				qDebug() << "No devices found in targeted scan";
+		// Unsupported drivers were skipped by driver_scan() when it ran
+		// this scan, so that's what -d does, too
+		if (scan_drv && !driver_supported(scan_drv))
+			qWarning() << "Driver" << QString::fromStdString(user_name) <<
+				"doesn't support logic analyzers or oscilloscopes, not scanning it";
+
+		if (scan_drv && driver_supported(scan_drv)) {
+			shared_ptr<ScanJob> job = make_shared<ScanJob>();
+			job->driver = scan_drv;
+			job->user_spec = true;
+			job->timed_out = false;
+
+			/*
+			 * Convert generic string representation of options
+			 * to the driver specific data types.
+			 */
+			if (!user_opts.empty()) {
+				auto drv_opts = scan_drv->scan_options();
+				job->options = drive_scan_options(user_opts, drv_opts);
+				qDebug() << "Converted scan options, size:" << job->options.size();
 			}
+
+			qDebug() << "Queueing targeted scan for driver:" << QString::fromStdString(user_name);
+			scan_state_->queued.push_back(job);
 		} else {
 			qDebug() << "No scan driver found - cannot run targeted scan";
 		}
@@ -165,7 +196,56 @@ DeviceManager::DeviceManager(shared_ptr<Context> context,
 	} else {
 		qDebug() << "No driver string provided - no user spec device will be set";
 	}
-	progress->setValue(entry_num++);
+
+	/*
+	 * Scan for devices. No specific options apply here, this is
+	 * best effort auto detection.
+	 */
+	for (auto& entry : context->drivers()) {
+		if (!do_scan)
+			break;
+
+		// Skip drivers we won't scan anyway
+		if (!driver_supported(entry.second))
+			continue;
+
+		if (entry.first == user_name)
+			continue;
+
+		shared_ptr<ScanJob> job = make_shared<ScanJob>();
+		job->driver = entry.second;
+		job->user_spec = false;
+		job->timed_out = false;
+		scan_state_->queued.push_back(job);
+	}
+
+	if (scan_state_->queued.empty())
+		return;
+
+	scan_in_progress_ = true;
+
+	const unsigned int worker_count =
+		min<size_t>(ScanThreadCount, scan_state_->queued.size());
+	for (unsigned int i = 0; i < worker_count; i++)
+		start_scan_worker();
+
+	connect(&scan_watchdog_, SIGNAL(timeout()), this, SLOT(on_scan_watchdog()));
+	scan_watchdog_.start(ScanWatchdogInterval);
+}
+
+DeviceManager::~DeviceManager()
+{
+	unique_lock<mutex> lock(scan_state_->state_mutex);
+
+	scan_state_->owner = nullptr;
+	scan_state_->queued.clear();
+	scan_state_->scan_done.notify_all();
+
+	// Give scans in progress the chance to finish, but don't wait forever
+	// for drivers that hang. A worker that's still stuck keeps the context
+	// alive until it returns
+	scan_state_->workers_done.wait_for(lock, milliseconds(ScanTimeout),
+		[&] { return scan_state_->workers == 0; });
 }
 
 const shared_ptr<sigrok::Context>& DeviceManager::context() const
@@ -193,6 +273,11 @@ DeviceManager::user_spec_device() const
 	return user_spec_device_;
 }
 
+bool DeviceManager::scan_in_progress() const
+{
+	return scan_in_progress_;
+}
+
 /**
  * Convert generic options to data types that are specific to Driver::scan().
  *
@@ -267,6 +352,19 @@ DeviceManager::driver_scan(
 	if (!driver_supported(driver))
 		return driver_devices;
 
+	const string name = driver->name();
+
+	{
+		unique_lock<mutex> lock(scan_state_->state_mutex);
+		if (!scan_state_->scan_done.wait_for(lock, milliseconds(ScanTimeout),
+			[&] { return !scan_state_->scanning.count(name); })) {
+			qWarning() << QApplication::tr("Can't scan device driver '%1' while its background scan is stuck").
+				arg(QString::fromStdString(name));
+			return driver_devices;
+		}
+		scan_state_->scanning.insert(name);
+	}
+
 	// Remove any device instances from this driver from the device
 	// list. They will not be valid after the scan.
 	devices_.remove_if([&](shared_ptr<devices::HardwareDevice> device) {
@@ -274,29 +372,194 @@ DeviceManager::driver_scan(
 
 	try {
 		// Do the scan
-		auto devices = driver->scan(drvopts);
+		driver_devices = add_driver_devices(driver->scan(drvopts));
+	} catch (const sigrok::Error &e) {
+		qWarning() << QApplication::tr("Error when scanning device driver '%1': %2").
+			arg(QString::fromStdString(name), e.what());
+	}
 
-		// Add the scanned devices to the main list, set display names and sort.
-		for (shared_ptr<sigrok::HardwareDevice>& device : devices) {
-			const shared_ptr<devices::HardwareDevice> d(
-				new devices::HardwareDevice(context_, device));
-			driver_devices.push_back(d);
-		}
+	{
+		lock_guard<mutex> lock(scan_state_->state_mutex);
+		scan_state_->scanning.erase(name);
+	}
+	scan_state_->scan_done.notify_all();
 
-		devices_.insert(devices_.end(), driver_devices.begin(),
-			driver_devices.end());
-		devices_.sort(bind(&DeviceManager::compare_devices, this, _1, _2));
-		driver_devices.sort(bind(
-			&DeviceManager::compare_devices, this, _1, _2));
+	devices_changed();
 
-	} catch (const sigrok::Error &e) {
-		qWarning() << QApplication::tr("Error when scanning device driver '%1': %2").
-			arg(QString::fromStdString(driver->name()), e.what());
+	return driver_devices;
+}
+
+list< shared_ptr<devices::HardwareDevice> >
+DeviceManager::add_driver_devices(
+	const vector< shared_ptr<sigrok::HardwareDevice> > &sr_devices)
+{
+	list< shared_ptr<devices::HardwareDevice> > driver_devices;
+
+	// Add the scanned devices to the main list, set display names and sort.
+	for (const shared_ptr<sigrok::HardwareDevice>& device : sr_devices) {
+		const shared_ptr<devices::HardwareDevice> d(
+			new devices::HardwareDevice(context_, device));
+		driver_devices.push_back(d);
 	}
 
+	devices_.insert(devices_.end(), driver_devices.begin(),
+		driver_devices.end());
+	devices_.sort(bind(&DeviceManager::compare_devices, this, _1, _2));
+	driver_devices.sort(bind(
+		&DeviceManager::compare_devices, this, _1, _2));
+
 	return driver_devices;
 }
 
+void DeviceManager::start_scan_worker()
+{
+	// The worker only shares the scan state with us. It's detached so that a
+	// driver hanging in its scan routine can't block anything but the scans
+	scan_state_->workers++;
+	thread(&DeviceManager::scan_worker, scan_state_).detach();
+}
+
+void DeviceManager::scan_worker(shared_ptr<ScanState> state)
+{
+	unique_lock<mutex> lock(state->state_mutex);
+
+	while (!state->queued.empty()) {
+		// Skip drivers that driver_scan() is busy with. Their jobs stay
+		// queued meanwhile so the scan isn't reported finished
+		const auto it = find_if(state->queued.begin(), state->queued.end(),
+			[&](const shared_ptr<ScanJob>& j) {
+				return !state->scanning.count(j->driver->name()); });
+		if (it == state->queued.end()) {
+			state->scan_done.wait(lock);
+			continue;
+		}
+
+		shared_ptr<ScanJob> job = *it;
+		const string name = job->driver->name();
+		state->queued.erase(it);
+		state->scanning.insert(name);
+
+		job->started = steady_clock::now();
+		state->running.push_back(job);
+
+		lock.unlock();
+
+		try {
+			job->devices = job->driver->scan(job->options);
+		} catch (const sigrok::Error &e) {
+			job->error = e.what();
+		}
+
+		lock.lock();
+
+		state->scanning.erase(name);
+		state->scan_done.notify_all();
+
+		state->running.erase(find(state->running.begin(), state->running.end(), job));
+		state->done.push_back(job);
+
+		if (state->owner)
+			QMetaObject::invokeMethod(state->owner, "on_scan_results",
+				Qt::QueuedConnection);
+	}
+
+	state->workers--;
+	state->workers_done.notify_all();
+}
+
+void DeviceManager::on_scan_results()
+{
+	deque< shared_ptr<ScanJob> > done;
+
+	{
+		lock_guard<mutex> lock(scan_state_->state_mutex);
+		done.swap(scan_state_->done);
+	}
+
+	for (const shared_ptr<ScanJob>& job : done) {
+		const QString driver_name = QString::fromStdString(job->driver->name());
+
+		if (!job->error.empty()) {
+			qWarning() << QApplication::tr("Error when scanning device driver '%1': %2").
+				arg(driver_name, QString::fromStdString(job->error));
+			continue;
+		}
+
+		if (job->timed_out)
+			qDebug() << "Driver" << driver_name << "finished scanning after timing out";
+
+		// Device instances found by an earlier scan of this driver aren't
+		// valid anymore
+		devices_.remove_if([&](shared_ptr<devices::HardwareDevice> device) {
+			return device->hardware_device()->driver() == job->driver; });
+
+		const list< shared_ptr<devices::HardwareDevice> > found =
+			add_driver_devices(job->devices);
+
+		if (job->user_spec) {
+			qDebug() << "Targeted scan found" << found.size() << "devices";
+			if (!found.empty()) {
+				user_spec_device_ = found.front();
+				qDebug() << "USER SPEC DEVICE SET:" <<
+					QString::fromStdString(user_spec_device_->display_name(*this));
+			}
+		}
+	}
+
+	if (!done.empty())
+		devices_changed();
+
+	check_scan_finished();
+}
+
+void DeviceManager::on_scan_watchdog()
+{
+	{
+		lock_guard<mutex> lock(scan_state_->state_mutex);
+
+		const steady_clock::time_point now = steady_clock::now();
+
+		for (const shared_ptr<ScanJob>& job : scan_state_->running) {
+			if (job->timed_out || ((now - job->started) < milliseconds(ScanTimeout)))
+				continue;
+
+			job->timed_out = true;
+			qWarning() << "Scanning driver" << QString::fromStdString(job->driver->name()) <<
+				"timed out, continuing without it";
+
+			// The worker stuck in the driver is replaced so the remaining
+			// drivers still get scanned
+			if (!scan_state_->queued.empty())
+				start_scan_worker();
+		}
+	}
+
+	check_scan_finished();
+}
+
+void DeviceManager::check_scan_finished()
+{
+	if (!scan_in_progress_)
+		return;
+
+	{
+		lock_guard<mutex> lock(scan_state_->state_mutex);
+
+		if (!scan_state_->queued.empty() || !scan_state_->done.empty())
+			return;
+
+		for (const shared_ptr<ScanJob>& job : scan_state_->running)
+			if (!job->timed_out)
+				return;
+	}
+
+	scan_in_progress_ = false;
+	scan_watchdog_.stop();
+
+	qDebug() << "Device scan finished," << devices_.size() << "devices found";
+	scan_finished();
+}
+
 const map<string, string> DeviceManager::get_device_info(
 	shared_ptr<devices::Device> device)
 {
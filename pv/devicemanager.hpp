@@ -27,6 +27,9 @@
 #include <string>
 #include <vector>
 
+#include <QObject>
+#include <QTimer>
+
 using std::list;
 using std::map;
 using std::set;
@@ -42,6 +45,7 @@ namespace sigrok {
 class ConfigKey;
 class Context;
 class Driver;
+class HardwareDevice;
 }
 
 using sigrok::ConfigKey;
@@ -55,13 +59,33 @@ class HardwareDevice;
 
 class Session;
 
-class DeviceManager
+/**
+ * Keeps the list of hardware devices. The initial scan of all drivers runs
+ * in the background on a pool of worker threads: devices_changed() is
+ * emitted whenever results arrive and scan_finished() once every driver
+ * reported back or timed out.
+ *
+ * Different drivers scan concurrently, but a driver is never scanned twice
+ * at the same time: driver_scan() waits for the background scan of the same
+ * driver to finish.
+ */
+class DeviceManager : public QObject
 {
+	Q_OBJECT
+
+private:
+	struct ScanJob;
+	struct ScanState;
+
+	static const unsigned int ScanThreadCount;
+	static const int ScanTimeout;
+	static const int ScanWatchdogInterval;
+
 public:
 	DeviceManager(shared_ptr<sigrok::Context> context,
 		std::string driver, bool do_scan);
 
-	~DeviceManager() = default;
+	~DeviceManager();
 
 	const shared_ptr<sigrok::Context>& context() const;
 
@@ -70,8 +94,19 @@ public:
 	const list< shared_ptr<devices::HardwareDevice> >& devices() const;
 	shared_ptr<devices::HardwareDevice> user_spec_device() const;
 
+	/**
+	 * Returns true while the background scan started by the constructor
+	 * still waits for drivers that neither finished nor timed out.
+	 */
+	bool scan_in_progress() const;
+
 	bool driver_supported(shared_ptr<sigrok::Driver> driver) const;
 
+	/**
+	 * Scans for the devices of the given driver. If the background scan
+	 * of the same driver doesn't finish within ScanTimeout, nothing is
+	 * scanned and an empty list is returned.
+	 */
 	list< shared_ptr<devices::HardwareDevice> > driver_scan(
 		shared_ptr<sigrok::Driver> driver,
 		map<const sigrok::ConfigKey *, Glib::VariantBase> drvopts);
@@ -82,10 +117,27 @@ public:
 	const shared_ptr<devices::HardwareDevice> find_device_from_info(
 		const map<string, string> search_info);
 
+Q_SIGNALS:
+	void devices_changed();
+	void scan_finished();
+
+private Q_SLOTS:
+	void on_scan_results();
+	void on_scan_watchdog();
+
 private:
 	bool compare_devices(shared_ptr<devices::Device> a,
 		shared_ptr<devices::Device> b);
 
+	list< shared_ptr<devices::HardwareDevice> > add_driver_devices(
+		const vector< shared_ptr<sigrok::HardwareDevice> > &sr_devices);
+
+	void start_scan_worker();
+
+	void check_scan_finished();
+
+	static void scan_worker(shared_ptr<ScanState> state);
+
 	static map<const ConfigKey *, Glib::VariantBase>
 	drive_scan_options(vector<string> user_spec,
 		set<const ConfigKey *> driver_opts);
@@ -94,6 +146,10 @@ protected:
 	shared_ptr<sigrok::Context> context_;
 	list< shared_ptr<devices::HardwareDevice> > devices_;
 	shared_ptr<devices::HardwareDevice> user_spec_device_;
+
+	shared_ptr<ScanState> scan_state_;
+	QTimer scan_watchdog_;
+	bool scan_in_progress_;
 };
 
 } // namespace pv
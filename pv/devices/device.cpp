@@ -95,6 +95,12 @@ T Device::read_config(const ConfigKey *key, const T default_value)
 	return default_value;
 }
 
+void Device::add_datafeed_callback(DatafeedCallback callback)
+{
+	assert(session_);
+	session_->add_datafeed_callback(callback);
+}
+
 void Device::start()
 {
 	assert(session_);
@@ -20,15 +20,18 @@
 #ifndef PULSEVIEW_PV_DEVICES_DEVICE_HPP
 #define PULSEVIEW_PV_DEVICES_DEVICE_HPP
 
+#include <functional>
 #include <memory>
 #include <string>
 
+using std::function;
 using std::shared_ptr;
 using std::string;
 
 namespace sigrok {
 class ConfigKey;
 class Device;
+class Packet;
 class Session;
 } // namespace sigrok
 
@@ -38,6 +41,9 @@ class DeviceManager;
 
 namespace devices {
 
+typedef function<void (shared_ptr<sigrok::Device>, shared_ptr<sigrok::Packet>)>
+	DatafeedCallback;
+
 class Device
 {
 protected:
@@ -68,6 +74,12 @@ public:
 
 	virtual void open() = 0;
 
+	/**
+	 * Registers a function that receives the packets produced by this
+	 * device. By default, this is the data feed of the libsigrok session.
+	 */
+	virtual void add_datafeed_callback(DatafeedCallback callback);
+
 	virtual void close() = 0;
 
 	virtual void start();
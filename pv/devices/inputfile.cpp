@@ -18,9 +18,22 @@
  */
 
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <future>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/mman.h>
+#endif
+
 #include <QDebug>
 #include <QString>
 
@@ -30,7 +43,11 @@
 
 using sigrok::InputFormat;
 
+using std::async;
+using std::future;
+using std::launch;
 using std::map;
+using std::min;
 using std::out_of_range;
 using std::pair;
 using std::shared_ptr;
@@ -39,6 +56,8 @@ using std::string;
 using std::ifstream;
 using std::ios;
 using std::vector;
+using std::chrono::duration;
+using std::chrono::milliseconds;
 
 namespace pv {
 namespace devices {
@@ -48,6 +67,13 @@ namespace devices {
 // UI lag and a visually "stuttering" display of the data currently loading.
 const streamsize InputFile::BufferSize = (4 * 1024 * 1024);
 
+// When streaming from a pipe, pass on whatever arrived after this many ms
+// even if the buffer isn't full yet so that slow producers show up live.
+const int InputFile::StreamFlushInterval = 100;
+
+// Minimum time in ms between two import progress reports
+const int InputFile::ProgressInterval = 1000;
+
 InputFile::InputFile(const shared_ptr<sigrok::Context> &context,
 	const string &file_name,
 	shared_ptr<sigrok::InputFormat> format,
@@ -56,6 +82,14 @@ InputFile::InputFile(const shared_ptr<sigrok::Context> &context,
 	context_(context),
 	format_(format),
 	options_(options),
+	f(nullptr),
+	mapped_data_(nullptr),
+	mapped_size_(0),
+	bytes_total_(0),
+	bytes_sent_(0),
+	streaming_(is_stream(file_name)),
+	stream_fd_(-1),
+	stream_eof_(false),
 	interrupt_(false)
 {
 }
@@ -64,9 +98,18 @@ InputFile::InputFile(const shared_ptr<sigrok::Context> &context,
 	QSettings &settings):
 	File(""),
 	context_(context),
+	f(nullptr),
+	mapped_data_(nullptr),
+	mapped_size_(0),
+	bytes_total_(0),
+	bytes_sent_(0),
+	streaming_(false),
+	stream_fd_(-1),
+	stream_eof_(false),
 	interrupt_(false)
 {
 	file_name_ = settings.value("filename").toString().toStdString();
+	streaming_ = is_stream(file_name_);
 
 	QString format_name = settings.value("format").toString();
 
@@ -92,6 +135,40 @@ InputFile::InputFile(const shared_ptr<sigrok::Context> &context,
 	}
 }
 
+InputFile::~InputFile()
+{
+	unmap_file();
+	delete f;
+	close_stream();
+}
+
+bool InputFile::is_stream(const string &file_name)
+{
+#ifdef _WIN32
+	(void)file_name;
+	return false;
+#else
+	if (file_name == "-")
+		return true;
+
+	struct stat st;
+	if (stat(file_name.c_str(), &st) < 0)
+		return false;
+
+	return S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode) || S_ISSOCK(st.st_mode);
+#endif
+}
+
+bool InputFile::streaming() const
+{
+	return streaming_;
+}
+
+void InputFile::set_progress_callback(ImportProgressCallback callback)
+{
+	progress_callback_ = callback;
+}
+
 void InputFile::save_meta_to_settings(QSettings &settings)
 {
 	settings.setValue("filename", QString::fromStdString(file_name_));
@@ -127,17 +204,54 @@ void InputFile::open()
 
 	// open() should add the input device to the session but
 	// we can't open the device without sending some data first
-	f = new ifstream(file_name_, ios::binary);
-
 	vector<char> buffer(BufferSize);
+	char *data = buffer.data();
+	streamsize size;
 
-	f->read(buffer.data(), BufferSize);
-	const streamsize size = f->gcount();
+	interrupt_ = false;
+	bytes_sent_ = 0;
+	import_start_ = last_progress_report_ = steady_clock::now();
+
+	if (streaming_) {
+		if (stream_fd_ < 0)
+			stream_fd_ = (file_name_ == "-") ? STDIN_FILENO :
+				::open(file_name_.c_str(), O_RDONLY);
+
+		if (stream_fd_ < 0)
+			throw QString("Failed to open stream");
+
+		size = read_stream(buffer.data(), BufferSize);
+	} else {
+		open_source();
+
+		if (mapped_data_) {
+			data = mapped_data_;
+			size = min<uint64_t>(BufferSize, mapped_size_);
+		} else {
+			f->read(buffer.data(), BufferSize);
+			size = f->gcount();
+		}
+	}
 
 	if (size == 0)
 		throw QString("Failed to read file");
 
-	input_->send(buffer.data(), size);
+	input_->send(data, size);
+	bytes_sent_ += size;
+
+	// The first block read from a stream may be too short for the input
+	// module to set up its device, so keep feeding it until it can
+	while (streaming_ && !stream_eof_ && !interrupt_) {
+		try {
+			device_ = input_->device();
+			break;
+		} catch (sigrok::Error&) {
+			size = read_stream(buffer.data(), BufferSize);
+			if (size > 0)
+				input_->send(buffer.data(), size);
+			bytes_sent_ += size;
+		}
+	}
 
 	try {
 		device_ = input_->device();
@@ -163,36 +277,292 @@ void InputFile::run()
 	if (!input_)
 		return;
 
-	if (!f) {
+	interrupt_ = false;
+
+	if (streaming_) {
+		run_stream();
+		return;
+	}
+
+	if (!mapped_data_ && !f) {
 		// Previous call to run() processed the entire file already
-		f = new ifstream(file_name_, ios::binary);
+		open_source();
 		input_->reset();
+		bytes_sent_ = 0;
+		import_start_ = last_progress_report_ = steady_clock::now();
+	}
+
+	if (mapped_data_)
+		run_mapped();
+	else
+		run_buffered();
+
+	input_->end();
+	report_progress(true);
+
+	unmap_file();
+	delete f;
+	f = nullptr;
+}
+
+void InputFile::stop()
+{
+	interrupt_ = true;
+}
+
+void InputFile::open_source()
+{
+	unmap_file();
+	delete f;
+	f = nullptr;
+
+	struct stat st;
+	bytes_total_ = (stat(file_name_.c_str(), &st) == 0) ? st.st_size : 0;
+
+	if (!map_file())
+		f = new ifstream(file_name_, ios::binary);
+}
+
+bool InputFile::map_file()
+{
+#ifndef _WIN32
+	const int fd = ::open(file_name_.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if ((fstat(fd, &st) < 0) || !S_ISREG(st.st_mode) || (st.st_size == 0) ||
+		((uint64_t)st.st_size > SIZE_MAX)) {
+		::close(fd);
+		return false;
+	}
+
+	void *const addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);  // The mapping keeps the file open
+
+	// Mapping fails e.g. when a 32 bit system runs out of address space,
+	// in which case we fall back to reading the file
+	if (addr == MAP_FAILED)
+		return false;
+
+	madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+	mapped_data_ = (char*)addr;
+	mapped_size_ = st.st_size;
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void InputFile::unmap_file()
+{
+#ifndef _WIN32
+	if (mapped_data_)
+		munmap(mapped_data_, mapped_size_);
+#endif
+
+	mapped_data_ = nullptr;
+	mapped_size_ = 0;
+}
+
+void InputFile::run_stream()
+{
+	if (stream_fd_ < 0) {
+		qWarning() << "Stream" << QString::fromStdString(file_name_) <<
+			"was consumed by a previous run and can't be read again";
+		return;
 	}
 
 	vector<char> buffer(BufferSize);
 
-	interrupt_ = false;
-	while (!interrupt_ && !f->eof()) {
-		f->read(buffer.data(), BufferSize);
-		const streamsize size = f->gcount();
+	// Data is only read from the stream after the previous block was
+	// processed, so if we fall behind the pipe fills up and blocks the
+	// producer instead of us buffering an unbounded amount of data
+	while (!interrupt_ && !stream_eof_) {
+		const streamsize size = read_stream(buffer.data(), BufferSize);
+		if (size > 0)
+			input_->send(buffer.data(), size);
+
+		bytes_sent_ += size;
+		report_progress(false);
+	}
+
+	input_->end();
+	report_progress(true);
+
+	close_stream();
+}
+
+void InputFile::run_mapped()
+{
+#ifndef _WIN32
+	// open() already sent the first span, continue after it. As BufferSize
+	// is a multiple of the page size, all spans start on a page boundary
+	uint64_t offset = bytes_sent_;
+
+	while (!interrupt_ && (offset < mapped_size_)) {
+		const uint64_t length = min<uint64_t>(BufferSize, mapped_size_ - offset);
+		const uint64_t next = offset + length;
+
+		// Have the kernel fetch the next span while this one is parsed
+		if (next < mapped_size_)
+			madvise(mapped_data_ + next,
+				min<uint64_t>(BufferSize, mapped_size_ - next), MADV_WILLNEED);
+
+		input_->send(mapped_data_ + offset, length);
+
+		// The input module copies what it needs, so the parsed span can be
+		// dropped to keep the resident set small for multi-GB files
+		madvise(mapped_data_ + offset, length, MADV_DONTNEED);
+
+		offset = next;
+		bytes_sent_ = offset;
+		report_progress(false);
+	}
+#endif
+}
+
+void InputFile::run_buffered()
+{
+	vector<char> buffers[2] = {vector<char>(BufferSize), vector<char>(BufferSize)};
+	ifstream *const file = f;
+
+	const auto read_block = [file](char *buffer) -> streamsize {
+		file->read(buffer, BufferSize);
+		return file->gcount();
+	};
+
+	unsigned int current = 0;
+	future<streamsize> pending =
+		async(launch::async, read_block, buffers[current].data());
+
+	while (!interrupt_) {
+		const streamsize size = pending.get();
 		if (size == 0)
 			break;
 
-		input_->send(buffer.data(), size);
+		// Start reading the next block into the other buffer before
+		// parsing this one so that I/O latency and parsing overlap
+		const bool more = (size == BufferSize);
+		if (more)
+			pending = async(launch::async, read_block, buffers[current ^ 1].data());
 
-		if (size != BufferSize)
+		input_->send(buffers[current].data(), size);
+		bytes_sent_ += size;
+		report_progress(false);
+
+		if (!more)
 			break;
+
+		current ^= 1;
 	}
 
-	input_->end();
+	// When interrupted, the destructor of pending waits for the read in
+	// flight to finish before the buffers go out of scope
+}
 
-	delete f;
-	f = nullptr;
+void InputFile::report_progress(bool finished)
+{
+	const steady_clock::time_point now = steady_clock::now();
+
+	if (!finished && ((now - last_progress_report_) < milliseconds(ProgressInterval)))
+		return;
+
+	last_progress_report_ = now;
+
+	const double MiB = 1024 * 1024;
+	const double elapsed = duration<double>(now - import_start_).count();
+	const double rate = (elapsed > 0) ? (bytes_sent_ / MiB / elapsed) : 0;
+
+	QString progress = QString("%1 MiB").arg(bytes_sent_ / MiB, 0, 'f', 1);
+	if (bytes_total_ > 0)
+		progress += QString(" of %1 MiB (%2%)").arg(bytes_total_ / MiB, 0, 'f', 1)
+			.arg(100.0 * bytes_sent_ / bytes_total_, 0, 'f', 0);
+
+	qDebug() << (finished ? "Imported" : "Importing") <<
+		qPrintable(QString::fromStdString(file_name_)) << ":" <<
+		qPrintable(progress) << "at" << qPrintable(QString::number(rate, 'f', 1)) <<
+		"MiB/s";
+
+	if (progress_callback_)
+		progress_callback_(bytes_sent_, bytes_total_);
 }
 
-void InputFile::stop()
+streamsize InputFile::read_stream(char *buffer, streamsize size)
 {
-	interrupt_ = true;
+	streamsize filled = 0;
+
+#ifndef _WIN32
+	using std::chrono::milliseconds;
+	using std::chrono::steady_clock;
+
+	steady_clock::time_point deadline;
+
+	while (!interrupt_ && !stream_eof_ && (filled < size)) {
+		// Wake up regularly to check for interruption. Once data arrived,
+		// wait no longer than until its flush deadline
+		int timeout = StreamFlushInterval;
+		if (filled > 0) {
+			const auto remaining = std::chrono::duration_cast<milliseconds>(
+				deadline - steady_clock::now()).count();
+			if (remaining <= 0)
+				break;
+			timeout = (int)remaining;
+		}
+
+		struct pollfd pfd;
+		pfd.fd = stream_fd_;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		const int ready = poll(&pfd, 1, timeout);
+		if (ready == 0)
+			continue;
+
+		if (ready < 0) {
+			if (errno == EINTR)
+				continue;
+			qWarning() << "Failed to poll input stream:" << strerror(errno);
+			stream_eof_ = true;
+			break;
+		}
+
+		const ssize_t count = ::read(stream_fd_, buffer + filled, size - filled);
+		if (count < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			qWarning() << "Failed to read input stream:" << strerror(errno);
+			stream_eof_ = true;
+			break;
+		}
+
+		if (count == 0) {
+			stream_eof_ = true;
+			break;
+		}
+
+		if (filled == 0)
+			deadline = steady_clock::now() + milliseconds(StreamFlushInterval);
+
+		filled += count;
+	}
+#else
+	(void)buffer;
+	(void)size;
+	stream_eof_ = true;
+#endif
+
+	return filled;
+}
+
+void InputFile::close_stream()
+{
+	if ((stream_fd_ >= 0) && (stream_fd_ != STDIN_FILENO))
+		::close(stream_fd_);
+
+	stream_fd_ = -1;
 }
 
 } // namespace devices
@@ -21,6 +21,8 @@
 #define PULSEVIEW_PV_DEVICES_INPUTFILE_HPP
 
 #include <atomic>
+#include <chrono>
+#include <functional>
 
 #include <libsigrokcxx/libsigrokcxx.hpp>
 
@@ -29,19 +31,26 @@
 #include <QSettings>
 
 using std::atomic;
+using std::function;
 using std::ifstream;
 using std::map;
 using std::shared_ptr;
 using std::streamsize;
 using std::string;
+using std::chrono::steady_clock;
 
 namespace pv {
 namespace devices {
 
+/// Receives the number of bytes imported so far and the file size, 0 for streams
+typedef function<void (uint64_t bytes_read, uint64_t bytes_total)> ImportProgressCallback;
+
 class InputFile final : public File
 {
 private:
 	static const streamsize BufferSize;
+	static const int StreamFlushInterval;
+	static const int ProgressInterval;
 
 public:
 	InputFile(const shared_ptr<sigrok::Context> &context,
@@ -56,8 +65,25 @@ public:
 	InputFile(const shared_ptr<sigrok::Context> &context,
 		QSettings &settings);
 
+	~InputFile();
+
+	/**
+	 * Returns true if the given file name refers to standard input ("-") or
+	 * to a pipe, FIFO or similar source that can only be read once and whose
+	 * end isn't known in advance.
+	 */
+	static bool is_stream(const string &file_name);
+
 	void save_meta_to_settings(QSettings &settings);
 
+	bool streaming() const;
+
+	/**
+	 * Registers a function that is called from the acquisition thread every
+	 * ProgressInterval ms while importing and once when the import is done.
+	 */
+	void set_progress_callback(ImportProgressCallback callback);
+
 	void open();
 
 	void close();
@@ -68,6 +94,42 @@ public:
 
 	void stop();
 
+private:
+	/**
+	 * Prepares reading the file from the start, either by mapping it into
+	 * memory or, if that isn't possible, by opening it as a regular stream.
+	 */
+	void open_source();
+
+	bool map_file();
+
+	void unmap_file();
+
+	void run_stream();
+
+	/**
+	 * Hands the mapped file to the input module in page-aligned spans of
+	 * BufferSize bytes, asking the kernel to prefetch the next span.
+	 */
+	void run_mapped();
+
+	/**
+	 * Reads the file in a helper thread into one of two buffers while the
+	 * input module parses the other one.
+	 */
+	void run_buffered();
+
+	void report_progress(bool finished);
+
+	/**
+	 * Reads from the stream until the buffer is full, the stream ended or
+	 * StreamFlushInterval passed since the first byte of this block arrived.
+	 * @return The number of bytes read. Sets stream_eof_ at the end of the stream.
+	 */
+	streamsize read_stream(char *buffer, streamsize size);
+
+	void close_stream();
+
 private:
 	const shared_ptr<sigrok::Context> context_;
 	shared_ptr<sigrok::InputFormat> format_;
@@ -75,6 +137,16 @@ private:
 	shared_ptr<sigrok::Input> input_;
 
 	ifstream *f;
+	char *mapped_data_;
+	uint64_t mapped_size_;
+
+	uint64_t bytes_total_, bytes_sent_;
+	steady_clock::time_point import_start_, last_progress_report_;
+	ImportProgressCallback progress_callback_;
+
+	bool streaming_;
+	int stream_fd_;
+	bool stream_eof_;
 	atomic<bool> interrupt_;
 };
 
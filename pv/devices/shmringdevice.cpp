@@ -0,0 +1,267 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include <chrono>
+#include <map>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <QDebug>
+#include <QString>
+
+#include <libsigrokcxx/libsigrokcxx.hpp>
+
+#include "shmringdevice.hpp"
+
+using std::map;
+using std::memory_order_acquire;
+using std::memory_order_relaxed;
+using std::memory_order_release;
+using std::min;
+using std::shared_ptr;
+using std::string;
+using std::to_string;
+using std::vector;
+
+using sigrok::ChannelType;
+using sigrok::ConfigKey;
+using sigrok::Quantity;
+using sigrok::QuantityFlag;
+using sigrok::Unit;
+
+namespace pv {
+namespace devices {
+
+// How long to sleep when the ring is empty. Short enough to keep up with
+// producers delivering hundreds of MB/s in blocks of a few MB.
+const unsigned int ShmRingDevice::PollIntervalUs = 200;
+
+ShmRingDevice::ShmRingDevice(const shared_ptr<sigrok::Context> &context,
+	const string &ring_name) :
+	context_(context),
+	ring_name_(ring_name),
+	header_(nullptr),
+	mapped_size_(0),
+	interrupt_(false)
+{
+}
+
+ShmRingDevice::~ShmRingDevice()
+{
+	close();
+}
+
+string ShmRingDevice::full_name() const
+{
+	return "Shared memory ring " + ring_name_;
+}
+
+string ShmRingDevice::display_name(const DeviceManager&) const
+{
+	return ring_name_;
+}
+
+void ShmRingDevice::open()
+{
+	if (header_)
+		close();
+
+	const int fd = shm_open(ring_name_.c_str(), O_RDWR, 0);
+	if (fd < 0)
+		throw QString("Failed to open shared memory object %1")
+			.arg(QString::fromStdString(ring_name_));
+
+	struct stat st;
+	if ((fstat(fd, &st) < 0) || ((uint64_t)st.st_size < sizeof(ShmRingHeader))) {
+		::close(fd);
+		throw QString("Shared memory object is too small to hold a ring header");
+	}
+
+	// Look at the header first so that only the size it describes is mapped
+	void *const header_addr = mmap(nullptr, sizeof(ShmRingHeader), PROT_READ,
+		MAP_SHARED, fd, 0);
+	if (header_addr == MAP_FAILED) {
+		::close(fd);
+		throw QString("Failed to map shared memory object");
+	}
+
+	try {
+		check_header((const ShmRingHeader*)header_addr, st.st_size);
+	} catch (const QString&) {
+		munmap(header_addr, sizeof(ShmRingHeader));
+		::close(fd);
+		throw;
+	}
+
+	const uint64_t size = shm_ring_total_size((const ShmRingHeader*)header_addr);
+	munmap(header_addr, sizeof(ShmRingHeader));
+
+	void *const addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	::close(fd);  // The mapping keeps the object alive
+
+	if (addr == MAP_FAILED)
+		throw QString("Failed to map shared memory object");
+
+	header_ = (ShmRingHeader*)addr;
+	mapped_size_ = size;
+
+	// The producer may have changed the header in the meantime
+	try {
+		check_header(header_, mapped_size_);
+	} catch (const QString&) {
+		unmap_ring();
+		throw;
+	}
+
+	// Describe the channel layout using a libsigrok user device so that
+	// the session can create its signals the same way as for any device
+	user_device_ = context_->create_user_device("Shared memory", "ring", "");
+
+	unsigned int index = 0;
+	for (uint32_t i = 0; i < header_->logic_channels; i++)
+		user_device_->add_channel(index++, ChannelType::LOGIC, "D" + to_string(i));
+
+	for (uint32_t i = 0; i < header_->analog_channels; i++)
+		user_device_->add_channel(index++, ChannelType::ANALOG, "A" + to_string(i));
+
+	analog_channels_.clear();
+	for (const shared_ptr<sigrok::Channel>& ch : user_device_->channels())
+		if (ch->type() == ChannelType::ANALOG)
+			analog_channels_.push_back(ch);
+
+	device_ = user_device_;
+
+	// The session is only used for trigger queries, the data feed bypasses it
+	if (!session_)
+		session_ = context_->create_session();
+}
+
+void ShmRingDevice::close()
+{
+	unmap_ring();
+
+	// Same as the libsigrok session of the other devices, whose callbacks
+	// go away with it. The owner adds them again after opening the device
+	callbacks_.clear();
+}
+
+void ShmRingDevice::add_datafeed_callback(DatafeedCallback callback)
+{
+	callbacks_.push_back(callback);
+}
+
+void ShmRingDevice::start()
+{
+}
+
+void ShmRingDevice::run()
+{
+	if (!header_)
+		return;
+
+	interrupt_ = false;
+
+	// Announce the sample rate before sending any sample data
+	map<const ConfigKey*, Glib::VariantBase> meta;
+	meta[ConfigKey::SAMPLERATE] =
+		Glib::Variant<guint64>::create(header_->samplerate);
+	send_packet(context_->create_meta_packet(meta));
+
+	const uint64_t unit_size = header_->logic_unit_size;
+	const uint64_t analog_unit_size = sizeof(float) * analog_channels_.size();
+
+	while (!interrupt_) {
+		ShmRingBlock *const block = shm_ring_read_slot(header_);
+
+		if (!block) {
+			// The producer sets producer_done after publishing its last
+			// block, so the ring must be checked once more
+			if (header_->producer_done.load(memory_order_acquire) &&
+				!shm_ring_read_slot(header_))
+				break;
+
+			std::this_thread::sleep_for(std::chrono::microseconds(PollIntervalUs));
+			continue;
+		}
+
+		uint8_t *const payload = (uint8_t*)block + sizeof(ShmRingBlock);
+		const uint64_t length = min(block->length, header_->block_size);
+
+		// The packets reference the ring memory directly. This is safe as
+		// the data feed consumes them synchronously before we release the
+		// slot. It copies the samples into its segments, which is the one
+		// copy left on the way from the producer
+		if ((block->type == ShmRingBlockLogic) && (unit_size > 0)) {
+			const uint64_t usable = length - (length % unit_size);
+			if (usable > 0)
+				send_packet(context_->create_logic_packet(payload, usable, unit_size));
+		} else if ((block->type == ShmRingBlockAnalog) && (analog_unit_size > 0)) {
+			const unsigned int num_samples = length / analog_unit_size;
+			if (num_samples > 0)
+				send_packet(context_->create_analog_packet(analog_channels_,
+					(const float*)payload, num_samples, Quantity::VOLTAGE,
+					Unit::VOLT, vector<const QuantityFlag*>()));
+		} else
+			qWarning() << "Ignoring shared memory ring block of type" << block->type;
+
+		shm_ring_release_slot(header_);
+	}
+
+	send_packet(context_->create_end_packet());
+}
+
+void ShmRingDevice::stop()
+{
+	interrupt_ = true;
+}
+
+void ShmRingDevice::send_packet(shared_ptr<sigrok::Packet> packet)
+{
+	for (DatafeedCallback& callback : callbacks_)
+		callback(device_, packet);
+}
+
+void ShmRingDevice::check_header(const ShmRingHeader *header, uint64_t size)
+{
+	if ((header->magic != ShmRingMagic) || (header->version != ShmRingVersion))
+		throw QString("Shared memory object does not contain a known ring format");
+
+	if (!shm_ring_layout_valid(header, size))
+		throw QString("Shared memory ring header describes an invalid layout");
+
+	if ((header->logic_channels > 0) &&
+		(header->logic_unit_size < (header->logic_channels + 7) / 8))
+		throw QString("Logic unit size too small for the number of logic channels");
+}
+
+void ShmRingDevice::unmap_ring()
+{
+	if (header_)
+		munmap((void*)header_, mapped_size_);
+
+	header_ = nullptr;
+	mapped_size_ = 0;
+}
+
+} // namespace devices
+} // namespace pv
@@ -0,0 +1,108 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_DEVICES_SHMRINGDEVICE_HPP
+#define PULSEVIEW_PV_DEVICES_SHMRINGDEVICE_HPP
+
+#include <atomic>
+#include <vector>
+
+#include "device.hpp"
+#include "shmringlayout.hpp"
+
+using std::atomic;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace sigrok {
+class Channel;
+class Context;
+class UserDevice;
+} // sigrok
+
+namespace pv {
+namespace devices {
+
+/**
+ * A device that attaches to a POSIX shared-memory ring filled by a local
+ * producer process (see shmringlayout.hpp for the layout). Packets are
+ * created on top of the ring slots and handed to the data feed directly,
+ * bypassing the libsigrok session. The data feed still copies the samples
+ * into its segments, as the slots are reused by the producer. Analog
+ * samples are copied once more as the data feed converts them to floats
+ * before adding them.
+ */
+class ShmRingDevice final : public Device
+{
+private:
+	static const unsigned int PollIntervalUs;
+
+public:
+	ShmRingDevice(const shared_ptr<sigrok::Context> &context,
+		const string &ring_name);
+
+	~ShmRingDevice();
+
+	/**
+	 * Builds the full name. It only contains all the fields.
+	 */
+	string full_name() const;
+
+	/**
+	 * Builds the display name. It only contains fields as required.
+	 */
+	string display_name(const DeviceManager&) const;
+
+	void open();
+
+	void close();
+
+	void add_datafeed_callback(DatafeedCallback callback);
+
+	void start();
+
+	void run();
+
+	void stop();
+
+private:
+	void send_packet(shared_ptr<sigrok::Packet> packet);
+
+	/// Throws if the header doesn't describe a usable ring of @a size bytes
+	static void check_header(const ShmRingHeader *header, uint64_t size);
+
+	void unmap_ring();
+
+private:
+	const shared_ptr<sigrok::Context> context_;
+	const string ring_name_;
+
+	ShmRingHeader *header_;
+	uint64_t mapped_size_;
+
+	shared_ptr<sigrok::UserDevice> user_device_;
+	vector< shared_ptr<sigrok::Channel> > analog_channels_;
+	vector<DatafeedCallback> callbacks_;
+
+	atomic<bool> interrupt_;
+};
+
+} // namespace devices
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DEVICES_SHMRINGDEVICE_HPP
@@ -0,0 +1,154 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PULSEVIEW_PV_DEVICES_SHMRINGLAYOUT_HPP
+#define PULSEVIEW_PV_DEVICES_SHMRINGLAYOUT_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Memory layout of a POSIX shared-memory sample ring as written by an
+ * external producer process and consumed by devices::ShmRingDevice.
+ *
+ * The shared-memory object starts with a ShmRingHeader, followed by
+ * block_count slots of (sizeof(ShmRingBlock) + block_size) bytes each.
+ * The producer fills the slot at (write_index % block_count) and then
+ * increments write_index. The consumer processes the slot at
+ * (read_index % block_count) and then increments read_index. The producer
+ * must not overwrite a slot while (write_index - read_index) == block_count.
+ *
+ * This header deliberately has no dependencies besides the C++ standard
+ * library so that producers can include it directly.
+ */
+
+namespace pv {
+namespace devices {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+	"The shared-memory ring requires lock-free 64 bit atomics");
+
+static const uint32_t ShmRingMagic = 0x52535650;  // "PVSR"
+static const uint32_t ShmRingVersion = 1;
+
+enum ShmRingBlockType {
+	ShmRingBlockLogic = 1,  ///< Packed logic samples, logic_unit_size bytes each
+	ShmRingBlockAnalog = 2  ///< Interleaved float32 samples of all analog channels
+};
+
+struct ShmRingHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t samplerate;
+	uint32_t logic_channels;
+	uint32_t logic_unit_size;
+	uint32_t analog_channels;
+	uint32_t block_count;
+	uint64_t block_size;      ///< Maximum payload size of a single slot in bytes
+
+	std::atomic<uint64_t> write_index;
+	std::atomic<uint64_t> read_index;
+	std::atomic<uint32_t> producer_done;
+	uint32_t reserved;
+};
+
+struct ShmRingBlock
+{
+	uint32_t type;            ///< One of ShmRingBlockType
+	uint32_t reserved;
+	uint64_t length;          ///< Payload size in bytes, <= block_size
+	// Payload follows, padded so that the next slot stays 8-byte aligned
+};
+
+inline uint64_t shm_ring_slot_size(const ShmRingHeader *header)
+{
+	return sizeof(ShmRingBlock) + ((header->block_size + 7) & ~UINT64_C(7));
+}
+
+inline uint64_t shm_ring_total_size(const ShmRingHeader *header)
+{
+	return sizeof(ShmRingHeader) + header->block_count * shm_ring_slot_size(header);
+}
+
+inline ShmRingBlock* shm_ring_slot(ShmRingHeader *header, uint64_t index)
+{
+	uint8_t *const base = (uint8_t*)header + sizeof(ShmRingHeader);
+	return (ShmRingBlock*)(base + (index % header->block_count) *
+		shm_ring_slot_size(header));
+}
+
+/**
+ * Checks that the slots described by the header fit into a shared-memory
+ * object of @a object_size bytes. The sizes are checked one by one so that
+ * a corrupt header can't make shm_ring_total_size() overflow.
+ */
+inline bool shm_ring_layout_valid(const ShmRingHeader *header, uint64_t object_size)
+{
+	if ((header->block_count == 0) || (header->block_size == 0) ||
+		(object_size < sizeof(ShmRingHeader) + sizeof(ShmRingBlock) + 8))
+		return false;
+
+	const uint64_t slots_size = object_size - sizeof(ShmRingHeader);
+	if (header->block_size > slots_size - sizeof(ShmRingBlock) - 7)
+		return false;
+
+	return header->block_count <= slots_size / shm_ring_slot_size(header);
+}
+
+/**
+ * Returns the slot the consumer processes next, or nullptr if the producer
+ * hasn't filled it yet.
+ */
+inline ShmRingBlock* shm_ring_read_slot(ShmRingHeader *header)
+{
+	const uint64_t read_index = header->read_index.load(std::memory_order_relaxed);
+	if (read_index == header->write_index.load(std::memory_order_acquire))
+		return nullptr;
+	return shm_ring_slot(header, read_index);
+}
+
+/// Hands the slot returned by shm_ring_read_slot() back to the producer
+inline void shm_ring_release_slot(ShmRingHeader *header)
+{
+	header->read_index.store(header->read_index.load(std::memory_order_relaxed) + 1,
+		std::memory_order_release);
+}
+
+/**
+ * Returns the slot the producer fills next, or nullptr if the consumer
+ * hasn't released it yet.
+ */
+inline ShmRingBlock* shm_ring_write_slot(ShmRingHeader *header)
+{
+	const uint64_t write_index = header->write_index.load(std::memory_order_relaxed);
+	if (write_index - header->read_index.load(std::memory_order_acquire) >= header->block_count)
+		return nullptr;
+	return shm_ring_slot(header, write_index);
+}
+
+/// Makes the slot returned by shm_ring_write_slot() visible to the consumer
+inline void shm_ring_publish_slot(ShmRingHeader *header)
+{
+	header->write_index.store(header->write_index.load(std::memory_order_relaxed) + 1,
+		std::memory_order_release);
+}
+
+}  // namespace devices
+}  // namespace pv
+
+#endif // PULSEVIEW_PV_DEVICES_SHMRINGLAYOUT_HPP
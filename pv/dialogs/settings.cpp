@@ -426,6 +426,31 @@ QWidget *Settings::get_decoder_settings_form(QWidget *parent)
 		SLOT(on_dec_alwaysshowallrows_changed(int)));
 	decoder_layout->addRow(tr("Always show all &rows, even if no annotation is visible"), cb);
 
+	cb = create_checkbox(GlobalSettings::Key_Dec_SplitAtIdleGaps,
+		SLOT(on_dec_splitAtIdleGaps_changed(int)));
+	decoder_layout->addRow(tr("&Split long segments at idle gaps for faster decoding"), cb);
+
+#ifdef HAVE_SHM_OPEN
+	cb = create_checkbox(GlobalSettings::Key_Dec_UseProcesses,
+		SLOT(on_dec_useProcesses_changed(int)));
+	decoder_layout->addRow(tr("Run decoders in separate &processes to use more CPU cores"), cb);
+#endif
+
+	cb = create_checkbox(GlobalSettings::Key_Dec_CacheResults,
+		SLOT(on_dec_cacheResults_changed(int)));
+	decoder_layout->addRow(tr("&Keep decoder results on disk for reopened captures"), cb);
+
+	QSpinBox *max_annotations_sb = new QSpinBox();
+	max_annotations_sb->setRange(0, 1000);
+	max_annotations_sb->setSuffix(tr(" million"));
+	max_annotations_sb->setSpecialValueText(tr("Unlimited"));
+	max_annotations_sb->setValue(
+		settings.value(GlobalSettings::Key_Dec_MaxAnnotations).toInt());
+	connect(max_annotations_sb, SIGNAL(valueChanged(int)), this,
+		SLOT(on_dec_maxAnnotations_changed(int)));
+	decoder_layout->addRow(tr("Maximum number of annotations to keep, the oldest are discarded"),
+		max_annotations_sb);
+
 	// Annotation export settings
 	ann_export_format_ = new QLineEdit();
 	ann_export_format_->setText(
@@ -823,6 +848,30 @@ void Settings::on_dec_alwaysshowallrows_changed(int state)
 	GlobalSettings settings;
 	settings.setValue(GlobalSettings::Key_Dec_AlwaysShowAllRows, state ? true : false);
 }
+
+void Settings::on_dec_splitAtIdleGaps_changed(int state)
+{
+	GlobalSettings settings;
+	settings.setValue(GlobalSettings::Key_Dec_SplitAtIdleGaps, state ? true : false);
+}
+
+void Settings::on_dec_useProcesses_changed(int state)
+{
+	GlobalSettings settings;
+	settings.setValue(GlobalSettings::Key_Dec_UseProcesses, state ? true : false);
+}
+
+void Settings::on_dec_cacheResults_changed(int state)
+{
+	GlobalSettings settings;
+	settings.setValue(GlobalSettings::Key_Dec_CacheResults, state ? true : false);
+}
+
+void Settings::on_dec_maxAnnotations_changed(int value)
+{
+	GlobalSettings settings;
+	settings.setValue(GlobalSettings::Key_Dec_MaxAnnotations, value);
+}
 #endif
 
 void Settings::on_log_logLevel_changed(int value)
@@ -84,6 +84,10 @@ private Q_SLOTS:
 	void on_dec_initialStateConfigurable_changed(int state);
 	void on_dec_exportFormat_changed(const QString &text);
 	void on_dec_alwaysshowallrows_changed(int state);
+	void on_dec_splitAtIdleGaps_changed(int state);
+	void on_dec_useProcesses_changed(int state);
+	void on_dec_cacheResults_changed(int state);
+	void on_dec_maxAnnotations_changed(int value);
 #endif
 	void on_log_logLevel_changed(int value);
 	void on_log_bufferSize_changed(int value);
@@ -81,6 +81,10 @@ public:
 	static const QString Key_Dec_InitialStateConfigurable;
 	static const QString Key_Dec_ExportFormat;
 	static const QString Key_Dec_AlwaysShowAllRows;
+	static const QString Key_Dec_SplitAtIdleGaps;
+	static const QString Key_Dec_UseProcesses;
+	static const QString Key_Dec_CacheResults;
+	static const QString Key_Dec_MaxAnnotations;
 	static const QString Key_Log_BufferSize;
 	static const QString Key_Log_NotifyOfStacktrace;
 	
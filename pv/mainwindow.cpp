@@ -71,6 +71,7 @@ const QString MainWindow::WindowTitle = tr("JulseView");
 MainWindow::MainWindow(DeviceManager &device_manager, QWidget *parent) :
 	QMainWindow(parent),
 	device_manager_(device_manager),
+	default_session_device_rank_(0),
 	session_selector_(this),
 	icon_red_(":/icons/status-red.svg"),
 	icon_green_(":/icons/status-green.svg"),
@@ -80,6 +81,12 @@ MainWindow::MainWindow(DeviceManager &device_manager, QWidget *parent) :
 	restore_ui_settings();
 	connect(this, SIGNAL(session_error_raised(const QString, const QString)),
 		this, SLOT(on_session_error_raised(const QString, const QString)));
+
+	// Devices keep arriving from the background scan after we are shown
+	connect(&device_manager_, SIGNAL(devices_changed()),
+		this, SLOT(on_devices_changed()));
+	connect(&device_manager_, SIGNAL(scan_finished()),
+		this, SLOT(on_device_scan_finished()));
 }
 
 MainWindow::~MainWindow()
@@ -98,6 +105,11 @@ void MainWindow::show_session_error(const QString text, const QString info_text)
 	// TODO Emulate noquote()
 	qDebug() << "Notifying user of session error: " << text << "; " << info_text;
 
+	// Nobody could close the message box
+	const Application* app = qobject_cast<Application*>(qApp);
+	if (app && app->batch_mode())
+		return;
+
 	QMessageBox msg;
 	msg.setText(text + "\n\n" + info_text);
 	msg.setStandardButtons(QMessageBox::Ok);
@@ -416,6 +428,12 @@ void MainWindow::add_session_with_file(string open_file_name,
 	session->load_init_file(open_file_name, open_file_format, open_setup_file_name);
 }
 
+void MainWindow::add_session_with_shm_ring(string ring_name)
+{
+	shared_ptr<Session> session = add_session();
+	session->load_shm_ring(ring_name);
+}
+
 void MainWindow::add_default_session()
 {
 	qDebug() << "=== add_default_session() called ===";
@@ -428,22 +446,47 @@ void MainWindow::add_default_session()
 
 	shared_ptr<Session> session = add_session();
 
+	default_session_ = session;
+	default_session_device_.reset();
+	default_session_device_rank_ = 0;
+
+	select_default_session_device();
+
+	if (!device_manager_.scan_in_progress())
+		default_session_.reset();
+}
+
+void MainWindow::select_default_session_device()
+{
+	shared_ptr<Session> session = default_session_.lock();
+	if (!session)
+		return;
+
+	// Stop following the scan once the user picked a device
+	if (session->device() != default_session_device_) {
+		default_session_.reset();
+		return;
+	}
+
+	if (session->get_capture_state() != Session::Stopped)
+		return;
+
 	// Check the list of available devices. Prefer the one that was
 	// found with user supplied scan specs (if applicable). Then try
 	// one of the auto detected devices that are not the demo device.
 	// Pick demo in the absence of "genuine" hardware devices.
 	shared_ptr<devices::HardwareDevice> user_device, other_device, demo_device;
-	
+
 	qDebug() << "=== Device Selection Debug ===";
 	qDebug() << "Total devices found:" << device_manager_.devices().size();
 	qDebug() << "User spec device:" << (device_manager_.user_spec_device() ? "Found" : "None");
-	
+
 	for (const shared_ptr<devices::HardwareDevice>& dev : device_manager_.devices()) {
 		QString dev_name = QString::fromStdString(dev->display_name(device_manager_));
 		QString driver_name = QString::fromStdString(dev->hardware_device()->driver()->name());
-		
+
 		qDebug() << "Device:" << dev_name << "Driver:" << driver_name;
-		
+
 		if (dev == device_manager_.user_spec_device()) {
 			user_device = dev;
 			qDebug() << "  -> This is the USER SPEC DEVICE (will be selected)";
@@ -455,16 +498,26 @@ void MainWindow::add_default_session()
 			qDebug() << "  -> This is another device";
 		}
 	}
-	
+
+	// Only switch devices when a better match than the current one showed up
+	shared_ptr<devices::HardwareDevice> device;
+	int rank = 0;
 	if (user_device) {
-		qDebug() << "SELECTING USER DEVICE:" << QString::fromStdString(user_device->display_name(device_manager_));
-		session->select_device(user_device);
+		device = user_device;
+		rank = 3;
 	} else if (other_device) {
-		qDebug() << "SELECTING OTHER DEVICE:" << QString::fromStdString(other_device->display_name(device_manager_));
-		session->select_device(other_device);
-	} else {
-		qDebug() << "SELECTING DEMO DEVICE";
-		session->select_device(demo_device);
+		device = other_device;
+		rank = 2;
+	} else if (demo_device) {
+		device = demo_device;
+		rank = 1;
+	}
+
+	if (rank > default_session_device_rank_) {
+		qDebug() << "SELECTING DEVICE:" << QString::fromStdString(device->display_name(device_manager_));
+		session->select_device(device);
+		default_session_device_ = session->device();
+		default_session_device_rank_ = rank;
 	}
 	qDebug() << "=== End Device Selection Debug ===";
 }
@@ -999,6 +1052,21 @@ void MainWindow::on_view_show_analog_minor_grid_shortcut()
 	settings.setValue(GlobalSettings::Key_View_ShowAnalogMinorGrid, !state);
 }
 
+void MainWindow::on_devices_changed()
+{
+	for (shared_ptr<Session>& session : sessions_)
+		if (session->main_bar())
+			session->main_bar()->update_device_list();
+
+	select_default_session_device();
+}
+
+void MainWindow::on_device_scan_finished()
+{
+	select_default_session_device();
+	default_session_.reset();
+}
+
 void MainWindow::on_close_current_tab()
 {
 	int tab = session_selector_.currentIndex();
@@ -36,6 +36,7 @@ using std::list;
 using std::map;
 using std::shared_ptr;
 using std::string;
+using std::weak_ptr;
 
 struct srd_decoder;
 
@@ -95,6 +96,8 @@ public:
 	void add_session_with_file(string open_file_name, string open_file_format,
 		string open_setup_file_name);
 
+	void add_session_with_shm_ring(string ring_name);
+
 	void add_default_session();
 
 	void save_sessions();
@@ -108,6 +111,13 @@ private:
 	void restore_ui_settings();
 
 	shared_ptr<Session> get_tab_session(int index) const;
+
+	/**
+	 * Picks the most suitable device found so far for the default session.
+	 * Called again as device scan results arrive, until the scan finished
+	 * or the user picked a device.
+	 */
+	void select_default_session_device();
 	
 	bool attempt_device_reconnection(shared_ptr<Session> session);
 
@@ -153,9 +163,16 @@ private Q_SLOTS:
 
 	void on_close_current_tab();
 
+	void on_devices_changed();
+	void on_device_scan_finished();
+
 private:
 	DeviceManager &device_manager_;
 
+	weak_ptr<Session> default_session_;
+	shared_ptr<devices::Device> default_session_device_;
+	int default_session_device_rank_;
+
 	list< shared_ptr<Session> > sessions_;
 	shared_ptr<Session> last_focused_session_;
 
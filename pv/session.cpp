@@ -28,6 +28,7 @@
 #include <QDir>
 #include <QFileInfo>
 
+#include "config.h"
 #include "devicemanager.hpp"
 #include "mainwindow.hpp"
 #include "session.hpp"
@@ -44,6 +45,9 @@
 #include "devices/hardwaredevice.hpp"
 #include "devices/inputfile.hpp"
 #include "devices/sessionfile.hpp"
+#ifdef HAVE_SHM_OPEN
+#include "devices/shmringdevice.hpp"
+#endif
 
 #include "toolbars/mainbar.hpp"
 
@@ -63,6 +67,7 @@
 #ifdef ENABLE_DECODE
 #include <libsigrokdecode/libsigrokdecode.h>
 #include "data/decodesignal.hpp"
+#include "data/decode/logicmux.hpp"
 #endif
 
 using std::bad_alloc;
@@ -128,6 +133,9 @@ Session::Session(DeviceManager &device_manager, QString name) :
 {
 	// Use this name also for the QObject instance
 	setObjectName(name_);
+
+	connect(&device_manager_, SIGNAL(devices_changed()),
+		this, SLOT(on_devices_changed()));
 }
 
 Session::~Session()
@@ -361,7 +369,8 @@ void Session::save_settings(QSettings &settings) const
 			shared_ptr<devices::InputFile> inputfile_device =
 				dynamic_pointer_cast<devices::InputFile>(device_);
 
-			if (inputfile_device) {
+			// Streams can't be replayed, so don't try to reopen them on restore
+			if (inputfile_device && !inputfile_device->streaming()) {
 				settings.setValue("device_type", "inputfile");
 				settings.beginGroup("device");
 				inputfile_device->save_meta_to_settings(settings);
@@ -417,6 +426,10 @@ void Session::restore_setup(QSettings &settings)
 	}
 #endif
 
+	// Without a main window, e.g. in batch mode, there are no views
+	if (!main_view_)
+		return;
+
 	// Restore views
 	int views = settings.value("views").toInt();
 
@@ -469,6 +482,7 @@ void Session::restore_setup(QSettings &settings)
 void Session::restore_settings(QSettings &settings)
 {
 	shared_ptr<devices::Device> device;
+	const QString settings_group = settings.group();
 
 	const QString device_type = settings.value("device_type").toString();
 
@@ -500,6 +514,13 @@ void Session::restore_settings(QSettings &settings)
 		if (device)
 			set_device(device);
 
+		// The device may still turn up in the background scan
+		if (!device && (dev_info.count("model") > 0) &&
+			device_manager_.scan_in_progress()) {
+			pending_device_info_ = dev_info;
+			pending_settings_group_ = settings_group;
+		}
+
 		settings.endGroup();
 
 		if (device)
@@ -635,11 +656,19 @@ void Session::set_device(shared_ptr<devices::Device> device)
 	}
 
 	if (device_) {
-		device_->session()->add_datafeed_callback([=]
+		device_->add_datafeed_callback([=]
 			(shared_ptr<sigrok::Device> device, shared_ptr<Packet> packet) {
 				data_feed_in(device, packet);
 			});
 
+		shared_ptr<devices::InputFile> inputfile_device =
+			dynamic_pointer_cast<devices::InputFile>(device_);
+		if (inputfile_device)
+			inputfile_device->set_progress_callback([=]
+				(uint64_t bytes_read, uint64_t bytes_total) {
+					import_progress(bytes_read, bytes_total);
+				});
+
 		update_signals();
 	}
 
@@ -756,6 +785,14 @@ void Session::load_file(QString file_name, QString setup_file_name,
 	const QString errorMessage(
 		QString("Failed to load file %1").arg(file_name));
 
+	// Streams can only be read once, so they can't be probed for their format
+	const bool stream = devices::InputFile::is_stream(file_name.toStdString());
+	if (stream && !format) {
+		MainWindow::show_session_error(errorMessage,
+			tr("Reading from a pipe requires the input format to be specified."));
+		return;
+	}
+
 	// In the absence of a caller's format spec, try to auto detect.
 	// Assume "sigrok session file" upon lookup miss.
 	if (!format)
@@ -783,7 +820,7 @@ void Session::load_file(QString file_name, QString setup_file_name,
 	}
 
 	// Use the input file with .pvs extension if no setup file was given
-	if (setup_file_name.isEmpty()) {
+	if (setup_file_name.isEmpty() && !stream) {
 		setup_file_name = file_name;
 		setup_file_name.truncate(setup_file_name.lastIndexOf('.'));
 		setup_file_name.append(".pvs");
@@ -794,7 +831,9 @@ void Session::load_file(QString file_name, QString setup_file_name,
 		restore_setup(settings_storage);
 	}
 
-	main_bar_->update_device_list();
+	// There's no main bar in batch mode
+	if (main_bar_)
+		main_bar_->update_device_list();
 
 	start_capture([&, errorMessage](QString infoMessage) {
 		Q_EMIT session_error_raised(errorMessage, infoMessage); });
@@ -806,6 +845,32 @@ void Session::load_file(QString file_name, QString setup_file_name,
 	set_name(QFileInfo(file_name).fileName());
 }
 
+void Session::load_shm_ring(const string &ring_name)
+{
+	const QString name = QString::fromStdString(ring_name);
+	const QString errorMessage(
+		QString("Failed to attach to shared memory ring %1").arg(name));
+
+#ifdef HAVE_SHM_OPEN
+	set_device(make_shared<devices::ShmRingDevice>(
+		device_manager_.context(), ring_name));
+
+	// set_device() reports the reason if attaching failed
+	if (!device_)
+		return;
+
+	main_bar_->update_device_list();
+
+	start_capture([&, errorMessage](QString infoMessage) {
+		Q_EMIT session_error_raised(errorMessage, infoMessage); });
+
+	set_name(name);
+#else
+	MainWindow::show_session_error(errorMessage,
+		tr("Shared memory rings are not supported on this platform."));
+#endif
+}
+
 Session::capture_state Session::get_capture_state() const
 {
 	lock_guard<mutex> lock(sampling_mutex_);
@@ -1055,6 +1120,32 @@ void Session::remove_decode_signal(shared_ptr<data::DecodeSignal> signal)
 
 	signals_changed();
 }
+
+shared_ptr<data::decode::LogicMux> Session::get_logic_mux(
+	const vector< pair<shared_ptr<data::Logic>, unsigned int> > &inputs)
+{
+	shared_ptr<data::decode::LogicMux> result;
+
+	// Muxes are dropped once no decode signal uses them anymore
+	for (auto it = logic_muxes_.begin(); it != logic_muxes_.end();) {
+		const shared_ptr<data::decode::LogicMux> mux = it->lock();
+		if (!mux) {
+			it = logic_muxes_.erase(it);
+			continue;
+		}
+
+		if (!result && mux->is_valid() && mux->has_inputs(inputs))
+			result = mux;
+		it++;
+	}
+
+	if (!result) {
+		result = make_shared<data::decode::LogicMux>(inputs);
+		logic_muxes_.push_back(result);
+	}
+
+	return result;
+}
 #endif
 
 bool Session::all_segments_complete(uint32_t segment_id) const
@@ -1731,6 +1822,34 @@ void Session::data_feed_in(shared_ptr<sigrok::Device> device,
 	}
 }
 
+void Session::on_devices_changed()
+{
+	if (pending_device_info_.empty())
+		return;
+
+	// Don't override a device the user picked in the meantime
+	if (device_) {
+		pending_device_info_.clear();
+		return;
+	}
+
+	const shared_ptr<devices::HardwareDevice> device =
+		device_manager_.find_device_from_info(pending_device_info_);
+	if (!device)
+		return;
+
+	pending_device_info_.clear();
+
+	select_device(device);
+	if (device_ != device)
+		return;
+
+	QSettings settings;
+	settings.beginGroup(pending_settings_group_);
+	restore_setup(settings);
+	settings.endGroup();
+}
+
 void Session::on_data_saved()
 {
 	data_saved_ = true;
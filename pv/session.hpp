@@ -59,6 +59,7 @@ using std::recursive_mutex;
 using std::shared_ptr;
 using std::string;
 using std::unordered_set;
+using std::weak_ptr;
 
 #ifdef ENABLE_FLOW
 using Glib::RefPtr;
@@ -98,6 +99,10 @@ class LogicSegment;
 class SignalBase;
 class SignalData;
 class SignalGroup;
+
+namespace decode {
+class LogicMux;
+}
 }
 
 namespace devices {
@@ -182,6 +187,12 @@ public:
 		const map<string, Glib::VariantBase> &options =
 			map<string, Glib::VariantBase>());
 
+	/**
+	 * Attaches to the shared-memory sample ring with the given POSIX
+	 * shared-memory object name and starts acquiring from it.
+	 */
+	void load_shm_ring(const string &ring_name);
+
 	capture_state get_capture_state() const;
 	void start_capture(function<void (const QString)> error_handler);
 	void stop_capture();
@@ -209,6 +220,14 @@ public:
 	shared_ptr<data::DecodeSignal> add_decode_signal();
 
 	void remove_decode_signal(shared_ptr<data::DecodeSignal> signal);
+
+	/**
+	 * Returns the muxed data for decoders that use the given input bits.
+	 * Decode signals with the same inputs share it, so that the muxing is
+	 * done only once and its result is stored only once.
+	 */
+	shared_ptr<data::decode::LogicMux> get_logic_mux(
+		const vector< std::pair<shared_ptr<data::Logic>, unsigned int> > &inputs);
 #endif
 
 	bool all_segments_complete(uint32_t segment_id) const;
@@ -266,6 +285,9 @@ Q_SIGNALS:
 
 	void data_received();
 
+	/// Emitted while a file is imported, @a bytes_total is 0 for streams
+	void import_progress(qulonglong bytes_read, qulonglong bytes_total);
+
 	void add_view(ViewType type, Session *session);
 	void session_error_raised(const QString text, const QString info_text);
 
@@ -276,6 +298,9 @@ public Q_SLOTS:
 	void on_new_decoders_selected(vector<const srd_decoder*> decoders);
 #endif
 
+private Q_SLOTS:
+	void on_devices_changed();
+
 private:
 	bool shutting_down_;
 
@@ -319,6 +344,14 @@ private:
 
 	MetadataObjManager metadata_obj_manager_;
 
+	/// Device to restore once the background device scan finds it
+	map<string, string> pending_device_info_;
+	QString pending_settings_group_;
+
+#ifdef ENABLE_DECODE
+	vector< weak_ptr<data::decode::LogicMux> > logic_muxes_;
+#endif
+
 #ifdef ENABLE_FLOW
 	RefPtr<Pipeline> pipeline_;
 	RefPtr<Element> source_;
@@ -23,6 +23,8 @@
 
 #include <libsigrokdecode/libsigrokdecode.h>
 
+#include <pv/decoderloader.hpp>
+
 #define DECODERS_HAVE_TAGS \
 	((SRD_PACKAGE_VERSION_MAJOR > 0) || \
 	 (SRD_PACKAGE_VERSION_MAJOR == 0) && (SRD_PACKAGE_VERSION_MINOR > 5))
@@ -42,6 +44,16 @@ DecoderCollectionModel::DecoderCollectionModel(QObject* parent) :
 	header_data.emplace_back(tr("ID"));          // Column #2
 	root_ = make_shared<DecoderCollectionItem>(header_data);
 
+	// The model stays empty until the decoders finished loading
+	if (DecoderLoader::is_loaded())
+		populate();
+	else
+		connect(DecoderLoader::instance(), SIGNAL(loaded()),
+			this, SLOT(on_decoders_loaded()));
+}
+
+void DecoderCollectionModel::populate()
+{
 	// Note: the tag groups are sub-items of the root item
 
 	// Create "all decoders" group
@@ -55,7 +67,7 @@ DecoderCollectionModel::DecoderCollectionModel(QObject* parent) :
 		make_shared<DecoderCollectionItem>(item_data, root_);
 	root_->appendSubItem(group_item_all);
 
-	for (GSList* li = (GSList*)srd_decoder_list(); li; li = li->next) {
+	for (GSList* li = (GSList*)DecoderLoader::get_decoders(); li; li = li->next) {
 		const srd_decoder *const d = (srd_decoder*)li->data;
 		assert(d);
 
@@ -108,6 +120,13 @@ DecoderCollectionModel::DecoderCollectionModel(QObject* parent) :
 	}
 }
 
+void DecoderCollectionModel::on_decoders_loaded()
+{
+	beginResetModel();
+	populate();
+	endResetModel();
+}
+
 QVariant DecoderCollectionModel::data(const QModelIndex& index, int role) const
 {
 	if (!index.isValid())
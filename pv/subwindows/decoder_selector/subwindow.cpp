@@ -29,6 +29,7 @@
 #include <QScrollArea>
 #include <QVBoxLayout>
 
+#include "pv/decoderloader.hpp"
 #include "pv/session.hpp"
 #include "pv/subwindows/decoder_selector/subwindow.hpp"
 
@@ -132,6 +133,9 @@ SubWindow::SubWindow(Session& session, QWidget* parent) :
 #if (!DECODERS_HAVE_TAGS)
 	tree_view_->expandAll();
 	tree_view_->setItemsExpandable(false);
+
+	// The decoders may still be loading, expand them once they're there
+	connect(model_, SIGNAL(modelReset()), tree_view_, SLOT(expandAll()));
 #endif
 
 	QScrollArea* info_label_body_container = new QScrollArea();
@@ -205,7 +209,7 @@ vector<const srd_decoder*> SubWindow::get_decoders_providing(const char* output)
 {
 	vector<const srd_decoder*> ret_val;
 
-	for (GSList* li = (GSList*)srd_decoder_list(); li; li = li->next) {
+	for (GSList* li = (GSList*)DecoderLoader::get_decoders(); li; li = li->next) {
 		const srd_decoder* d = (srd_decoder*)li->data;
 		assert(d);
 
@@ -234,7 +238,7 @@ void SubWindow::on_item_changed(const QModelIndex& index)
 		if (decoder_name.isEmpty())
 			return;
 
-		const srd_decoder* d = srd_decoder_get_by_id(decoder_name.toUtf8());
+		const srd_decoder* d = DecoderLoader::get_decoder(decoder_name.toUtf8());
 
 		id = QString::fromUtf8(d->id);
 		longname = QString::fromUtf8(d->longname);
@@ -275,7 +279,7 @@ void SubWindow::on_item_activated(const QModelIndex& index)
 	QModelIndex id_index = index.model()->index(index.row(), 2, index.parent());
 	QString decoder_name = index.model()->data(id_index, Qt::DisplayRole).toString();
 
-	const srd_decoder* chosen_decoder = srd_decoder_get_by_id(decoder_name.toUtf8());
+	const srd_decoder* chosen_decoder = DecoderLoader::get_decoder(decoder_name.toUtf8());
 	if (chosen_decoder == nullptr)
 		return;
 
@@ -324,7 +328,7 @@ void SubWindow::on_item_activated(const QModelIndex& index)
 				return;
 
 			QString d = item.section(' ', 0, 0);
-			decoders.push_back(srd_decoder_get_by_id(d.toUtf8()));
+			decoders.push_back(DecoderLoader::get_decoder(d.toUtf8()));
 		}
 
 		inputs = get_decoder_inputs(decoders.back());
@@ -80,6 +80,12 @@ public:
 	int rowCount(const QModelIndex& parent_idx = QModelIndex()) const override;
 	int columnCount(const QModelIndex& parent_idx = QModelIndex()) const override;
 
+private:
+	void populate();
+
+private Q_SLOTS:
+	void on_decoders_loaded();
+
 private:
 	shared_ptr<DecoderCollectionItem> root_;
 };
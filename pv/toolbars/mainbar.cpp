@@ -111,6 +111,8 @@ MainBar::MainBar(Session &session, QWidget *parent, pv::views::trace::View *view
 	updating_sample_rate_(false),
 	updating_sample_count_(false),
 	sample_count_supported_(false),
+	import_progress_(this),
+	import_progress_action_(nullptr),
 #ifdef ENABLE_DECODE
 	add_decoder_button_(new QToolButton()),
 #endif
@@ -282,6 +284,8 @@ MainBar::MainBar(Session &session, QWidget *parent, pv::views::trace::View *view
 	channels_button_.setToolTip(tr("Configure Channels"));
 	channels_button_.setIcon(QIcon(":/icons/channels.svg"));
 
+	import_progress_.setMaximumWidth(200);
+
 	add_toolbar_widgets();
 
 	sample_count_.installEventFilter(this);
@@ -290,6 +294,8 @@ MainBar::MainBar(Session &session, QWidget *parent, pv::views::trace::View *view
 	// Setup session_ events
 	connect(&session_, SIGNAL(capture_state_changed(int)),
 		this, SLOT(on_capture_state_changed(int)));
+	connect(&session_, SIGNAL(import_progress(qulonglong, qulonglong)),
+		this, SLOT(on_import_progress(qulonglong, qulonglong)));
 	connect(&session, SIGNAL(device_changed()),
 		this, SLOT(on_device_changed()));
 
@@ -823,6 +829,28 @@ void MainBar::on_device_changed()
 void MainBar::on_capture_state_changed(int state)
 {
 	set_capture_state((pv::Session::capture_state)state);
+
+	// The last progress report of an import arrives before it stops
+	if (state == pv::Session::Stopped)
+		import_progress_action_->setVisible(false);
+}
+
+void MainBar::on_import_progress(qulonglong bytes_read, qulonglong bytes_total)
+{
+	const double MiB = 1024 * 1024;
+
+	if (bytes_total > 0) {
+		import_progress_.setRange(0, 1000);
+		import_progress_.setValue(min(bytes_read, bytes_total) * 1000 / bytes_total);
+		import_progress_.setFormat(tr("Importing %1 of %2 MiB").
+			arg(bytes_read / MiB, 0, 'f', 1).arg(bytes_total / MiB, 0, 'f', 1));
+	} else {
+		// The size of a stream isn't known, so only show that it's busy
+		import_progress_.setRange(0, 0);
+		import_progress_.setFormat(tr("Importing %1 MiB").arg(bytes_read / MiB, 0, 'f', 1));
+	}
+
+	import_progress_action_->setVisible(true);
 }
 
 void MainBar::on_sample_count_changed()
@@ -993,6 +1021,8 @@ void MainBar::add_toolbar_widgets()
 	channels_button_action_ = addWidget(&channels_button_);
 	addWidget(&sample_count_);
 	addWidget(&sample_rate_);
+	import_progress_action_ = addWidget(&import_progress_);
+	import_progress_action_->setVisible(false);
 	
 	// Add Jumperless configuration widget
 	addSeparator();
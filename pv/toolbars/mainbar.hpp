@@ -29,6 +29,7 @@
 #include <QComboBox>
 #include <QDoubleSpinBox>
 #include <QMenu>
+#include <QProgressBar>
 #include <QToolBar>
 #include <QToolButton>
 
@@ -128,6 +129,7 @@ private Q_SLOTS:
 	void on_device_selected();
 	void on_device_changed();
 	void on_capture_state_changed(int state);
+	void on_import_progress(qulonglong bytes_read, qulonglong bytes_total);
 	void on_sample_count_changed();
 	void on_sample_rate_changed();
 
@@ -184,6 +186,9 @@ private:
 
 	bool sample_count_supported_;
 
+	QProgressBar import_progress_;
+	QAction *import_progress_action_;
+
 #ifdef ENABLE_DECODE
 	QToolButton *add_decoder_button_;
 #endif
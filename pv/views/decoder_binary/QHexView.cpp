@@ -95,13 +95,7 @@ void QHexView::set_data(const DecodeBinaryClass* data)
 {
 	data_ = data;
 
-	size_t size = 0;
-	if (data) {
-		size_t chunks = data_->chunks.size();
-		for (size_t i = 0; i < chunks; i++)
-			size += data_->chunks[i].data.size();
-	}
-	data_size_ = size;
+	data_size_ = data ? data->size : 0;
 
 	address_digits_ = (uint8_t)QString::number(data_size_, 16).length();
 
@@ -223,26 +217,17 @@ void QHexView::initialize_byte_iterator(size_t offset)
 {
 	current_chunk_id_ = 0;
 	current_chunk_offset_ = 0;
+	current_chunk_size_ = 0;
+	current_chunk_sample_ = 0;
 	current_offset_ = offset;
 
-	size_t chunks = data_->chunks.size();
-	for (size_t i = 0; i < chunks; i++) {
-		size_t size = data_->chunks[i].data.size();
-
-		if (offset >= size) {
-			current_chunk_id_++;
-			offset -= size;
-		} else {
-			current_chunk_offset_ = offset;
-			break;
-		}
+	if (!data_->chunks.empty()) {
+		current_chunk_id_ = data_->chunk_at_offset(offset);
+		current_chunk_offset_ = offset - data_->chunks[current_chunk_id_].offset;
+		current_chunk_size_ = data_->chunk_size(current_chunk_id_);
+		current_chunk_sample_ = data_->chunks[current_chunk_id_].sample;
 	}
 
-	if (current_chunk_id_ < data_->chunks.size())
-		current_chunk_ = data_->chunks[current_chunk_id_];
-
-	current_chunk_sample_ = current_chunk_.sample;
-
 	// Obtain sample of next chunk if there is one
 	if ((current_chunk_id_ + 1) < data_->chunks.size())
 		next_chunk_sample_ = data_->chunks[current_chunk_id_ + 1].sample;
@@ -256,10 +241,10 @@ uint8_t QHexView::get_next_byte(bool* is_new_chunk)
 		*is_new_chunk = (current_chunk_offset_ == 0);
 
 	uint8_t v = 0;
-	if (current_chunk_offset_ < current_chunk_.data.size())
-		v = current_chunk_.data[current_chunk_offset_];
+	if (current_chunk_offset_ < current_chunk_size_)
+		v = data_->byte_at(current_offset_);
 
-	current_chunk_sample_ = current_chunk_.sample;
+	current_chunk_sample_ = data_->chunks[current_chunk_id_].sample;
 
 	if (is_new_chunk) {
 		// Obtain sample of next chunk if there is one
@@ -278,10 +263,11 @@ uint8_t QHexView::get_next_byte(bool* is_new_chunk)
 		return 0xEE;
 	}
 
-	if ((current_chunk_offset_ == current_chunk_.data.size()) && (current_offset_ < data_size_)) {
-		current_chunk_id_++;
+	if ((current_chunk_offset_ == current_chunk_size_) && (current_offset_ < data_size_)) {
+		// Also skips empty chunks
+		current_chunk_id_ = data_->chunk_at_offset(current_offset_);
 		current_chunk_offset_ = 0;
-		current_chunk_ = data_->chunks[current_chunk_id_];
+		current_chunk_size_ = data_->chunk_size(current_chunk_id_);
 	}
 
 	return v;
@@ -276,15 +276,15 @@ void View::save_data() const
 	if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
 		pair<size_t, size_t> selection = hex_view_->get_selection();
 
-		vector<uint8_t> data;
-		data.resize(selection.second - selection.first + 1);
-
-		signal_->get_merged_binary_data_chunks_by_offset(current_segment_, decoder_,
-			bin_class_id_, selection.first, selection.second, &data);
-
-		int64_t bytes_written = file.write((const char*)data.data(), data.size());
-
-		if ((bytes_written == -1) || ((uint64_t)bytes_written != data.size())) {
+		// The data is written straight from where the decode signal keeps it
+		bool write_failed = false;
+		signal_->get_binary_data_spans(current_segment_, decoder_, bin_class_id_,
+			selection.first, selection.second, [&](const uint8_t* data, uint64_t size) {
+				if (!write_failed)
+					write_failed = (file.write((const char*)data, size) != (int64_t)size);
+			});
+
+		if (write_failed) {
 			QMessageBox msg(parent_);
 			msg.setText(tr("Error") + "\n\n" + tr("File %1 could not be written to.").arg(file_name));
 			msg.setStandardButtons(QMessageBox::Ok);
@@ -316,12 +316,6 @@ void View::save_data_as_hex_dump(bool with_offset, bool with_ascii) const
 	if (file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
 		pair<size_t, size_t> selection = hex_view_->get_selection();
 
-		vector<uint8_t> data;
-		data.resize(selection.second - selection.first + 1);
-
-		signal_->get_merged_binary_data_chunks_by_offset(current_segment_, decoder_,
-			bin_class_id_, selection.first, selection.second, &data);
-
 		QTextStream out_stream(&file);
 
 		uint64_t offset = selection.first;
@@ -17,6 +17,8 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits>
+
 #include <QApplication>
 #include <QDebug>
 #include <QString>
@@ -29,6 +31,7 @@
 #include "pv/globalsettings.hpp"
 
 using std::make_shared;
+using std::numeric_limits;
 
 using pv::util::Timestamp;
 using pv::util::format_time_si;
@@ -41,9 +44,10 @@ namespace tabular_decoder {
 
 AnnotationCollectionModel::AnnotationCollectionModel(QObject* parent) :
 	QAbstractTableModel(parent),
-	all_annotations_(nullptr),
+	annotation_count_(0),
 	dataset_(nullptr),
 	signal_(nullptr),
+	current_segment_(0),
 	first_hidden_column_(0),
 	prev_segment_(0),
 	prev_last_row_(0),
@@ -182,6 +186,10 @@ QModelIndex AnnotationCollectionModel::index(int row, int column,
 	if (!dataset_ || (row < 0))
 		return QModelIndex();
 
+	// Only merge the annotations of all rows as far as the table needs them
+	if (!hide_hidden_ && ((size_t)row >= dataset_->size()) && signal_)
+		signal_->merge_annotations(all_annotations_, current_segment_, row + 1);
+
 	QModelIndex idx;
 
 	if ((size_t)row < dataset_->size())
@@ -204,7 +212,7 @@ int AnnotationCollectionModel::rowCount(const QModelIndex& parent_idx) const
 	if (!dataset_)
 		return 0;
 
-	return dataset_->size();
+	return hide_hidden_ ? dataset_->size() : annotation_count_;
 }
 
 int AnnotationCollectionModel::columnCount(const QModelIndex& parent_idx) const
@@ -219,7 +227,8 @@ void AnnotationCollectionModel::set_signal_and_segment(data::DecodeSignal* signa
 	layoutAboutToBeChanged();
 
 	if (!signal) {
-		all_annotations_ = nullptr;
+		all_annotations_.clear();
+		annotation_count_ = 0;
 		dataset_ = nullptr;
 		signal_ = nullptr;
 
@@ -232,8 +241,24 @@ void AnnotationCollectionModel::set_signal_and_segment(data::DecodeSignal* signa
 		for (const shared_ptr<Decoder>& dec : signal_->decoder_stack())
 			disconnect(dec.get(), nullptr, this, SLOT(on_annotation_visibility_changed()));
 
-	all_annotations_ = signal->get_all_annotations_by_segment(current_segment);
+	// The annotations belong to a different segment or were discarded on
+	// reset, so they must be merged again
+	const uint64_t annotation_count = signal->get_annotation_count(current_segment);
+	if ((signal != signal_) || (current_segment != current_segment_) ||
+		(annotation_count < annotation_count_))
+		all_annotations_.clear();
+	else {
+		// Annotations inserted out of order may have moved the merged ones
+		// in memory, in which case they're merged again as they're needed
+		const size_t merged_count = all_annotations_.annotations().size();
+		signal->merge_annotations(all_annotations_, current_segment, 0);
+		if (all_annotations_.annotations().size() < merged_count)
+			prev_last_row_ = 0;
+	}
+
+	annotation_count_ = annotation_count;
 	signal_ = signal;
+	current_segment_ = current_segment;
 
 	for (const shared_ptr<Decoder>& dec : signal_->decoder_stack())
 		connect(dec.get(), SIGNAL(annotation_visibility_changed()),
@@ -243,23 +268,26 @@ void AnnotationCollectionModel::set_signal_and_segment(data::DecodeSignal* signa
 		update_annotations_without_hidden();
 		dataset_ = &all_annotations_without_hidden_;
 	} else
-		dataset_ = all_annotations_;
+		dataset_ = &all_annotations_.annotations();
 
-	if (!dataset_ || dataset_->empty()) {
+	if (rowCount() == 0) {
 		prev_segment_ = current_segment;
 		return;
 	}
 
-	const size_t new_row_count = dataset_->size() - 1;
+	const size_t new_row_count = rowCount() - 1;
+
+	// The rows are only referred to by number, so use createIndex() instead
+	// of index() which would merge all annotations up to them
 
 	// Force the view associated with this model to update when the segment changes
 	if (prev_segment_ != current_segment) {
-		dataChanged(index(0, 0), index(new_row_count, 0));
+		dataChanged(createIndex(0, 0), createIndex(new_row_count, 0));
 		layoutChanged();
 	} else {
 		// Force the view associated with this model to update when we have more annotations
 		if (prev_last_row_ < new_row_count) {
-			dataChanged(index(prev_last_row_, 0), index(new_row_count, 0));
+			dataChanged(createIndex(prev_last_row_, 0), createIndex(new_row_count, 0));
 			layoutChanged();
 		}
 	}
@@ -268,6 +296,17 @@ void AnnotationCollectionModel::set_signal_and_segment(data::DecodeSignal* signa
 	prev_last_row_ = new_row_count;
 }
 
+void AnnotationCollectionModel::reload_annotations()
+{
+	// The merged annotations may point to removed ones
+	all_annotations_.clear();
+	all_annotations_without_hidden_.clear();
+	annotation_count_ = 0;
+	prev_last_row_ = 0;
+
+	set_signal_and_segment(signal_, current_segment_);
+}
+
 void AnnotationCollectionModel::set_hide_hidden(bool hide_hidden)
 {
 	layoutAboutToBeChanged();
@@ -278,12 +317,12 @@ void AnnotationCollectionModel::set_hide_hidden(bool hide_hidden)
 		dataset_ = &all_annotations_without_hidden_;
 		update_annotations_without_hidden();
 	} else {
-		dataset_ = all_annotations_;
+		dataset_ = signal_ ? &all_annotations_.annotations() : nullptr;
 		all_annotations_without_hidden_.clear();  // To conserve memory
 	}
 
 	if (dataset_)
-		dataChanged(index(0, 0), index(dataset_->size() - 1, 0));
+		dataChanged(index(0, 0), index(rowCount() - 1, 0));
 	else
 		dataChanged(QModelIndex(), QModelIndex());
 
@@ -294,12 +333,15 @@ void AnnotationCollectionModel::update_annotations_without_hidden()
 {
 	uint64_t count = 0;
 
-	if (!all_annotations_ || all_annotations_->empty()) {
+	if (!signal_ || (annotation_count_ == 0)) {
 		all_annotations_without_hidden_.clear();
 		return;
 	}
 
-	for (const Annotation* ann : *all_annotations_) {
+	signal_->merge_annotations(all_annotations_, current_segment_,
+		numeric_limits<size_t>::max());
+
+	for (const Annotation* ann : all_annotations_.annotations()) {
 		if (!ann->visible())
 			continue;
 
@@ -363,7 +405,7 @@ void AnnotationCollectionModel::on_annotation_visibility_changed()
 	update_annotations_without_hidden();
 
 	if (dataset_)
-		dataChanged(index(0, 0), index(dataset_->size() - 1, 0));
+		dataChanged(index(0, 0), index(rowCount() - 1, 0));
 	else
 		dataChanged(QModelIndex(), QModelIndex());
 
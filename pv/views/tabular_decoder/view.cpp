@@ -455,6 +455,7 @@ void View::on_selected_decoder_changed(int index)
 		disconnect(signal_, SIGNAL(color_changed(QColor)));
 		disconnect(signal_, SIGNAL(new_annotations()));
 		disconnect(signal_, SIGNAL(decode_reset()));
+		disconnect(signal_, SIGNAL(annotations_removed()));
 	}
 
 	reset_data();
@@ -471,6 +472,7 @@ void View::on_selected_decoder_changed(int index)
 		connect(signal_, SIGNAL(color_changed(QColor)), this, SLOT(on_signal_color_changed(QColor)));
 		connect(signal_, SIGNAL(new_annotations()), this, SLOT(on_new_annotations()));
 		connect(signal_, SIGNAL(decode_reset()), this, SLOT(on_decoder_reset()));
+		connect(signal_, SIGNAL(annotations_removed()), this, SLOT(on_annotations_removed()));
 	}
 
 	update_data();
@@ -563,6 +565,11 @@ void View::on_decoder_reset()
 	model_->set_signal_and_segment(signal_, current_segment_);
 }
 
+void View::on_annotations_removed()
+{
+	model_->reload_annotations();
+}
+
 void View::on_decoder_stacked(void* decoder)
 {
 	Decoder* d = static_cast<Decoder*>(decoder);
@@ -84,6 +84,9 @@ public:
 	void set_signal_and_segment(data::DecodeSignal* signal, uint32_t current_segment);
 	void set_hide_hidden(bool hide_hidden);
 
+	/// Merges the annotations again, e.g. after some of them were removed
+	void reload_annotations();
+
 	void update_annotations_without_hidden();
 	QModelIndex update_highlighted_rows(QModelIndex first, QModelIndex last,
 		int64_t sample_num);
@@ -93,10 +96,12 @@ private Q_SLOTS:
 
 private:
 	vector<QVariant> header_data_;
-	const deque<const Annotation*>* all_annotations_;
+	mutable data::decode::AnnotationCursor all_annotations_;  ///< Merged as rows are requested
+	uint64_t annotation_count_;
 	deque<const Annotation*> all_annotations_without_hidden_;
 	const deque<const Annotation*>* dataset_;
 	data::DecodeSignal* signal_;
+	uint32_t current_segment_;
 	uint8_t first_hidden_column_;
 	uint32_t prev_segment_;
 	uint64_t prev_last_row_;
@@ -181,6 +186,7 @@ private Q_SLOTS:
 	void on_new_annotations();
 
 	void on_decoder_reset();
+	void on_annotations_removed();
 	void on_decoder_stacked(void* decoder);
 	void on_decoder_removed(void* decoder);
 
@@ -51,6 +51,7 @@
 #include <pv/strnatcmp.hpp>
 #include <pv/data/decodesignal.hpp>
 #include <pv/data/decode/annotation.hpp>
+#include <pv/data/decode/annotationformatter.hpp>
 #include <pv/data/decode/decoder.hpp>
 #include <pv/data/logic.hpp>
 #include <pv/data/logicsegment.hpp>
@@ -72,9 +73,12 @@ using std::vector;
 
 using pv::data::decode::Annotation;
 using pv::data::decode::AnnotationClass;
+using pv::data::decode::AnnotationFormatter;
 using pv::data::decode::Row;
 using pv::data::decode::DecodeChannel;
 using pv::data::DecodeSignal;
+using pv::data::DecodeStatistics;
+using pv::util::SIPrefix;
 
 namespace pv {
 namespace views {
@@ -94,6 +98,10 @@ const int DecodeTrace::DrawPadding = 100;
 const int DecodeTrace::MaxTraceUpdateRate = 1; // No more than 1 Hz
 const int DecodeTrace::AnimationDurationInTicks = 7;
 const int DecodeTrace::HiddenRowHideDelay = 1000; // 1 second
+const int DecodeTrace::StatisticsUpdateInterval = 500; // 0.5 seconds
+
+// Lets the decoders see a few idle bit times of slow buses before the range
+const double DecodeTrace::DecodeRangeWarmUpTime = 0.01; // 10 ms
 
 /**
  * Helper function for forceUpdate()
@@ -300,6 +308,10 @@ void DecodeTrace::paint_mid(QPainter &p, ViewItemPaintParams &pp)
 	sample_range.second = min((int64_t)sample_range.second,
 		decode_signal_->get_decoded_sample_count(current_segment_, false));
 
+	double samples_per_pixel, pixels_offset;
+	tie(pixels_offset, samples_per_pixel) =
+		get_pixels_offset_samples_per_pixel();
+
 	visible_rows = 0;
 	int y = get_visual_y();
 
@@ -313,14 +325,21 @@ void DecodeTrace::paint_mid(QPainter &p, ViewItemPaintParams &pp)
 			continue;
 		}
 
+		// When zoomed out, use the summaries of the annotations unless some
+		// classes are hidden, as the summaries include all classes
 		deque<const Annotation*> annotations;
-		decode_signal_->get_annotation_subset(annotations, r.decode_row,
-			current_segment_, sample_range.first, sample_range.second);
+		vector<AnnotationSummary> summaries;
+		if (r.has_hidden_classes || !decode_signal_->get_annotation_summary(
+			summaries, annotations, r.decode_row, current_segment_,
+			sample_range.first, sample_range.second, samples_per_pixel,
+			min_useful_label_width_ * samples_per_pixel))
+			decode_signal_->get_annotation_subset(annotations, r.decode_row,
+				current_segment_, sample_range.first, sample_range.second);
 
 		// Show row if there are visible annotations, when user wants to see
 		// all rows that have annotations somewhere and this one is one of them
 		// or when the row has at least one hidden annotation class
-		r.currently_visible = !annotations.empty();
+		r.currently_visible = !annotations.empty() || !summaries.empty();
 		if (!r.currently_visible) {
 			size_t ann_count = decode_signal_->get_annotation_count(r.decode_row, current_segment_);
 			r.currently_visible = ((always_show_all_rows_ || r.has_hidden_classes) &&
@@ -328,6 +347,7 @@ void DecodeTrace::paint_mid(QPainter &p, ViewItemPaintParams &pp)
 		}
 
 		if (r.currently_visible) {
+			draw_annotation_summaries(summaries, p, y, r);
 			draw_annotations(annotations, p, pp, y, r);
 			y += r.height;
 			visible_rows++;
@@ -475,6 +495,29 @@ void DecodeTrace::populate_popup_form(QWidget *parent, QFormLayout *form)
 	QHBoxLayout *stack_button_box = new QHBoxLayout;
 	stack_button_box->addWidget(stack_button_, 0, Qt::AlignRight);
 	form->addRow(stack_button_box);
+
+	if (stack.empty())
+		return;
+
+	// Add the statistics, which are updated while the popup is shown. The
+	// timer belongs to the label so that it goes away with the popup
+	QLabel *const stats_label = new QLabel(parent);
+	stats_label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+	update_statistics_label(stats_label);
+
+	QTimer *const stats_timer = new QTimer(stats_label);
+	connect(stats_timer, &QTimer::timeout, stats_label,
+		[this, stats_label]() { update_statistics_label(stats_label); });
+	stats_timer->start(StatisticsUpdateInterval);
+
+	QPushButton *const export_stats_button = new QPushButton(tr("Export..."), parent);
+	export_stats_button->setToolTip(tr("Save the statistics as CSV file"));
+	connect(export_stats_button, SIGNAL(clicked()), this, SLOT(on_export_statistics()));
+
+	QVBoxLayout *stats_box = new QVBoxLayout;
+	stats_box->addWidget(stats_label);
+	stats_box->addWidget(export_stats_button, 0, Qt::AlignRight);
+	form->addRow(tr("Statistics"), stats_box);
 }
 
 QMenu* DecodeTrace::create_header_context_menu(QWidget *parent)
@@ -539,6 +582,26 @@ QMenu* DecodeTrace::create_view_context_menu(QWidget *parent, QPoint &click_pos)
 		menu->addAction(pause);
 	}
 
+	QAction *const decode_cursor_range =
+		new QAction(tr("Decode only within cursor range"), this);
+	connect(decode_cursor_range, SIGNAL(triggered()), this, SLOT(on_decode_cursor_range()));
+	decode_cursor_range->setEnabled(view->cursors()->enabled());
+	menu->addAction(decode_cursor_range);
+
+	QAction *const decode_visible_range =
+		new QAction(tr("Decode only the visible range"), this);
+	connect(decode_visible_range, SIGNAL(triggered()), this, SLOT(on_decode_visible_range()));
+	menu->addAction(decode_visible_range);
+
+	if (decode_signal_->has_decode_range()) {
+		QAction *const decode_all =
+			new QAction(tr("Decode everything"), this);
+		connect(decode_all, SIGNAL(triggered()), this, SLOT(on_decode_all()));
+		menu->addAction(decode_all);
+	}
+
+	menu->addSeparator();
+
 	QAction *const copy_annotation_to_clipboard =
 		new QAction(tr("Copy annotation text to clipboard"), this);
 	copy_annotation_to_clipboard->setIcon(QIcon::fromTheme("edit-paste",
@@ -546,6 +609,27 @@ QMenu* DecodeTrace::create_view_context_menu(QWidget *parent, QPoint &click_pos)
 	connect(copy_annotation_to_clipboard, SIGNAL(triggered()), this, SLOT(on_copy_annotation_to_clipboard()));
 	menu->addAction(copy_annotation_to_clipboard);
 
+	deque<const Annotation*> clicked_annotations;
+	if (selected_row_)
+		decode_signal_->get_annotation_subset(clicked_annotations, selected_row_,
+			current_segment_, sample_range.first, sample_range.first);
+
+	if (!clicked_annotations.empty()) {
+		const Annotation* a = clicked_annotations.front();
+		const QString class_name = a->ann_class_description().isEmpty() ?
+			a->ann_class_name() : a->ann_class_description();
+
+		QAction *const go_to_next =
+			new QAction(tr("Go to next \"%1\" annotation").arg(class_name), this);
+		connect(go_to_next, SIGNAL(triggered()), this, SLOT(on_go_to_next_annotation()));
+		menu->addAction(go_to_next);
+
+		QAction *const go_to_previous =
+			new QAction(tr("Go to previous \"%1\" annotation").arg(class_name), this);
+		connect(go_to_previous, SIGNAL(triggered()), this, SLOT(on_go_to_previous_annotation()));
+		menu->addAction(go_to_previous);
+	}
+
 	menu->addSeparator();
 
 	QAction *const export_all_rows =
@@ -799,6 +883,46 @@ void DecodeTrace::draw_annotations(deque<const Annotation*>& annotations,
 			block_class_uniform, p, y, row);
 }
 
+void DecodeTrace::draw_annotation_summaries(
+	const vector<AnnotationSummary>& summaries, QPainter &p, int y,
+	const DecodeTraceRow& row) const
+{
+	uint32_t block_class = 0;
+	bool block_class_uniform = true;
+	qreal block_start = 0;
+	qreal block_end = INT_MIN;
+
+	double samples_per_pixel, pixels_offset;
+	tie(pixels_offset, samples_per_pixel) =
+		get_pixels_offset_samples_per_pixel();
+
+	// Same as in draw_annotations() but with a bucket of annotations taking
+	// the place of a single one. None of them is wide enough for a label
+	for (const AnnotationSummary& s : summaries) {
+		const qreal s_start = s.start_sample / samples_per_pixel - pixels_offset;
+		const qreal s_end = s.end_sample / samples_per_pixel - pixels_offset;
+
+		if (abs(s_start - block_end) > 1) {
+			if (block_end > INT_MIN)
+				draw_annotation_block(block_start, block_end, block_class,
+					block_class_uniform, p, y, row);
+
+			block_start = s_start;
+			block_end = s_end;
+			block_class = s.ann_class;
+			block_class_uniform = s.class_uniform;
+		} else {
+			block_end = max(block_end, s_end);
+			if (!s.class_uniform || (s.ann_class != block_class))
+				block_class_uniform = false;
+		}
+	}
+
+	if (block_end > INT_MIN)
+		draw_annotation_block(block_start, block_end, block_class,
+			block_class_uniform, p, y, row);
+}
+
 void DecodeTrace::draw_annotation(const Annotation* a, QPainter &p,
 	const ViewItemPaintParams &pp, int y, const DecodeTraceRow& row) const
 {
@@ -933,16 +1057,24 @@ void DecodeTrace::draw_unresolved_period(QPainter &p, int left, int right) const
 		return;
 
 	const int64_t samples_decoded = decode_signal_->get_decoded_sample_count(current_segment_, true);
-	if (sample_count == samples_decoded)
+
+	// Samples outside of the decode range are never decoded, so they're
+	// not shown as pending
+	const pair<uint64_t, uint64_t> range = decode_signal_->decode_range();
+	const int64_t first_pending = max(samples_decoded, (int64_t)min(range.first,
+		(uint64_t)sample_count));
+	const int64_t last_pending = min(sample_count, (int64_t)min(range.second,
+		(uint64_t)sample_count));
+	if (last_pending <= first_pending)
 		return;
 
 	const int y = get_visual_y();
 
 	tie(pixels_offset, samples_per_pixel) = get_pixels_offset_samples_per_pixel();
 
-	const double start = max(samples_decoded /
+	const double start = max(first_pending /
 		samples_per_pixel - pixels_offset, left - 1.0);
-	const double end = min(sample_count / samples_per_pixel -
+	const double end = min(last_pending / samples_per_pixel -
 		pixels_offset, right + 1.0);
 	const QRectF no_decode_rect(start, y - (annotation_height_ / 2) - 0.5,
 		end - start, annotation_height_);
@@ -993,6 +1125,27 @@ pair<uint64_t, uint64_t> DecodeTrace::get_view_sample_range(
 	return make_pair(start, end);
 }
 
+bool DecodeTrace::get_cursor_sample_range(uint64_t &start_sample,
+	uint64_t &end_sample) const
+{
+	const View *view = owner_->view();
+	assert(view);
+
+	if (!view->cursors()->enabled())
+		return false;
+
+	const double samplerate = session_.get_samplerate();
+
+	const pv::util::Timestamp& start_time = view->cursors()->first()->time();
+	const pv::util::Timestamp& end_time = view->cursors()->second()->time();
+
+	start_sample = (uint64_t)max(0.0, start_time.convert_to<double>() * samplerate);
+	end_sample = (uint64_t)max(0.0, end_time.convert_to<double>() * samplerate);
+
+	// Are both cursors negative and thus were clamped to 0?
+	return (start_sample != 0) || (end_sample != 0);
+}
+
 unsigned int DecodeTrace::get_row_y(const DecodeTraceRow* row) const
 {
 	assert(row);
@@ -1194,60 +1347,15 @@ void DecodeTrace::export_annotations(deque<const Annotation*>& annotations) cons
 	if (file_name.isEmpty())
 		return;
 
-	QString format = settings.value(GlobalSettings::Key_Dec_ExportFormat).toString();
-	const QString quote = format.contains("%q") ? "\"" : "";
-	format = format.remove("%q");
-
-	const bool has_sample_range   = format.contains("%s");
-	const bool has_row_name       = format.contains("%r");
-	const bool has_dec_name       = format.contains("%d");
-	const bool has_class_name     = format.contains("%c");
-	const bool has_first_ann_text = format.contains("%1");
-	const bool has_all_ann_text   = format.contains("%a");
+	const AnnotationFormatter formatter(
+		settings.value(GlobalSettings::Key_Dec_ExportFormat).toString());
 
 	QFile file(file_name);
 	if (file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
 		QTextStream out_stream(&file);
 
-		for (const Annotation* ann : annotations) {
-			QString out_text = format;
-
-			if (has_sample_range) {
-				const QString sample_range = QString("%1-%2") \
-					.arg(QString::number(ann->start_sample()), QString::number(ann->end_sample()));
-				out_text = out_text.replace("%s", sample_range);
-			}
-
-			if (has_dec_name)
-				out_text = out_text.replace("%d",
-					quote + QString::fromUtf8(ann->row()->decoder()->name()) + quote);
-
-			if (has_row_name) {
-				const QString row_name = quote + ann->row()->description() + quote;
-				out_text = out_text.replace("%r", row_name);
-			}
-
-			if (has_class_name) {
-				const QString class_name = quote + ann->ann_class_name() + quote;
-				out_text = out_text.replace("%c", class_name);
-			}
-
-			if (has_first_ann_text) {
-				const QString first_ann_text = quote + ann->annotations()->front() + quote;
-				out_text = out_text.replace("%1", first_ann_text);
-			}
-
-			if (has_all_ann_text) {
-				QString all_ann_text;
-				for (const QString &s : *(ann->annotations()))
-					all_ann_text = all_ann_text + quote + s + quote + ",";
-				all_ann_text.chop(1);
-
-				out_text = out_text.replace("%a", all_ann_text);
-			}
-
-			out_stream << out_text << '\n';
-		}
+		for (const Annotation* ann : annotations)
+			out_stream << formatter.format(*ann) << '\n';
 
 		if (out_stream.status() == QTextStream::Ok)
 			return;
@@ -1260,6 +1368,60 @@ void DecodeTrace::export_annotations(deque<const Annotation*>& annotations) cons
 	msg.exec();
 }
 
+void DecodeTrace::update_statistics_label(QLabel *label) const
+{
+	const DecodeStatistics stats = decode_signal_->get_statistics();
+	const double run_time = max(stats.run_time, 1e-9);
+
+	auto seconds = [](double t) {
+		return pv::util::format_value_si(t, SIPrefix::unspecified, 2, "s", false); };
+	auto bytes = [](uint64_t size) {
+		return pv::util::format_value_si(size, SIPrefix::unspecified, 1, "B", false); };
+
+	label->setText(
+		tr("Run time: %1").arg(seconds(stats.run_time)) + "\n" +
+		tr("Muxing: %1, decoders: %2").arg(seconds(stats.mux_time),
+			seconds(stats.send_time)) + "\n" +
+		tr("Callbacks: %1, waiting for lock: %2").arg(seconds(stats.callback_time),
+			seconds(stats.lock_wait_time)) + "\n" +
+		tr("%1, %2 annotations/s").arg(
+			pv::util::format_value_si(stats.samples_decoded / run_time,
+				SIPrefix::unspecified, 1, "sa/s", false),
+			pv::util::format_value_si(stats.annotation_count / run_time,
+				SIPrefix::unspecified, 1, "", false)) + "\n" +
+		tr("Memory: %1 annotations, %2 binary data").arg(
+			bytes(stats.annotation_memory), bytes(stats.binary_memory)));
+}
+
+void DecodeTrace::go_to_annotation(bool forward)
+{
+	if (!selected_row_)
+		return;
+
+	deque<const Annotation*> annotations;
+
+	decode_signal_->get_annotation_subset(annotations, selected_row_,
+		current_segment_, selected_sample_range_.first, selected_sample_range_.first);
+
+	if (annotations.empty())
+		return;
+
+	// Search from the start of the selected annotation so that it isn't
+	// found itself
+	const uint32_t ann_class_id = annotations.front()->ann_class_id();
+	const uint64_t sample = annotations.front()->start_sample();
+
+	uint64_t start_sample, end_sample;
+	if (!decode_signal_->find_annotation(selected_row_, current_segment_,
+		ann_class_id, sample, forward, start_sample, end_sample))
+		return;
+
+	View *view = owner_->view();
+	assert(view);
+
+	view->focus_on_range(start_sample, end_sample);
+}
+
 void DecodeTrace::initialize_row_widgets(DecodeTraceRow* r, unsigned int row_id)
 {
 	// Set colors and fixed widths
@@ -1552,6 +1714,33 @@ void DecodeTrace::on_pause_decode()
 		decode_signal_->pause_decode();
 }
 
+void DecodeTrace::on_decode_cursor_range()
+{
+	uint64_t start_sample, end_sample;
+	if (!get_cursor_sample_range(start_sample, end_sample))
+		return;
+
+	decode_signal_->set_decode_range(start_sample, end_sample,
+		(uint64_t)(decode_signal_->get_samplerate() * DecodeRangeWarmUpTime));
+}
+
+void DecodeTrace::on_decode_visible_range()
+{
+	const View *view = owner_->view();
+	assert(view);
+
+	const pair<uint64_t, uint64_t> sample_range =
+		get_view_sample_range(0, view->viewport()->width());
+
+	decode_signal_->set_decode_range(sample_range.first, sample_range.second,
+		(uint64_t)(decode_signal_->get_samplerate() * DecodeRangeWarmUpTime));
+}
+
+void DecodeTrace::on_decode_all()
+{
+	decode_signal_->clear_decode_range();
+}
+
 void DecodeTrace::on_delete()
 {
 	session_.remove_decode_signal(decode_signal_);
@@ -1712,6 +1901,16 @@ void DecodeTrace::on_copy_annotation_to_clipboard()
 		clipboard->setText(annotations.front()->annotations()->front(), QClipboard::Selection);
 }
 
+void DecodeTrace::on_go_to_next_annotation()
+{
+	go_to_annotation(true);
+}
+
+void DecodeTrace::on_go_to_previous_annotation()
+{
+	go_to_annotation(false);
+}
+
 void DecodeTrace::on_export_row()
 {
 	selected_sample_range_ = make_pair(0, numeric_limits<uint64_t>::max());
@@ -1726,24 +1925,8 @@ void DecodeTrace::on_export_all_rows()
 
 void DecodeTrace::on_export_row_with_cursor()
 {
-	const View *view = owner_->view();
-	assert(view);
-
-	if (!view->cursors()->enabled())
-		return;
-
-	const double samplerate = session_.get_samplerate();
-
-	const pv::util::Timestamp& start_time = view->cursors()->first()->time();
-	const pv::util::Timestamp& end_time = view->cursors()->second()->time();
-
-	const uint64_t start_sample = (uint64_t)max(
-		0.0, start_time.convert_to<double>() * samplerate);
-	const uint64_t end_sample = (uint64_t)max(
-		0.0, end_time.convert_to<double>() * samplerate);
-
-	// Are both cursors negative and thus were clamped to 0?
-	if ((start_sample == 0) && (end_sample == 0))
+	uint64_t start_sample, end_sample;
+	if (!get_cursor_sample_range(start_sample, end_sample))
 		return;
 
 	selected_sample_range_ = make_pair(start_sample, end_sample);
@@ -1752,24 +1935,8 @@ void DecodeTrace::on_export_row_with_cursor()
 
 void DecodeTrace::on_export_all_rows_with_cursor()
 {
-	const View *view = owner_->view();
-	assert(view);
-
-	if (!view->cursors()->enabled())
-		return;
-
-	const double samplerate = session_.get_samplerate();
-
-	const pv::util::Timestamp& start_time = view->cursors()->first()->time();
-	const pv::util::Timestamp& end_time = view->cursors()->second()->time();
-
-	const uint64_t start_sample = (uint64_t)max(
-		0.0, start_time.convert_to<double>() * samplerate);
-	const uint64_t end_sample = (uint64_t)max(
-		0.0, end_time.convert_to<double>() * samplerate);
-
-	// Are both cursors negative and thus were clamped to 0?
-	if ((start_sample == 0) && (end_sample == 0))
+	uint64_t start_sample, end_sample;
+	if (!get_cursor_sample_range(start_sample, end_sample))
 		return;
 
 	selected_sample_range_ = make_pair(start_sample, end_sample);
@@ -1803,6 +1970,54 @@ void DecodeTrace::on_export_all_rows_from_here()
 		export_annotations(annotations);
 }
 
+void DecodeTrace::on_export_statistics()
+{
+	const DecodeStatistics stats = decode_signal_->get_statistics();
+
+	GlobalSettings settings;
+	const QString dir = settings.value("MainWindow/SaveDirectory").toString();
+
+	const QString file_name = QFileDialog::getSaveFileName(
+		owner_->view(), tr("Export statistics"), dir, tr("CSV Files (*.csv);;All Files (*)"));
+
+	if (file_name.isEmpty())
+		return;
+
+	QStringList decoders;
+	for (const shared_ptr<Decoder>& dec : decode_signal_->decoder_stack())
+		decoders << QString::fromUtf8(dec->get_srd_decoder()->id);
+
+	// Times in seconds, memory in bytes
+	QFile file(file_name);
+	if (file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+		QTextStream out_stream(&file);
+
+		out_stream << "name,decoders,run_time,mux_time,send_time,callback_time," \
+			"lock_wait_time,samples,samples_per_s,annotations,annotations_per_s," \
+			"annotation_memory,binary_memory\n";
+
+		const double run_time = max(stats.run_time, 1e-9);
+		QString name = decode_signal_->name();
+		name.replace("\"", "\"\"");
+
+		out_stream << "\"" << name << "\"," << decoders.join(">") << "," <<
+			stats.run_time << "," << stats.mux_time << "," << stats.send_time << "," <<
+			stats.callback_time << "," << stats.lock_wait_time << "," <<
+			(qulonglong)stats.samples_decoded << "," << (stats.samples_decoded / run_time) << "," <<
+			(qulonglong)stats.annotation_count << "," << (stats.annotation_count / run_time) << "," <<
+			(qulonglong)stats.annotation_memory << "," << (qulonglong)stats.binary_memory << '\n';
+
+		if (out_stream.status() == QTextStream::Ok)
+			return;
+	}
+
+	QMessageBox msg(owner_->view());
+	msg.setText(tr("Error") + "\n\n" + tr("File %1 could not be written to.").arg(file_name));
+	msg.setStandardButtons(QMessageBox::Ok);
+	msg.setIcon(QMessageBox::Warning);
+	msg.exec();
+}
+
 void DecodeTrace::on_animation_timer()
 {
 	bool animation_finished = true;
@@ -32,6 +32,7 @@
 #include <QComboBox>
 #include <QCheckBox>
 #include <QElapsedTimer>
+#include <QLabel>
 #include <QPolygon>
 #include <QPushButton>
 #include <QSignalMapper>
@@ -55,6 +56,7 @@ using std::vector;
 
 using pv::data::SignalBase;
 using pv::data::decode::Annotation;
+using pv::data::decode::AnnotationSummary;
 using pv::data::decode::Decoder;
 using pv::data::decode::Row;
 
@@ -134,6 +136,9 @@ private:
 	static const int MaxTraceUpdateRate;
 	static const int AnimationDurationInTicks;
 	static const int HiddenRowHideDelay;
+	static const int StatisticsUpdateInterval;
+
+	static const double DecodeRangeWarmUpTime;
 
 public:
 	DecodeTrace(pv::Session &session, shared_ptr<SignalBase> signalbase,
@@ -194,6 +199,9 @@ private:
 	void draw_annotations(deque<const Annotation*>& annotations, QPainter &p,
 		const ViewItemPaintParams &pp, int y, const DecodeTraceRow& row);
 
+	void draw_annotation_summaries(const vector<AnnotationSummary>& summaries,
+		QPainter &p, int y, const DecodeTraceRow& row) const;
+
 	void draw_annotation(const Annotation* a, QPainter &p,
 		const ViewItemPaintParams &pp, int y, const DecodeTraceRow& row) const;
 
@@ -220,6 +228,13 @@ private:
 	 */
 	pair<uint64_t, uint64_t> get_view_sample_range(int x_start, int x_end) const;
 
+	/**
+	 * Determines the start and end sample of the cursor range.
+	 * @return false if the cursors are disabled or both are before the
+	 * 	first sample.
+	 */
+	bool get_cursor_sample_range(uint64_t &start_sample, uint64_t &end_sample) const;
+
 	unsigned int get_row_y(const DecodeTraceRow* row) const;
 
 	DecodeTraceRow* get_row_at_point(const QPoint &point);
@@ -238,6 +253,14 @@ private:
 
 	void export_annotations(deque<const Annotation*>& annotations) const;
 
+	void update_statistics_label(QLabel *label) const;
+
+	/**
+	 * Moves the view to the next or previous annotation of the same class
+	 * as the selected one.
+	 */
+	void go_to_annotation(bool forward);
+
 	void initialize_row_widgets(DecodeTraceRow* r, unsigned int row_id);
 	void update_rows();
 
@@ -263,6 +286,9 @@ private Q_SLOTS:
 	void on_decode_reset();
 	void on_decode_finished();
 	void on_pause_decode();
+	void on_decode_cursor_range();
+	void on_decode_visible_range();
+	void on_decode_all();
 
 	void on_delete();
 
@@ -288,6 +314,8 @@ private Q_SLOTS:
 	void on_row_container_resized(QWidget* sender);
 
 	void on_copy_annotation_to_clipboard();
+	void on_go_to_next_annotation();
+	void on_go_to_previous_annotation();
 
 	void on_export_row();
 	void on_export_all_rows();
@@ -296,6 +324,8 @@ private Q_SLOTS:
 	void on_export_row_from_here();
 	void on_export_all_rows_from_here();
 
+	void on_export_statistics();
+
 	void on_animation_timer();
 	void on_hide_hidden_rows();
 
@@ -420,6 +420,7 @@ void View::add_decode_signal(shared_ptr<data::DecodeSignal> signal)
 
 	d->set_segment_display_mode(segment_display_mode_);
 	d->set_current_segment(current_segment_);
+	signal->set_priority_segment(current_segment_);
 
 	connect(signal.get(), SIGNAL(name_changed(const QString&)),
 		this, SLOT(on_signal_name_changed()));
@@ -749,6 +750,10 @@ void View::set_current_segment(uint32_t segment_id)
 #ifdef ENABLE_DECODE
 	for (shared_ptr<DecodeTrace>& dt : decode_traces_)
 		dt->set_current_segment(current_segment_);
+
+	// Have the segment being viewed decoded first
+	for (const shared_ptr<data::DecodeSignal>& ds : decode_signals_)
+		ds->set_priority_segment(current_segment_);
 #endif
 
 	vector<util::Timestamp> triggers = session_.get_triggers(current_segment_);
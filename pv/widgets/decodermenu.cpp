@@ -21,6 +21,8 @@
 
 #include <libsigrokdecode/libsigrokdecode.h>
 
+#include <pv/decoderloader.hpp>
+
 #include "decodermenu.hpp"
 
 namespace pv {
@@ -28,25 +30,44 @@ namespace widgets {
 
 DecoderMenu::DecoderMenu(QWidget *parent, const char* input, bool first_level_decoder) :
 	QMenu(parent),
-	mapper_(this)
+	mapper_(this),
+	input_(input ? input : ""),
+	first_level_decoder_(first_level_decoder)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+	connect(&mapper_, SIGNAL(mappedObject(QObject*)), this, SLOT(on_action(QObject*)));
+#else
+	connect(&mapper_, SIGNAL(mapped(QObject*)), this, SLOT(on_action(QObject*)));
+#endif
+
+	if (DecoderLoader::is_loaded())
+		populate();
+	else {
+		addAction(tr("Loading protocol decoders..."))->setEnabled(false);
+		connect(DecoderLoader::instance(), SIGNAL(loaded()),
+			this, SLOT(on_decoders_loaded()));
+	}
+}
+
+void DecoderMenu::populate()
 {
-	GSList *li = g_slist_sort(g_slist_copy((GSList*)srd_decoder_list()), decoder_name_cmp);
+	GSList *li = g_slist_sort(g_slist_copy((GSList*)DecoderLoader::get_decoders()), decoder_name_cmp);
 
 	for (GSList *l = li; l; l = l->next) {
 		const srd_decoder *const d = (srd_decoder*)l->data;
 		assert(d);
 
 		const bool have_channels = (d->channels || d->opt_channels) != 0;
-		if (first_level_decoder != have_channels)
+		if (first_level_decoder_ != have_channels)
 			continue;
 
-		if (!first_level_decoder) {
+		if (!first_level_decoder_) {
 			// Dismiss all non-stacked decoders unless we're looking for first-level decoders
 			if (!d->inputs)
 				continue;
 
 			// TODO For now we ignore that d->inputs is actually a list
-			if (strncmp((char*)(d->inputs->data), input, 1024) != 0)
+			if (strncmp((char*)(d->inputs->data), input_.c_str(), 1024) != 0)
 				continue;
 		}
 
@@ -56,12 +77,6 @@ DecoderMenu::DecoderMenu(QWidget *parent, const char* input, bool first_level_de
 		connect(action, SIGNAL(triggered()), &mapper_, SLOT(map()));
 	}
 	g_slist_free(li);
-
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-	connect(&mapper_, SIGNAL(mappedObject(QObject*)), this, SLOT(on_action(QObject*)));
-#else
-	connect(&mapper_, SIGNAL(mapped(QObject*)), this, SLOT(on_action(QObject*)));
-#endif
 }
 
 int DecoderMenu::decoder_name_cmp(const void *a, const void *b)
@@ -79,5 +94,11 @@ void DecoderMenu::on_action(QObject *action)
 	decoder_selected(dec);
 }
 
+void DecoderMenu::on_decoders_loaded()
+{
+	clear();
+	populate();
+}
+
 }  // namespace widgets
 }  // namespace pv
@@ -20,6 +20,8 @@
 #ifndef PULSEVIEW_PV_WIDGETS_DECODERMENU_HPP
 #define PULSEVIEW_PV_WIDGETS_DECODERMENU_HPP
 
+#include <string>
+
 #include <QMenu>
 #include <QSignalMapper>
 
@@ -38,14 +40,19 @@ public:
 private:
 	static int decoder_name_cmp(const void *a, const void *b);
 
+	void populate();
+
 private Q_SLOTS:
 	void on_action(QObject *action);
+	void on_decoders_loaded();
 
 Q_SIGNALS:
 	void decoder_selected(srd_decoder *decoder);
 
 private:
 	QSignalMapper mapper_;
+	const std::string input_;
+	const bool first_level_decoder_;
 };
 
 }  // namespace widgets
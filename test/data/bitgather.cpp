@@ -0,0 +1,128 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <pv/data/decode/bitgather.hpp>
+
+using pv::data::decode::BitGather;
+using std::vector;
+
+namespace {
+
+// Reference implementation, one bit at a time
+vector<uint8_t> gather_bits(const vector<uint8_t> &in, unsigned int in_unit_size,
+	const vector<unsigned int> &in_bits, unsigned int out_unit_size)
+{
+	const size_t count = in.size() / in_unit_size;
+	vector<uint8_t> out(count * out_unit_size, 0);
+
+	for (size_t s = 0; s < count; s++)
+		for (unsigned int i = 0; i < in_bits.size(); i++)
+			if ((in[s * in_unit_size + in_bits[i] / 8] >> (in_bits[i] % 8)) & 1)
+				out[s * out_unit_size + i / 8] |= 1 << (i % 8);
+
+	return out;
+}
+
+vector<uint8_t> make_input(size_t size)
+{
+	vector<uint8_t> in(size);
+	uint32_t value = 0x12345678;
+	for (uint8_t& byte : in) {
+		value = value * 1103515245 + 12345;
+		byte = value >> 16;
+	}
+	return in;
+}
+
+void check_gather(unsigned int in_unit_size, const vector<unsigned int> &in_bits)
+{
+	const unsigned int out_unit_size = (in_bits.size() + 7) / 8;
+	const size_t count = 1000;
+	const vector<uint8_t> in = make_input(count * in_unit_size);
+
+	BitGather gather(in_unit_size, out_unit_size);
+	for (unsigned int i = 0; i < in_bits.size(); i++)
+		gather.add_bit(in_bits[i], i);
+
+	vector<uint8_t> out(count * out_unit_size, 0xAA);
+	gather.gather(in.data(), out.data(), count, false);
+
+	BOOST_CHECK(out == gather_bits(in, in_unit_size, in_bits, out_unit_size));
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(BitGatherTest)
+
+BOOST_AUTO_TEST_CASE(InOrder)
+{
+	check_gather(1, {0, 1, 2, 3, 4, 5, 6, 7});
+	check_gather(2, {3, 4, 9});
+	check_gather(4, {0, 8, 16, 24, 31});
+	check_gather(8, {1, 17, 40, 63});
+}
+
+BOOST_AUTO_TEST_CASE(Reordered)
+{
+	check_gather(1, {1, 0});
+	check_gather(2, {15, 0, 7, 8});
+	check_gather(3, {23, 1, 12, 5, 4, 3, 2, 0, 22});
+	check_gather(8, {63, 0, 32, 31, 5, 5});
+}
+
+BOOST_AUTO_TEST_CASE(WideOutput)
+{
+	vector<unsigned int> in_bits;
+	for (unsigned int i = 0; i < 72; i++)
+		in_bits.push_back((i * 7) % 80);
+
+	check_gather(10, in_bits);
+}
+
+BOOST_AUTO_TEST_CASE(Accumulate)
+{
+	const size_t count = 500;
+	const vector<uint8_t> in_a = make_input(count);
+	const vector<uint8_t> in_b = make_input(count * 2);
+
+	// Bits 0 and 2 come from the first input, bits 1 and 3 from the second
+	BitGather gather_a(1, 1), gather_b(2, 1);
+	gather_a.add_bit(5, 0);
+	gather_a.add_bit(6, 2);
+	gather_b.add_bit(12, 1);
+	gather_b.add_bit(0, 3);
+
+	vector<uint8_t> out(count, 0xFF);
+	gather_a.gather(in_a.data(), out.data(), count, false);
+	gather_b.gather(in_b.data(), out.data(), count, true);
+
+	for (size_t s = 0; s < count; s++) {
+		const uint8_t expected =
+			((in_a[s] >> 5) & 1) |
+			(((in_b[s * 2 + 1] >> 4) & 1) << 1) |
+			(((in_a[s] >> 6) & 1) << 2) |
+			((in_b[s * 2] & 1) << 3);
+		BOOST_CHECK_EQUAL(out[s], expected);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
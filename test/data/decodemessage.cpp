@@ -0,0 +1,109 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <pv/data/decode/decodemessage.hpp>
+
+using pv::data::decode::PayloadReader;
+using pv::data::decode::put_string;
+using pv::data::decode::put_u32;
+using pv::data::decode::put_u64;
+using pv::data::decode::receive_message;
+using pv::data::decode::send_message;
+using std::vector;
+
+BOOST_AUTO_TEST_SUITE(DecodeMessageTest)
+
+BOOST_AUTO_TEST_CASE(RoundTrip)
+{
+	vector<uint8_t> payload;
+	put_u32(payload, 0x12345678);
+	put_u64(payload, 0x123456789abcdef0ULL);
+	put_string(payload, "Data write");
+	put_string(payload, "");
+	put_u32(payload, 42);
+
+	int fds[2];
+	BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+	BOOST_REQUIRE(send_message(fds[0], 18, payload));
+	BOOST_REQUIRE(send_message(fds[0], 19, vector<uint8_t>()));
+
+	uint32_t type = 0;
+	vector<uint8_t> received;
+	BOOST_REQUIRE(receive_message(fds[1], type, received));
+	BOOST_CHECK_EQUAL(type, 18U);
+	BOOST_CHECK(received == payload);
+
+	// Reading must not modify the payload, so it can be read again
+	for (int pass = 0; pass < 2; pass++) {
+		PayloadReader reader(received);
+		BOOST_CHECK_EQUAL(reader.u32(), 0x12345678U);
+		BOOST_CHECK_EQUAL(reader.u64(), 0x123456789abcdef0ULL);
+		BOOST_CHECK_EQUAL(strcmp(reader.string(), "Data write"), 0);
+		BOOST_CHECK_EQUAL(strcmp(reader.string(), ""), 0);
+		BOOST_CHECK_EQUAL(reader.u32(), 42U);
+		BOOST_CHECK(reader.ok);
+		BOOST_CHECK_EQUAL(reader.pos, received.size());
+	}
+	BOOST_CHECK(received == payload);
+
+	BOOST_REQUIRE(receive_message(fds[1], type, received));
+	BOOST_CHECK_EQUAL(type, 19U);
+	BOOST_CHECK(received.empty());
+
+	// A closed peer is reported rather than raising SIGPIPE
+	close(fds[1]);
+	BOOST_CHECK(!send_message(fds[0], 18, payload));
+	close(fds[0]);
+}
+
+BOOST_AUTO_TEST_CASE(BrokenPayload)
+{
+	vector<uint8_t> payload;
+	put_string(payload, "Data");
+
+	// Cut off the terminating zero
+	vector<uint8_t> truncated(payload.begin(), payload.end() - 1);
+	PayloadReader reader(truncated);
+	BOOST_CHECK_EQUAL(strcmp(reader.string(), ""), 0);
+	BOOST_CHECK(!reader.ok);
+	BOOST_CHECK_EQUAL(reader.u32(), 0U);
+
+	// A length beyond the payload
+	vector<uint8_t> too_long;
+	put_u32(too_long, 0xffffffff);
+	PayloadReader long_reader(too_long);
+	BOOST_CHECK_EQUAL(strcmp(long_reader.string(), ""), 0);
+	BOOST_CHECK(!long_reader.ok);
+
+	// Unterminated, the zero must be where the length says
+	payload.back() = 'x';
+	PayloadReader unterminated_reader(payload);
+	BOOST_CHECK_EQUAL(strcmp(unterminated_reader.string(), ""), 0);
+	BOOST_CHECK(!unterminated_reader.ok);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
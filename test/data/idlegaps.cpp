@@ -0,0 +1,208 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <libsigrokdecode/libsigrokdecode.h> /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#include <boost/test/unit_test.hpp>
+
+#include <pv/data/decode/idlegaps.hpp>
+
+using pv::data::decode::find_idle_gap_splits;
+using std::get;
+using std::make_tuple;
+using std::sort;
+using std::string;
+using std::tuple;
+using std::vector;
+
+namespace {
+
+const uint64_t SampleRate = 1000000;
+const int64_t BaudRate = 100000;
+const uint64_t SamplesPerBit = SampleRate / BaudRate;
+const uint64_t GapLength = SampleRate / 1000;  // Same as DecodeSignal::SplitIdleGapTime
+
+// Start sample, end sample, class and first text
+typedef tuple<uint64_t, uint64_t, int, string> DecodedAnnotation;
+
+struct DecodeOutput
+{
+	uint64_t sample_offset;
+	uint64_t keep_start, keep_end;
+	bool discard;
+	vector<DecodedAnnotation> annotations;
+};
+
+void collect_annotation(srd_proto_data *pdata, void *cb_data)
+{
+	DecodeOutput *const output = (DecodeOutput*)cb_data;
+	const srd_proto_data_annotation *const pda =
+		(const srd_proto_data_annotation*)pdata->data;
+
+	const uint64_t start = pdata->start_sample + output->sample_offset;
+	if (output->discard || (start < output->keep_start) || (start >= output->keep_end))
+		return;
+
+	output->annotations.emplace_back(start, pdata->end_sample + output->sample_offset,
+		pda->ann_class, pda->ann_text[0]);
+}
+
+// UART bursts of 8N1 frames on bit 0, separated by a few idle gaps
+vector<uint8_t> create_uart_samples()
+{
+	vector<uint8_t> samples(GapLength, 1);
+
+	uint8_t value = 0x35;
+	for (int burst = 0; burst < 40; burst++) {
+		for (int frame = 0; frame < 20; frame++) {
+			value = value * 13 + 7;
+			const uint16_t bits = 0x200 | (value << 1);  // Start bit, LSB first, stop bit
+			for (int bit = 0; bit < 10; bit++)
+				samples.insert(samples.end(), SamplesPerBit, (bits >> bit) & 1);
+		}
+
+		samples.insert(samples.end(), (2 + burst % 3) * GapLength, 1);
+	}
+
+	return samples;
+}
+
+/*
+ * Decodes the samples [feed_start, feed_end) in a session of their own and
+ * keeps the annotations that start in [keep_start, keep_end), the same as
+ * DecodeSignal does for a partition.
+ */
+vector<DecodedAnnotation> decode(const vector<uint8_t> &samples, uint64_t feed_start,
+	uint64_t feed_end, uint64_t keep_start, uint64_t keep_end, bool discard_at_eof)
+{
+	DecodeOutput output = {feed_start, keep_start, keep_end, false, {}};
+
+	srd_session *session = nullptr;
+	BOOST_REQUIRE(srd_session_new(&session) == SRD_OK);
+
+	GHashTable *const options = g_hash_table_new_full(g_str_hash,
+		g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("baudrate"),
+		g_variant_ref_sink(g_variant_new_int64(BaudRate)));
+	srd_decoder_inst *const di = srd_inst_new(session, "uart", options);
+	g_hash_table_destroy(options);
+	BOOST_REQUIRE(di);
+
+	GHashTable *const channels = g_hash_table_new_full(g_str_hash,
+		g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(channels, g_strdup("rx"),
+		g_variant_ref_sink(g_variant_new_int32(0)));
+	srd_inst_channel_set_all(di, channels);
+	g_hash_table_destroy(channels);
+
+	srd_session_metadata_set(session, SRD_CONF_SAMPLERATE,
+		g_variant_new_uint64(SampleRate));
+	srd_pd_output_callback_add(session, SRD_OUTPUT_ANN, collect_annotation, &output);
+	BOOST_REQUIRE(srd_session_start(session) == SRD_OK);
+
+	// The sample numbers of a session start at 0
+	BOOST_CHECK(srd_session_send(session, 0, feed_end - feed_start,
+		samples.data() + feed_start, feed_end - feed_start, 1) == SRD_OK);
+
+#if defined HAVE_SRD_SESSION_SEND_EOF && HAVE_SRD_SESSION_SEND_EOF
+	output.discard = discard_at_eof;
+	(void)srd_session_send_eof(session);
+#else
+	(void)discard_at_eof;
+#endif
+
+	srd_session_destroy(session);
+
+	return output.annotations;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(IdleGapsTest)
+
+BOOST_AUTO_TEST_CASE(SplitInGaps)
+{
+	// Activity in [0, 200) and [5000, 5200), one sample per block
+	const vector<uint64_t> activity = {0, 100, 199, 5000, 5199};
+
+	const vector<uint64_t> splits = find_idle_gap_splits(activity, 1, 1000, 1000, 0, 10000);
+	BOOST_REQUIRE_EQUAL(splits.size(), 1);
+	BOOST_CHECK_EQUAL(splits[0], 200 + (5000 - 200) / 2);
+
+	// The gap is too short or the partitions would be too short
+	BOOST_CHECK(find_idle_gap_splits(activity, 1, 5000, 1000, 0, 10000).empty());
+	BOOST_CHECK(find_idle_gap_splits(activity, 1, 1000, 4000, 0, 10000).empty());
+
+	// Activity blocks shorten the gap
+	BOOST_CHECK(find_idle_gap_splits(activity, 4000, 1000, 1000, 0, 10000).empty());
+}
+
+BOOST_AUTO_TEST_CASE(SplitMatchesUnsplitDecode)
+{
+	BOOST_REQUIRE(srd_init(nullptr) == SRD_OK);
+
+	if (srd_decoder_load("uart") != SRD_OK) {
+		BOOST_TEST_MESSAGE("The uart decoder isn't installed, skipping");
+		srd_exit();
+		return;
+	}
+
+	const vector<uint8_t> samples = create_uart_samples();
+
+	vector<uint64_t> activity;
+	for (uint64_t i = 1; i < samples.size(); i++)
+		if (samples[i] != samples[i - 1])
+			activity.push_back(i);
+
+	const vector<uint64_t> splits = find_idle_gap_splits(activity, 1, GapLength,
+		samples.size() / 8, 0, samples.size());
+	BOOST_REQUIRE(splits.size() > 2);
+
+	vector<DecodedAnnotation> unsplit =
+		decode(samples, 0, samples.size(), 0, samples.size(), false);
+	BOOST_REQUIRE(!unsplit.empty());
+
+	// Every partition is fed from half a gap before its start
+	vector<uint64_t> bounds = {0};
+	bounds.insert(bounds.end(), splits.begin(), splits.end());
+	bounds.push_back(samples.size());
+
+	vector<DecodedAnnotation> split;
+	for (size_t i = 0; i + 1 < bounds.size(); i++) {
+		const uint64_t feed_start = bounds[i] - ((i > 0) ? GapLength / 2 : 0);
+		const bool last = (i + 2 == bounds.size());
+		const vector<DecodedAnnotation> partition = decode(samples,
+			feed_start, bounds[i + 1], bounds[i], bounds[i + 1], !last);
+		split.insert(split.end(), partition.begin(), partition.end());
+	}
+
+	sort(unsplit.begin(), unsplit.end());
+	sort(split.begin(), split.end());
+	BOOST_CHECK_EQUAL(split.size(), unsplit.size());
+	BOOST_CHECK(split == unsplit);
+
+	srd_exit();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
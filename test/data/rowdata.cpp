@@ -0,0 +1,411 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <libsigrokdecode/libsigrokdecode.h> /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#include <boost/test/unit_test.hpp>
+
+#include <pv/data/decode/annotationcursor.hpp>
+#include <pv/data/decode/decoder.hpp>
+#include <pv/data/decode/rowdata.hpp>
+
+using pv::data::decode::Annotation;
+using pv::data::decode::AnnotationCursor;
+using pv::data::decode::AnnotationSummary;
+using pv::data::decode::Decoder;
+using pv::data::decode::RowData;
+using std::deque;
+using std::make_shared;
+using std::shared_ptr;
+using std::sort;
+using std::vector;
+
+namespace {
+
+const uint32_t ClassCount = 3;
+
+// Reference implementation, looking at every annotation
+vector<const Annotation*> find_overlapping(const RowData &row_data,
+	uint64_t start_sample, uint64_t end_sample, const vector<bool> &class_visible)
+{
+	vector<const Annotation*> result;
+	for (const Annotation& a : row_data.annotations())
+		if (class_visible[a.ann_class_id()] &&
+			(a.end_sample() > start_sample) && (a.start_sample() <= end_sample))
+			result.push_back(&a);
+	return result;
+}
+
+void check_subsets(const RowData &row_data, uint64_t max_sample,
+	const vector<bool> &class_visible)
+{
+	for (uint64_t start = 0; start < max_sample; start += 37)
+		for (uint64_t length : {0, 1, 50, 500, 5000}) {
+			deque<const Annotation*> subset;
+			row_data.get_annotation_subset(subset, start, start + length);
+
+			vector<const Annotation*> found(subset.begin(), subset.end());
+			vector<const Annotation*> expected =
+				find_overlapping(row_data, start, start + length, class_visible);
+			sort(found.begin(), found.end());
+			sort(expected.begin(), expected.end());
+
+			BOOST_CHECK(found == expected);
+		}
+}
+
+// Mostly short annotations in order, with some long ones and some
+// that start before the previous one. Returns the last start sample
+uint64_t fill_row(RowData &row_data)
+{
+	const char* const texts[] = {"A", nullptr};
+	uint32_t value = 0x12345678;
+	uint64_t sample = 0;
+
+	for (int i = 0; i < 2000; i++) {
+		value = value * 1103515245 + 12345;
+
+		uint64_t start = sample;
+		if ((value >> 8) % 10 == 0)
+			start -= std::min<uint64_t>(sample, (value >> 12) % 200);
+		const uint64_t length = ((value >> 16) % 50 == 0) ? 3000 : (value >> 20) % 20;
+		const uint32_t ann_class = ((value >> 4) % 20 == 0) ? 2 : ((value >> 6) % 2);
+
+		row_data.emplace_annotation(start, start + length, ann_class, texts);
+		sample += (value >> 24) % 10;
+	}
+
+	return sample;
+}
+
+struct DecoderFixture
+{
+	DecoderFixture() :
+		class_names(ClassCount)
+	{
+		memset(&srd_dec, 0, sizeof(srd_dec));
+		for (uint32_t i = 0; i < ClassCount; i++) {
+			class_names[i] = {(char*)"class", (char*)"Class"};
+			srd_dec.annotations = g_slist_append(srd_dec.annotations, class_names[i].data());
+		}
+
+		dec = make_shared<Decoder>(&srd_dec, 0);
+	}
+
+	~DecoderFixture()
+	{
+		dec.reset();
+		g_slist_free(srd_dec.annotations);
+	}
+
+	srd_decoder srd_dec;
+	vector< vector<char*> > class_names;
+	shared_ptr<Decoder> dec;
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(RowDataTest, DecoderFixture)
+
+BOOST_AUTO_TEST_CASE(AnnotationSubset)
+{
+	RowData row_data(dec->get_row_by_id(0));
+	const uint64_t max_sample = fill_row(row_data) + 100;
+
+	check_subsets(row_data, max_sample, vector<bool>(ClassCount, true));
+
+	dec->get_ann_class_by_id(1)->set_visible(false);
+	check_subsets(row_data, max_sample, {true, false, true});
+
+	dec->get_ann_class_by_id(0)->set_visible(false);
+	check_subsets(row_data, max_sample, {false, false, true});
+}
+
+BOOST_AUTO_TEST_CASE(AnnotationSubsetWithLongFirst)
+{
+	// One annotation overlapping all others must not hide any of them
+	RowData row_data(dec->get_row_by_id(0));
+	const char* const texts[] = {"A", nullptr};
+	row_data.emplace_annotation(0, 1000000, 2, texts);
+	const uint64_t max_sample = fill_row(row_data) + 100;
+
+	check_subsets(row_data, max_sample, vector<bool>(ClassCount, true));
+
+	dec->get_ann_class_by_id(1)->set_visible(false);
+	check_subsets(row_data, max_sample, {true, false, true});
+}
+
+BOOST_AUTO_TEST_CASE(InternedTexts)
+{
+	RowData row_data(dec->get_row_by_id(0));
+
+	const char* const texts_a[] = {"Data", "D", nullptr};
+	const char* const texts_b[] = {"Data write", "W", nullptr};
+
+	// Copies, as the texts are looked up by their contents
+	char data[] = "Data";
+	const char* const texts_c[] = {data, "D", nullptr};
+
+	const Annotation* a = row_data.emplace_annotation(0, 10, 0, texts_a);
+	const Annotation* b = row_data.emplace_annotation(10, 20, 0, texts_b);
+	const Annotation* c = row_data.emplace_annotation(20, 30, 0, texts_c);
+
+	BOOST_CHECK_EQUAL(a->annotations()->size(), 2U);
+	BOOST_CHECK(a->longest_annotation() == "Data");
+	BOOST_CHECK(b->longest_annotation() == "Data write");
+	BOOST_CHECK(a->annotations() != b->annotations());
+	BOOST_CHECK_EQUAL(a->annotations(), c->annotations());
+
+	// The class is stored along with the texts
+	const Annotation* d = row_data.emplace_annotation(30, 40, 1, texts_a);
+	BOOST_CHECK_EQUAL(a->ann_class_id(), 0U);
+	BOOST_CHECK_EQUAL(d->ann_class_id(), 1U);
+	BOOST_CHECK(d->longest_annotation() == "Data");
+	BOOST_CHECK_EQUAL(d->row_data(), &row_data);
+}
+
+BOOST_AUTO_TEST_CASE(RemoveAnnotations)
+{
+	RowData row_data(dec->get_row_by_id(0));
+	const uint64_t max_sample = fill_row(row_data) + 100;
+
+	const char* const texts[] = {"Last", nullptr};
+	const Annotation* last = row_data.emplace_annotation(max_sample, max_sample + 10, 1, texts);
+
+	const uint64_t cut = max_sample / 2;
+	const uint64_t count = row_data.get_annotation_count();
+	const uint64_t removed = row_data.get_annotation_count_before(cut);
+	BOOST_REQUIRE(removed > 0);
+
+	row_data.remove_annotations_before(cut);
+
+	BOOST_CHECK_EQUAL(row_data.get_annotation_count(), count - removed);
+	BOOST_CHECK_EQUAL(row_data.get_annotation_count_before(cut), 0U);
+	BOOST_CHECK_EQUAL(&(row_data.annotations().back()), last);
+	BOOST_CHECK(last->longest_annotation() == "Last");
+
+	// The indices must match the remaining annotations
+	check_subsets(row_data, max_sample, vector<bool>(ClassCount, true));
+
+	dec->get_ann_class_by_id(1)->set_visible(false);
+	check_subsets(row_data, max_sample, {true, false, true});
+
+	BOOST_CHECK_EQUAL(row_data.find_annotation(1, max_sample - 1, true), last);
+	BOOST_CHECK(!row_data.find_annotation(0, cut, false));
+
+	// Texts of removed annotations must not be handed out anymore
+	row_data.remove_annotations_before(max_sample + 1);
+	BOOST_CHECK_EQUAL(row_data.get_annotation_count(), 0U);
+
+	const Annotation* a = row_data.emplace_annotation(max_sample + 20, max_sample + 30, 0, texts);
+	BOOST_CHECK(a->longest_annotation() == "Last");
+}
+
+BOOST_AUTO_TEST_CASE(FindAnnotation)
+{
+	RowData row_data(dec->get_row_by_id(0));
+	const uint64_t max_sample = fill_row(row_data) + 100;
+
+	for (uint64_t sample = 0; sample < max_sample; sample += 13) {
+		// Reference: the nearest start samples of class 2 on either side
+		const Annotation *next = nullptr, *prev = nullptr;
+		for (const Annotation& a : row_data.annotations()) {
+			if (a.ann_class_id() != 2)
+				continue;
+			if ((a.start_sample() > sample) && !next)
+				next = &a;
+			if (a.start_sample() < sample)
+				prev = &a;
+		}
+
+		const Annotation* found_next = row_data.find_annotation(2, sample, true);
+		const Annotation* found_prev = row_data.find_annotation(2, sample, false);
+
+		BOOST_CHECK_EQUAL(found_next ? found_next->start_sample() : 0,
+			next ? next->start_sample() : 0);
+		BOOST_CHECK_EQUAL(found_prev ? found_prev->start_sample() : 0,
+			prev ? prev->start_sample() : 0);
+	}
+
+	BOOST_CHECK(!row_data.find_annotation(ClassCount, 0, true));
+}
+
+BOOST_AUTO_TEST_CASE(AnnotationSummaries)
+{
+	RowData row_data(dec->get_row_by_id(0));
+	const uint64_t max_sample = fill_row(row_data) + 100;
+
+	vector<AnnotationSummary> summaries;
+	deque<const Annotation*> details;
+	BOOST_CHECK(!row_data.get_annotation_summary(summaries, details, 0, max_sample, 100, 1000));
+
+	for (uint64_t bucket_size : {256, 1000, 4096}) {
+		summaries.clear();
+		details.clear();
+		BOOST_REQUIRE(row_data.get_annotation_summary(summaries, details,
+			300, max_sample, bucket_size, 1000));
+
+		// Each annotation starting from the first bucket on is either summarized
+		// or returned as is, depending on the longest one in its bucket
+		uint64_t shift = 8;
+		while ((2ULL << shift) <= bucket_size)
+			shift++;
+		const uint64_t first_start = (300 >> shift) << shift;
+
+		for (const AnnotationSummary& s : summaries) {
+			uint64_t count = 0;
+			bool uniform = true;
+			for (const Annotation& a : row_data.annotations()) {
+				if ((a.start_sample() >> shift) != s.bucket)
+					continue;
+				count++;
+				BOOST_CHECK(a.end_sample() - a.start_sample() < 1000);
+				BOOST_CHECK(a.start_sample() >= s.start_sample);
+				BOOST_CHECK(a.end_sample() <= s.end_sample);
+				if (a.ann_class_id() != s.ann_class)
+					uniform = false;
+			}
+			BOOST_CHECK_EQUAL(s.count, count);
+			BOOST_CHECK_EQUAL(s.class_uniform, uniform);
+		}
+
+		uint64_t total = 0;
+		for (const AnnotationSummary& s : summaries)
+			total += s.count;
+		for (const Annotation* a : details)
+			if (a->start_sample() >= first_start)
+				total++;
+
+		uint64_t expected = 0;
+		for (const Annotation& a : row_data.annotations())
+			if (a.start_sample() >= first_start)
+				expected++;
+
+		BOOST_CHECK_EQUAL(total, expected);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(LazyAnnotationSummaries)
+{
+	RowData row_data(dec->get_row_by_id(0));
+	const uint64_t max_sample = fill_row(row_data);
+
+	// Summaries only use memory once they were asked for
+	const uint64_t unsummarized_usage = row_data.get_memory_usage();
+	vector<AnnotationSummary> summaries;
+	deque<const Annotation*> details;
+	BOOST_REQUIRE(row_data.get_annotation_summary(summaries, details,
+		0, max_sample, 1024, 1000000));
+	BOOST_CHECK(row_data.get_memory_usage() > unsummarized_usage);
+
+	// Annotations added afterwards are summarized, too
+	const char* const texts[] = {"A", nullptr};
+	for (uint64_t i = 0; i < 100; i++)
+		row_data.emplace_annotation(max_sample + i * 10, max_sample + i * 10 + 5, 1, texts);
+
+	summaries.clear();
+	details.clear();
+	BOOST_REQUIRE(row_data.get_annotation_summary(summaries, details,
+		0, max_sample + 1000, 1024, 1000000));
+
+	uint64_t total = details.size();
+	for (const AnnotationSummary& s : summaries)
+		total += s.count;
+	BOOST_CHECK_EQUAL(total, row_data.get_annotation_count());
+
+	// Removing annotations drops the summaries until they're asked for again
+	row_data.remove_annotations_before(max_sample);
+	BOOST_CHECK(row_data.get_memory_usage() < unsummarized_usage);
+}
+
+BOOST_AUTO_TEST_CASE(MergedAnnotations)
+{
+	RowData row_data_a(dec->get_row_by_id(0));
+	RowData row_data_b(dec->get_row_by_id(0));
+	fill_row(row_data_a);
+	const vector<const RowData*> rows = {&row_data_a, &row_data_b};
+
+	AnnotationCursor cursor;
+	const char* const texts[] = {"B", nullptr};
+
+	for (int step = 0; step < 4; step++) {
+		// Late and long annotations in the second row, as a stacked decoder
+		// would produce them
+		for (uint64_t i = 0; i < 100; i++)
+			row_data_b.emplace_annotation(step * 1000 + i * 7, step * 1000 + i * 7 + 500, 0, texts);
+
+		cursor.advance(rows, 10);
+		BOOST_CHECK(cursor.annotations().size() >= 10);
+
+		cursor.advance(rows, row_data_a.get_annotation_count() + row_data_b.get_annotation_count());
+		const deque<const Annotation*>& merged = cursor.annotations();
+		BOOST_REQUIRE_EQUAL(merged.size(),
+			row_data_a.get_annotation_count() + row_data_b.get_annotation_count());
+
+		for (size_t i = 1; i < merged.size(); i++)
+			BOOST_CHECK(merged[i - 1]->start_sample() <= merged[i]->start_sample());
+
+		vector<const Annotation*> found(merged.begin(), merged.end());
+		vector<const Annotation*> expected;
+		for (const RowData* row_data : rows)
+			for (const Annotation& a : row_data->annotations())
+				expected.push_back(&a);
+		sort(found.begin(), found.end());
+		sort(expected.begin(), expected.end());
+		BOOST_CHECK(found == expected);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(MergedAnnotationsAfterInsert)
+{
+	RowData row_data_a(dec->get_row_by_id(0));
+	RowData row_data_b(dec->get_row_by_id(0));
+	const uint64_t max_sample = fill_row(row_data_a);
+	const vector<const RowData*> rows = {&row_data_a, &row_data_b};
+
+	AnnotationCursor cursor;
+	cursor.advance(rows, row_data_a.get_annotation_count());
+
+	// Inserting in the middle of the row moves annotations in memory
+	const char* const texts[] = {"Late", nullptr};
+	for (uint64_t i = 0; i < 50; i++)
+		row_data_a.emplace_annotation(max_sample / 2 + i, max_sample / 2 + i + 5, 1, texts);
+
+	// Only revalidates, anything merged must still point to the rows
+	cursor.advance(rows, 0);
+	for (const Annotation* a : cursor.annotations()) {
+		bool found = false;
+		for (const Annotation& b : row_data_a.annotations())
+			found = found || (a == &b);
+		BOOST_CHECK(found);
+	}
+
+	cursor.advance(rows, row_data_a.get_annotation_count());
+	const deque<const Annotation*>& merged = cursor.annotations();
+	BOOST_REQUIRE_EQUAL(merged.size(), row_data_a.get_annotation_count());
+
+	for (size_t i = 0; i < merged.size(); i++)
+		BOOST_CHECK_EQUAL(merged[i], &(row_data_a.annotations()[i]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
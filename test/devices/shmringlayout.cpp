@@ -0,0 +1,140 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <pv/devices/shmringlayout.hpp>
+
+using pv::devices::ShmRingBlock;
+using pv::devices::ShmRingHeader;
+using pv::devices::shm_ring_layout_valid;
+using pv::devices::shm_ring_publish_slot;
+using pv::devices::shm_ring_read_slot;
+using pv::devices::shm_ring_release_slot;
+using pv::devices::shm_ring_slot_size;
+using pv::devices::shm_ring_total_size;
+using pv::devices::shm_ring_write_slot;
+using std::vector;
+
+namespace {
+
+// Holds a ring in ordinary memory, aligned like a mapping would be
+struct Ring
+{
+	Ring(uint32_t block_count, uint64_t block_size)
+	{
+		ShmRingHeader layout;
+		memset((void*)&layout, 0, sizeof(layout));
+		layout.block_count = block_count;
+		layout.block_size = block_size;
+
+		memory.resize(shm_ring_total_size(&layout) / sizeof(uint64_t) + 1);
+		header = (ShmRingHeader*)memory.data();
+		header->block_count = block_count;
+		header->block_size = block_size;
+		header->write_index = 0;
+		header->read_index = 0;
+	}
+
+	vector<uint64_t> memory;
+	ShmRingHeader *header;
+};
+
+uint8_t* payload(ShmRingBlock *block)
+{
+	return (uint8_t*)block + sizeof(ShmRingBlock);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(ShmRingLayoutTest)
+
+BOOST_AUTO_TEST_CASE(HeaderValidation)
+{
+	Ring ring(4, 100);
+	const uint64_t size = shm_ring_total_size(ring.header);
+
+	BOOST_CHECK(shm_ring_layout_valid(ring.header, size));
+	BOOST_CHECK(!shm_ring_layout_valid(ring.header, size - 1));
+	BOOST_CHECK(!shm_ring_layout_valid(ring.header, sizeof(ShmRingHeader)));
+
+	ring.header->block_count = 0;
+	BOOST_CHECK(!shm_ring_layout_valid(ring.header, size));
+
+	// Sizes whose product or rounding overflows must not pass
+	ring.header->block_count = 0x80000000;
+	ring.header->block_size = UINT64_C(1) << 33;
+	BOOST_CHECK(!shm_ring_layout_valid(ring.header, size));
+
+	ring.header->block_count = 1;
+	ring.header->block_size = UINT64_MAX - 3;
+	BOOST_CHECK(!shm_ring_layout_valid(ring.header, size));
+	BOOST_CHECK(!shm_ring_layout_valid(ring.header, UINT64_MAX));
+
+	ring.header->block_count = 0xffffffff;
+	ring.header->block_size = 1;
+	BOOST_CHECK(!shm_ring_layout_valid(ring.header, size));
+	BOOST_CHECK(shm_ring_layout_valid(ring.header,
+		sizeof(ShmRingHeader) + UINT64_C(0xffffffff) * shm_ring_slot_size(ring.header)));
+}
+
+BOOST_AUTO_TEST_CASE(WrapAround)
+{
+	const uint32_t block_count = 3;
+	Ring ring(block_count, 16);
+
+	uint8_t written = 0, read = 0;
+
+	BOOST_CHECK(!shm_ring_read_slot(ring.header));
+
+	// Different fill levels so that the indices wrap at different slots
+	for (unsigned int round = 0; round < 10; round++) {
+		const unsigned int count = round % (block_count + 1);
+
+		for (unsigned int i = 0; i < count; i++) {
+			ShmRingBlock *const block = shm_ring_write_slot(ring.header);
+			BOOST_REQUIRE(block);
+			block->length = 16;
+			memset(payload(block), written++, 16);
+			shm_ring_publish_slot(ring.header);
+		}
+
+		// The producer must wait once all slots are filled
+		BOOST_CHECK_EQUAL(!shm_ring_write_slot(ring.header), count == block_count);
+
+		for (unsigned int i = 0; i < count; i++) {
+			ShmRingBlock *const block = shm_ring_read_slot(ring.header);
+			BOOST_REQUIRE(block);
+			BOOST_CHECK_EQUAL(block->length, 16U);
+			BOOST_CHECK_EQUAL(payload(block)[0], read);
+			BOOST_CHECK_EQUAL(payload(block)[15], read);
+			read++;
+			shm_ring_release_slot(ring.header);
+		}
+
+		BOOST_CHECK(!shm_ring_read_slot(ring.header));
+	}
+
+	BOOST_CHECK(ring.header->read_index > block_count);
+	BOOST_CHECK_EQUAL(ring.header->read_index.load(), ring.header->write_index.load());
+}
+
+BOOST_AUTO_TEST_SUITE_END()